@@ -113,6 +113,7 @@ typedef struct _IPADDR IPADDR;
 
 typedef struct _LINEBUF_REC LINEBUF_REC;
 typedef struct _NET_SENDBUF_REC NET_SENDBUF_REC;
+typedef struct _NET_CONNECT_RACE_REC NET_CONNECT_RACE_REC;
 typedef struct _RAWLOG_REC RAWLOG_REC;
 
 typedef struct _CHAT_PROTOCOL_REC CHAT_PROTOCOL_REC;
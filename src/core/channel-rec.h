@@ -11,7 +11,8 @@ GHashTable *nicks; /* list of nicks */
 NICK_REC *ownnick; /* our own nick */
 
 unsigned int no_modes:1; /* channel doesn't support modes */
-char *mode;
+char *mode; /* NULL when it needs to be rendered again with get_mode(),
+	       use channel_get_mode() to read it */
 int limit; /* user limit */
 char *key; /* password key */
 
@@ -30,3 +31,5 @@ unsigned int destroying:1;
    this channel. Usually just the channel name, but may contain also the
    channel key. */
 char *(*get_join_data)(CHANNEL_REC *channel);
+/* Return newly allocated mode string for the channel. */
+char *(*get_mode)(CHANNEL_REC *channel);
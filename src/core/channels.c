@@ -40,6 +40,33 @@ static const char *channel_get_target(WI_ITEM_REC *item)
 	return ((CHANNEL_REC *) item)->name;
 }
 
+static void channel_hash_add(CHANNEL_REC *channel, const char *name)
+{
+	server_name_hash_add(channel->server, &channel->server->channels_hash,
+			     name, channel);
+}
+
+static void channel_hash_remove(CHANNEL_REC *channel, const char *name)
+{
+	server_name_hash_remove(channel->server, channel->server->channels_hash,
+				name, channel);
+}
+
+void channels_rehash(SERVER_REC *server)
+{
+	GSList *tmp;
+
+	g_return_if_fail(IS_SERVER(server));
+
+	server_name_hash_destroy(&server->channels_hash);
+	for (tmp = server->channels; tmp != NULL; tmp = tmp->next) {
+		CHANNEL_REC *rec = tmp->data;
+
+		channel_hash_add(rec, rec->name);
+		channel_hash_add(rec, rec->visible_name);
+	}
+}
+
 void channel_init(CHANNEL_REC *channel, SERVER_REC *server, const char *name,
 		  const char *visible_name, int automatic)
 {
@@ -65,6 +92,8 @@ void channel_init(CHANNEL_REC *channel, SERVER_REC *server, const char *name,
 
 	channels = g_slist_append(channels, channel);
 	server->channels = g_slist_append(server->channels, channel);
+	channel_hash_add(channel, channel->name);
+	channel_hash_add(channel, channel->visible_name);
 
 	signal_emit("channel created", 2, channel, GINT_TO_POINTER(automatic));
 }
@@ -79,6 +108,8 @@ void channel_destroy(CHANNEL_REC *channel)
 	channels = g_slist_remove(channels, channel);
 	channel->server->channels =
 		g_slist_remove(channel->server->channels, channel);
+	channel_hash_remove(channel, channel->name);
+	channel_hash_remove(channel, channel->visible_name);
 
 	signal_emit("channel destroyed", 1, channel);
 
@@ -87,7 +118,7 @@ void channel_destroy(CHANNEL_REC *channel)
 	g_free_not_null(channel->topic);
 	g_free_not_null(channel->topic_by);
 	g_free_not_null(channel->key);
-	g_free(channel->mode);
+	g_free_not_null(channel->mode);
 	g_free(channel->name);
 	g_free(channel->visible_name);
 
@@ -98,8 +129,6 @@ void channel_destroy(CHANNEL_REC *channel)
 static CHANNEL_REC *channel_find_server(SERVER_REC *server,
 					const char *name)
 {
-	GSList *tmp;
-
 	g_return_val_if_fail(IS_SERVER(server), NULL);
 
 	if (server->channel_find_func != NULL) {
@@ -107,14 +136,7 @@ static CHANNEL_REC *channel_find_server(SERVER_REC *server,
 		return server->channel_find_func(server, name);
 	}
 
-	for (tmp = server->channels; tmp != NULL; tmp = tmp->next) {
-		CHANNEL_REC *rec = tmp->data;
-
-		if (g_strcasecmp(name, rec->name) == 0)
-			return rec;
-	}
-
-	return NULL;
+	return server_name_hash_find(server, server->channels_hash, name);
 }
 
 CHANNEL_REC *channel_find(SERVER_REC *server, const char *name)
@@ -131,12 +153,27 @@ CHANNEL_REC *channel_find(SERVER_REC *server, const char *name)
 				   (void *) name);
 }
 
+/* Returns the channel's mode string */
+const char *channel_get_mode(CHANNEL_REC *channel)
+{
+	g_return_val_if_fail(IS_CHANNEL(channel), NULL);
+
+	if (channel->mode == NULL) {
+		/* modes have changed since it was last needed */
+		channel->mode = channel->get_mode != NULL ?
+			channel->get_mode(channel) : g_strdup("");
+	}
+	return channel->mode;
+}
+
 void channel_change_name(CHANNEL_REC *channel, const char *name)
 {
 	g_return_if_fail(IS_CHANNEL(channel));
 
+	channel_hash_remove(channel, channel->name);
 	g_free(channel->name);
 	channel->name = g_strdup(name);
+	channel_hash_add(channel, channel->name);
 
 	signal_emit("channel name changed", 1, channel);
 }
@@ -145,8 +182,10 @@ void channel_change_visible_name(CHANNEL_REC *channel, const char *name)
 {
 	g_return_if_fail(IS_CHANNEL(channel));
 
+	channel_hash_remove(channel, channel->visible_name);
 	g_free(channel->visible_name);
 	channel->visible_name = g_strdup(name);
+	channel_hash_add(channel, channel->visible_name);
 
 	signal_emit("window item name changed", 1, channel);
 }
@@ -26,9 +26,15 @@ void channel_destroy(CHANNEL_REC *channel);
 /* find channel by name, if `server' is NULL, search from all servers */
 CHANNEL_REC *channel_find(SERVER_REC *server, const char *name);
 
+/* Returns the channel's mode string */
+const char *channel_get_mode(CHANNEL_REC *channel);
+
 void channel_change_name(CHANNEL_REC *channel, const char *name);
 void channel_change_visible_name(CHANNEL_REC *channel, const char *name);
 
+/* Rebuild server->channels_hash, when the casefolding has changed */
+void channels_rehash(SERVER_REC *server);
+
 /* Send the auto send command to channel */
 void channel_send_autocommands(CHANNEL_REC *channel);
 
@@ -351,10 +351,10 @@ static char *expando_chanmode(SERVER_REC *server, void *item, int *free_ret)
 		return NULL;
 
         if (!settings_get_bool("chanmode_expando_strip"))
-		return CHANNEL(item)->mode;
+		return (char *) channel_get_mode(CHANNEL(item));
 
 	*free_ret = TRUE;
-	cmode = g_strdup(CHANNEL(item)->mode);
+	cmode = g_strdup(channel_get_mode(CHANNEL(item)));
 	args = strchr(cmode, ' ');
 	if (args != NULL)
 		*args = 0;
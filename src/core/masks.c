@@ -23,6 +23,7 @@
 #include "misc.h"
 
 #include "servers.h"
+#include "masks.h"
 
 /* Returns TRUE if mask contains '!' ie. address should be checked too.
    Also checks if mask contained any wildcards. */
@@ -96,6 +97,37 @@ int mask_match_address(SERVER_REC *server, const char *mask,
 	return ret;
 }
 
+MASK_REC *mask_compile(const char *mask)
+{
+	MASK_REC *rec;
+	int wildcards;
+
+	g_return_val_if_fail(mask != NULL, NULL);
+
+	rec = g_new0(MASK_REC, 1);
+	rec->mask = g_strdup(mask);
+	rec->address = check_address(mask, &wildcards);
+	rec->wildcards = wildcards;
+	return rec;
+}
+
+void mask_compiled_free(MASK_REC *mask)
+{
+	g_free(mask->mask);
+	g_free(mask);
+}
+
+int mask_match_compiled(SERVER_REC *server, const MASK_REC *mask,
+			const char *nick, const char *nickaddress)
+{
+	g_return_val_if_fail(server == NULL || IS_SERVER(server), FALSE);
+	g_return_val_if_fail(mask != NULL && nick != NULL, FALSE);
+
+	return check_mask(server, mask->mask,
+			  mask->address ? nickaddress : nick,
+			  mask->wildcards);
+}
+
 int masks_match(SERVER_REC *server, const char *masks,
 		const char *nick, const char *address)
 {
@@ -8,4 +8,18 @@ int mask_match_address(SERVER_REC *server, const char *mask,
 int masks_match(SERVER_REC *server, const char *masks,
 		const char *nick, const char *address);
 
+/* Mask with the address and wildcard checks done beforehand, for matching
+   it against many addresses */
+typedef struct {
+	char *mask;
+	unsigned int address:1; /* match against "nick!address" */
+	unsigned int wildcards:1;
+} MASK_REC;
+
+MASK_REC *mask_compile(const char *mask);
+void mask_compiled_free(MASK_REC *mask);
+/* `nickaddress' is "nick!address", it's used only if the mask needs it */
+int mask_match_compiled(SERVER_REC *server, const MASK_REC *mask,
+			const char *nick, const char *nickaddress);
+
 #endif
@@ -23,6 +23,7 @@
 #include <signal.h>
 
 #include "pidwait.h"
+#include "misc.h"
 #include "net-nonblock.h"
 
 #ifdef __APPLE__
@@ -39,6 +40,34 @@ typedef struct {
 	int tag;
 } SIMPLE_THREAD_REC;
 
+typedef struct {
+	NET_CONNECT_RACE_REC *race;
+
+	IPADDR ip;
+	GIOChannel *handle;
+	int tag;
+	GTimeVal start;
+} NET_CONNECT_ATTEMPT_REC;
+
+struct _NET_CONNECT_RACE_REC {
+	NET_CONNECT_ATTEMPT_REC *attempts;
+	int count; /* number of addresses */
+	int next; /* next address to try */
+	int pending; /* attempts in progress */
+	int error; /* errno of the last failed attempt */
+	IPADDR error_ip; /* and the address it was connecting to */
+
+	int port;
+	IPADDR *my_ip4, *my_ip6;
+	int delay, timeout_tag;
+
+	int in_callback;
+	unsigned int cancelled:1;
+
+	NET_RACE_CALLBACK func;
+	void *data;
+};
+
 static int g_io_channel_write_block(GIOChannel *channel, void *data, int len)
 {
         gsize ret;
@@ -255,18 +284,255 @@ void net_disconnect_nonblock(int pid)
 #endif
 }
 
-static void simple_init(SIMPLE_THREAD_REC *rec, GIOChannel *handle)
+static void race_attempt_close(NET_CONNECT_ATTEMPT_REC *attempt)
 {
-	g_return_if_fail(rec != NULL);
+	if (attempt->tag != -1) {
+		g_source_remove(attempt->tag);
+		attempt->tag = -1;
+	}
+	if (attempt->handle != NULL) {
+		net_disconnect(attempt->handle);
+		attempt->handle = NULL;
+	}
+}
 
-	g_source_remove(rec->tag);
+static void race_destroy(NET_CONNECT_RACE_REC *rec)
+{
+	int i;
 
-	if (net_geterror(handle) != 0) {
-		/* failed */
-		g_io_channel_close(handle);
-                g_io_channel_unref(handle);
-		handle = NULL;
+	for (i = 0; i < rec->count; i++)
+		race_attempt_close(&rec->attempts[i]);
+	if (rec->timeout_tag != -1)
+		g_source_remove(rec->timeout_tag);
+
+	g_free_not_null(rec->my_ip4);
+	g_free_not_null(rec->my_ip6);
+	g_free(rec->attempts);
+	g_free(rec);
+}
+
+static int race_attempt_msecs(NET_CONNECT_ATTEMPT_REC *attempt)
+{
+	GTimeVal now;
+
+	g_get_current_time(&now);
+	return (int) get_timeval_diff(&now, &attempt->start);
+}
+
+/* call func for an event that doesn't finish the race. Returns FALSE if
+   the race was cancelled from the callback. */
+static int race_notify(NET_CONNECT_RACE_REC *rec, int event, IPADDR *ip,
+		       int msecs, int error)
+{
+	rec->in_callback++;
+	rec->func(event, NULL, ip, msecs, error, rec->data);
+	rec->in_callback--;
+
+	if (!rec->cancelled)
+		return TRUE;
+
+	if (rec->in_callback == 0)
+		race_destroy(rec);
+	return FALSE;
+}
+
+static void race_start_next(NET_CONNECT_RACE_REC *rec);
+
+static void race_attempt_failed(NET_CONNECT_ATTEMPT_REC *attempt, int error)
+{
+	NET_CONNECT_RACE_REC *rec;
+	int msecs;
+
+	rec = attempt->race;
+	msecs = race_attempt_msecs(attempt);
+	race_attempt_close(attempt);
+	rec->pending--;
+	rec->error = error;
+	memcpy(&rec->error_ip, &attempt->ip, sizeof(IPADDR));
+
+	if (race_notify(rec, NET_RACE_ATTEMPT_FAILED, &attempt->ip,
+			msecs, error)) {
+		/* don't wait for the delay, try the next one now */
+		race_start_next(rec);
+	}
+}
+
+static void race_attempt_ready(NET_CONNECT_ATTEMPT_REC *attempt)
+{
+	NET_CONNECT_RACE_REC *rec;
+	NET_RACE_CALLBACK func;
+	GIOChannel *handle;
+	IPADDR ip;
+	void *data;
+	int error, msecs;
+
+	error = net_geterror(attempt->handle);
+	if (error != 0) {
+		race_attempt_failed(attempt, error);
+		return;
+	}
+
+	/* we have a winner, drop the rest */
+	rec = attempt->race;
+	g_source_remove(attempt->tag);
+	attempt->tag = -1;
+	handle = attempt->handle;
+	attempt->handle = NULL;
+
+	memcpy(&ip, &attempt->ip, sizeof(IPADDR));
+	msecs = race_attempt_msecs(attempt);
+	func = rec->func;
+	data = rec->data;
+	race_destroy(rec);
+
+	func(NET_RACE_CONNECTED, handle, &ip, msecs, 0, data);
+}
+
+static int race_timeout(NET_CONNECT_RACE_REC *rec)
+{
+	rec->timeout_tag = -1;
+	race_start_next(rec);
+	return FALSE;
+}
+
+static void race_start_next(NET_CONNECT_RACE_REC *rec)
+{
+	NET_CONNECT_ATTEMPT_REC *attempt;
+	NET_RACE_CALLBACK func;
+	IPADDR *my_ip, ip;
+	void *data;
+	int error;
+
+	if (rec->timeout_tag != -1) {
+		g_source_remove(rec->timeout_tag);
+		rec->timeout_tag = -1;
+	}
+
+	if (rec->next == rec->count) {
+		if (rec->pending == 0) {
+			/* nothing left to try */
+			func = rec->func;
+			data = rec->data;
+			error = rec->error;
+			memcpy(&ip, &rec->error_ip, sizeof(IPADDR));
+			race_destroy(rec);
+
+			func(NET_RACE_FAILED, NULL, &ip, 0, error, data);
+		}
+		return;
+	}
+
+	attempt = &rec->attempts[rec->next++];
+	if (!race_notify(rec, NET_RACE_ATTEMPT, &attempt->ip, 0, 0))
+		return;
+
+	my_ip = IPADDR_IS_V6(&attempt->ip) ? rec->my_ip6 : rec->my_ip4;
+	g_get_current_time(&attempt->start);
+	attempt->handle = net_connect_ip(&attempt->ip, rec->port, my_ip);
+	rec->pending++;
+
+	if (attempt->handle == NULL) {
+		race_attempt_failed(attempt, errno);
+		return;
+	}
+
+	attempt->tag = g_input_add(attempt->handle,
+				   G_INPUT_READ | G_INPUT_WRITE,
+				   (GInputFunction) race_attempt_ready,
+				   attempt);
+	if (rec->next < rec->count) {
+		rec->timeout_tag = g_timeout_add(rec->delay, (GSourceFunc)
+						 race_timeout, rec);
+	}
+}
+
+/* Sort the resolved addresses into the order they should be tried,
+   preferred family first, and return the number of them. */
+int net_resolved_ips(RESOLVED_IP_REC *rec, int prefer_ipv6, IPADDR *ips[2])
+{
+	IPADDR *first, *second;
+	int count;
+
+	g_return_val_if_fail(rec != NULL, 0);
+
+	if (rec->error != 0)
+		return 0;
+
+	first = prefer_ipv6 ? &rec->ip6 : &rec->ip4;
+	second = prefer_ipv6 ? &rec->ip4 : &rec->ip6;
+
+	count = 0;
+	if (first->family != 0)
+		ips[count++] = first;
+	if (second->family != 0)
+		ips[count++] = second;
+	return count;
+}
+
+static IPADDR *ipaddr_dup(const IPADDR *ip)
+{
+	IPADDR *dup;
+
+	if (ip == NULL)
+		return NULL;
+
+	dup = g_new(IPADDR, 1);
+	memcpy(dup, ip, sizeof(IPADDR));
+	return dup;
+}
+
+/* Connect to the first of the ips that answers. A new attempt is started
+   every `delay' milliseconds or immediately when one fails, until one of
+   them connects. my_ip4 and my_ip6 are the local addresses to bind to. */
+NET_CONNECT_RACE_REC *net_connect_race(IPADDR **ips, int count, int port,
+				       IPADDR *my_ip4, IPADDR *my_ip6,
+				       int delay, NET_RACE_CALLBACK func,
+				       void *data)
+{
+	NET_CONNECT_RACE_REC *rec;
+	int i;
+
+	g_return_val_if_fail(ips != NULL, NULL);
+	g_return_val_if_fail(count > 0, NULL);
+	g_return_val_if_fail(func != NULL, NULL);
+
+	rec = g_new0(NET_CONNECT_RACE_REC, 1);
+	rec->attempts = g_new0(NET_CONNECT_ATTEMPT_REC, count);
+	for (i = 0; i < count; i++) {
+		rec->attempts[i].race = rec;
+		rec->attempts[i].tag = -1;
+		memcpy(&rec->attempts[i].ip, ips[i], sizeof(IPADDR));
 	}
+	rec->count = count;
+	rec->port = port;
+	rec->my_ip4 = ipaddr_dup(my_ip4);
+	rec->my_ip6 = ipaddr_dup(my_ip6);
+	rec->delay = delay;
+	rec->func = func;
+	rec->data = data;
+
+	/* start from the main loop so func is never called before we've
+	   returned the record to the caller */
+	rec->timeout_tag = g_timeout_add(0, (GSourceFunc) race_timeout, rec);
+	return rec;
+}
+
+/* Abort all attempts, func isn't called anymore */
+void net_connect_race_cancel(NET_CONNECT_RACE_REC *rec)
+{
+	g_return_if_fail(rec != NULL);
+
+	if (rec->in_callback > 0)
+		rec->cancelled = TRUE;
+	else
+		race_destroy(rec);
+}
+
+static void simple_race(int event, GIOChannel *handle, IPADDR *ip,
+			int msecs, int error, SIMPLE_THREAD_REC *rec)
+{
+	if (event != NET_RACE_CONNECTED && event != NET_RACE_FAILED)
+		return;
 
 	rec->func(handle, rec->data);
 	g_free(rec);
@@ -275,8 +541,8 @@ static void simple_init(SIMPLE_THREAD_REC *rec, GIOChannel *handle)
 static void simple_readpipe(SIMPLE_THREAD_REC *rec, GIOChannel *pipe)
 {
 	RESOLVED_IP_REC iprec;
-	GIOChannel *handle;
-	IPADDR *ip;
+	IPADDR *ips[2], *my_ip;
+	int count;
 
 	g_return_if_fail(rec != NULL);
 
@@ -290,21 +556,25 @@ static void simple_readpipe(SIMPLE_THREAD_REC *rec, GIOChannel *pipe)
 	g_io_channel_close(rec->pipes[1]);
 	g_io_channel_unref(rec->pipes[1]);
 
-	ip = iprec.ip4.family != 0 ? &iprec.ip4 : &iprec.ip6;
-	handle = iprec.error == -1 ? NULL :
-		net_connect_ip(ip, rec->port, rec->my_ip);
-
-	g_free_not_null(rec->my_ip);
+	count = net_resolved_ips(&iprec, FALSE, ips);
+	my_ip = rec->my_ip;
+	rec->my_ip = NULL;
 
-	if (handle == NULL) {
+	if (count == 0) {
 		/* failed */
+		g_free_not_null(my_ip);
 		rec->func(NULL, rec->data);
 		g_free(rec);
 		return;
 	}
 
-	rec->tag = g_input_add(handle, G_INPUT_READ | G_INPUT_WRITE,
-			       (GInputFunction) simple_init, rec);
+	/* bind only the address family we were given a local address for */
+	net_connect_race(ips, count, rec->port,
+			 my_ip != NULL && !IPADDR_IS_V6(my_ip) ? my_ip : NULL,
+			 my_ip != NULL && IPADDR_IS_V6(my_ip) ? my_ip : NULL,
+			 NET_CONNECT_RACE_DELAY,
+			 (NET_RACE_CALLBACK) simple_race, rec);
+	g_free_not_null(my_ip);
 }
 
 /* Connect to server, call func when finished */
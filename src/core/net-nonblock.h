@@ -21,8 +21,26 @@ typedef struct {
 	char *errorstr;
 } RESOLVED_NAME_REC;
 
+/* default delay in milliseconds before the next address is tried */
+#define NET_CONNECT_RACE_DELAY 250
+
+enum {
+	NET_RACE_ATTEMPT, /* connecting to ip started */
+	NET_RACE_ATTEMPT_FAILED, /* connecting to ip failed, others may be
+				    still in progress */
+	NET_RACE_CONNECTED, /* connected to ip, all other attempts aborted */
+	NET_RACE_FAILED /* all attempts failed */
+};
+
 typedef void (*NET_CALLBACK) (GIOChannel *, void *);
 typedef void (*NET_HOST_CALLBACK) (RESOLVED_NAME_REC *, void *);
+/* event is one of NET_RACE_xxx, msecs is the time the attempt took and
+   error the errno of a failed attempt. handle is non-NULL only with
+   NET_RACE_CONNECTED. With NET_RACE_FAILED, ip and error are the ones of
+   the last failed attempt. After NET_RACE_CONNECTED and NET_RACE_FAILED the
+   race is destroyed. */
+typedef void (*NET_RACE_CALLBACK) (int event, GIOChannel *handle, IPADDR *ip,
+				   int msecs, int error, void *data);
 
 /* nonblocking gethostbyname(), PID of the resolver child is returned. */
 int net_gethostbyname_nonblock(const char *addr, GIOChannel *pipe,
@@ -35,6 +53,20 @@ int net_gethostbyname_return(GIOChannel *pipe, RESOLVED_IP_REC *rec);
 /* Connect to server, call func when finished */
 int net_connect_nonblock(const char *server, int port, const IPADDR *my_ip,
 			 NET_CALLBACK func, void *data);
+/* Sort the resolved addresses into the order they should be tried,
+   preferred family first, and return the number of them. */
+int net_resolved_ips(RESOLVED_IP_REC *rec, int prefer_ipv6, IPADDR *ips[2]);
+
+/* Connect to the first of the ips that answers. A new attempt is started
+   every `delay' milliseconds or immediately when one fails, until one of
+   them connects. my_ip4 and my_ip6 are the local addresses to bind to. */
+NET_CONNECT_RACE_REC *net_connect_race(IPADDR **ips, int count, int port,
+				       IPADDR *my_ip4, IPADDR *my_ip6,
+				       int delay, NET_RACE_CALLBACK func,
+				       void *data);
+/* Abort all attempts, func isn't called anymore */
+void net_connect_race_cancel(NET_CONNECT_RACE_REC *rec);
+
 /* Kill the resolver child */
 void net_disconnect_nonblock(int pid);
 
@@ -34,6 +34,7 @@ NET_SENDBUF_REC *net_sendbuffer_create(GIOChannel *handle, int bufsize)
 
 	rec = g_new0(NET_SENDBUF_REC, 1);
         rec->send_tag = -1;
+        rec->flush_tag = -1;
 	rec->handle = handle;
 	rec->bufsize = bufsize > 0 ? bufsize : DEFAULT_BUFFER_SIZE;
 	rec->def_bufsize = rec->bufsize;
@@ -41,16 +42,6 @@ NET_SENDBUF_REC *net_sendbuffer_create(GIOChannel *handle, int bufsize)
 	return rec;
 }
 
-/* Destroy the buffer. `close' specifies if socket handle should be closed. */
-void net_sendbuffer_destroy(NET_SENDBUF_REC *rec, int close)
-{
-        if (rec->send_tag != -1) g_source_remove(rec->send_tag);
-	if (close) net_disconnect(rec->handle);
-	if (rec->readbuffer != NULL) line_split_free(rec->readbuffer);
-	g_free_not_null(rec->buffer);
-	g_free(rec);
-}
-
 /* Transmit all data from buffer - return TRUE if the whole buffer was sent */
 static int buffer_send(NET_SENDBUF_REC *rec)
 {
@@ -72,6 +63,23 @@ static int buffer_send(NET_SENDBUF_REC *rec)
 	return FALSE;
 }
 
+/* Destroy the buffer. `close' specifies if socket handle should be closed. */
+void net_sendbuffer_destroy(NET_SENDBUF_REC *rec, int close)
+{
+        if (rec->send_tag != -1) g_source_remove(rec->send_tag);
+	if (rec->flush_tag != -1) {
+		/* coalesced data hasn't been tried to be sent yet (eg.
+		   QUIT just before disconnecting), give it the same chance
+		   it would have had without coalescing */
+		g_source_remove(rec->flush_tag);
+		buffer_send(rec);
+	}
+	if (close) net_disconnect(rec->handle);
+	if (rec->readbuffer != NULL) line_split_free(rec->readbuffer);
+	g_free_not_null(rec->buffer);
+	g_free(rec);
+}
+
 static void sig_sendbuffer(NET_SENDBUF_REC *rec)
 {
 	if (rec->buffer != NULL) {
@@ -83,6 +91,18 @@ static void sig_sendbuffer(NET_SENDBUF_REC *rec)
 	rec->send_tag = -1;
 }
 
+static int sig_sendbuffer_flush(NET_SENDBUF_REC *rec)
+{
+	rec->flush_tag = -1;
+
+	if (!buffer_send(rec) && rec->send_tag == -1) {
+		rec->send_tag =
+			g_input_add(rec->handle, G_INPUT_WRITE,
+				    (GInputFunction) sig_sendbuffer, rec);
+	}
+	return FALSE;
+}
+
 /* Add `data' to transmit buffer - return FALSE if buffer is full */
 static int buffer_add(NET_SENDBUF_REC *rec, const void *data, int size)
 {
@@ -118,6 +138,15 @@ int net_sendbuffer_send(NET_SENDBUF_REC *rec, const void *data, int size)
 	g_return_val_if_fail(data != NULL, -1);
 	if (size <= 0) return 0;
 
+	if (rec->coalesce && rec->send_tag == -1) {
+		/* send it when we get back to main loop */
+		if (rec->flush_tag == -1) {
+			rec->flush_tag = g_idle_add((GSourceFunc)
+						    sig_sendbuffer_flush, rec);
+		}
+		return buffer_add(rec, data, size) ? 0 : -1;
+	}
+
 	if (rec->buffer == NULL || rec->bufpos == 0) {
                 /* nothing in buffer - transmit immediately */
 		ret = net_transmit(rec->handle, data, size);
@@ -155,6 +184,11 @@ void net_sendbuffer_flush(NET_SENDBUF_REC *rec)
 {
 	int handle;
 
+	if (rec->flush_tag != -1) {
+		g_source_remove(rec->flush_tag);
+		rec->flush_tag = -1;
+	}
+
 	if (rec->buffer == NULL)
 		return;
 
@@ -9,11 +9,15 @@ struct _NET_SENDBUF_REC {
         LINEBUF_REC *readbuffer; /* receive buffer */
 
         int send_tag;
+        int flush_tag;
         int bufsize;
         int bufpos;
         char *buffer; /* Buffer is NULL until it's actually needed. */
         int def_bufsize;
         unsigned int dead:1;
+        /* gather everything sent during one main loop iteration into a
+           single write, useful for SSL where each write is a record */
+        unsigned int coalesce:1;
 };
 
 /* Create new buffer - if `bufsize' is zero or less, DEFAULT_BUFFER_SIZE
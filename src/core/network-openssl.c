@@ -37,6 +37,15 @@
 #include <validator/val_dane.h>
 #endif
 
+/* SSL contexts are shared by all connections using the same client
+   certificate and CA settings */
+typedef struct
+{
+	char *key;
+	SSL_CTX *ctx;
+	int refcount;
+} SSL_CTX_REC;
+
 /* ssl i/o channel object */
 typedef struct
 {
@@ -44,20 +53,66 @@ typedef struct
 	gint fd;
 	GIOChannel *giochan;
 	SSL *ssl;
-	SSL_CTX *ctx;
+	SSL_CTX_REC *ctx;
 	unsigned int verify:1;
 	SERVER_REC *server;
 	int port;
+	char *session_key; /* "<ctx key>\naddress:port" */
 } GIOSSLChannel;
 
 static int ssl_inited = FALSE;
 
+static GHashTable *ssl_contexts; /* key -> SSL_CTX_REC */
+/* "<ctx key>\naddress:port" -> SSL_SESSION. The context is part of the key
+   so that a session set up with one client certificate is never resumed
+   by a connection using another one. */
+static GHashTable *ssl_sessions;
+
+static void ssl_ctx_unref(SSL_CTX_REC *rec)
+{
+	if (--rec->refcount > 0)
+		return;
+
+	g_hash_table_remove(ssl_contexts, rec->key);
+	SSL_CTX_free(rec->ctx);
+	g_free(rec->key);
+	g_free(rec);
+}
+
+static void ssl_session_forget(const char *key)
+{
+	gpointer origkey, session;
+
+	if (g_hash_table_lookup_extended(ssl_sessions, key,
+					 &origkey, &session)) {
+		g_hash_table_remove(ssl_sessions, key);
+		SSL_SESSION_free(session);
+		g_free(origkey);
+	}
+}
+
+/* called by OpenSSL whenever the server gives us a new session,
+   with TLSv1.3 this happens after the handshake */
+static int ssl_session_new(SSL *ssl, SSL_SESSION *session)
+{
+	GIOSSLChannel *chan = SSL_get_app_data(ssl);
+
+	if (chan == NULL)
+		return 0;
+
+	ssl_session_forget(chan->session_key);
+	g_hash_table_insert(ssl_sessions, g_strdup(chan->session_key),
+			    session);
+	return 1; /* we keep the reference */
+}
+
 static void irssi_ssl_free(GIOChannel *handle)
 {
 	GIOSSLChannel *chan = (GIOSSLChannel *)handle;
 	g_io_channel_unref(chan->giochan);
 	SSL_free(chan->ssl);
-	SSL_CTX_free(chan->ctx);
+	ssl_ctx_unref(chan->ctx);
+	g_free(chan->session_key);
 	g_free(chan);
 }
 
@@ -427,41 +482,51 @@ static gboolean irssi_ssl_init(void)
 	SSL_library_init();
 	SSL_load_error_strings();
 	OpenSSL_add_all_algorithms();
+	ssl_contexts = g_hash_table_new(g_str_hash, g_str_equal);
+	ssl_sessions = g_hash_table_new(g_str_hash, g_str_equal);
 	ssl_inited = TRUE;
 
 	return TRUE;
 
 }
 
-static GIOChannel *irssi_ssl_get_iochannel(GIOChannel *handle, int port, SERVER_REC *server)
+static SSL_CTX_REC *ssl_ctx_get(SERVER_CONNECT_REC *conn)
 {
-	GIOSSLChannel *chan;
-	GIOChannel *gchan;
-	int fd;
-	SSL *ssl;
-	SSL_CTX *ctx = NULL;
-
-	const char *mycert = server->connrec->ssl_cert;
-	const char *mypkey = server->connrec->ssl_pkey;
-	const char *cafile = server->connrec->ssl_cafile;
-	const char *capath = server->connrec->ssl_capath;
-	gboolean verify = server->connrec->ssl_verify;
-
-	g_return_val_if_fail(handle != NULL, NULL);
-
-	if(!ssl_inited && !irssi_ssl_init())
-		return NULL;
-
-	if(!(fd = g_io_channel_unix_get_fd(handle)))
-		return NULL;
+	SSL_CTX_REC *rec;
+	SSL_CTX *ctx;
+	char *key;
+
+	const char *mycert = conn->ssl_cert;
+	const char *mypkey = conn->ssl_pkey;
+	const char *cafile = conn->ssl_cafile;
+	const char *capath = conn->ssl_capath;
+
+	key = g_strdup_printf("%s\n%s\n%s\n%s",
+			      mycert != NULL ? mycert : "",
+			      mypkey != NULL ? mypkey : "",
+			      cafile != NULL ? cafile : "",
+			      capath != NULL ? capath : "");
+	rec = g_hash_table_lookup(ssl_contexts, key);
+	if (rec != NULL) {
+		g_free(key);
+		rec->refcount++;
+		return rec;
+	}
 
 	ctx = SSL_CTX_new(SSLv23_client_method());
 	if (ctx == NULL) {
 		g_error("Could not allocate memory for SSL context");
+		g_free(key);
 		return NULL;
 	}
 	SSL_CTX_set_options(ctx, SSL_OP_NO_SSLv2);
 
+	/* we store the sessions ourself, keyed by the context and the
+	   server address */
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+				       SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ctx, ssl_session_new);
+
 	if (mycert && *mycert) {
 		char *scert = NULL, *spkey = NULL;
 		scert = convert_home(mycert);
@@ -489,20 +554,57 @@ static GIOChannel *irssi_ssl_get_iochannel(GIOChannel *handle, int port, SERVER_
 			g_free(scafile);
 			g_free(scapath);
 			SSL_CTX_free(ctx);
+			g_free(key);
 			return NULL;
 		}
 		g_free(scafile);
 		g_free(scapath);
-		verify = TRUE;
 	} else {
 		if (!SSL_CTX_set_default_verify_paths(ctx))
 			g_warning("Could not load default certificates");
 	}
 
-	if(!(ssl = SSL_new(ctx)))
+	rec = g_new0(SSL_CTX_REC, 1);
+	rec->key = key;
+	rec->ctx = ctx;
+	rec->refcount = 1;
+	g_hash_table_insert(ssl_contexts, rec->key, rec);
+	return rec;
+}
+
+static GIOChannel *irssi_ssl_get_iochannel(GIOChannel *handle, int port, SERVER_REC *server)
+{
+	GIOSSLChannel *chan;
+	GIOChannel *gchan;
+	int fd;
+	SSL *ssl;
+	SSL_CTX_REC *ctx;
+	SSL_SESSION *session;
+	char *session_key;
+
+	const char *cafile = server->connrec->ssl_cafile;
+	const char *capath = server->connrec->ssl_capath;
+	gboolean verify = server->connrec->ssl_verify;
+
+	g_return_val_if_fail(handle != NULL, NULL);
+
+	if(!ssl_inited && !irssi_ssl_init())
+		return NULL;
+
+	if(!(fd = g_io_channel_unix_get_fd(handle)))
+		return NULL;
+
+	ctx = ssl_ctx_get(server->connrec);
+	if (ctx == NULL)
+		return NULL;
+
+	if ((cafile && *cafile) || (capath && *capath))
+		verify = TRUE;
+
+	if(!(ssl = SSL_new(ctx->ctx)))
 	{
 		g_warning("Failed to allocate SSL structure");
-		SSL_CTX_free(ctx);
+		ssl_ctx_unref(ctx);
 		return NULL;
 	}
 
@@ -510,13 +612,21 @@ static GIOChannel *irssi_ssl_get_iochannel(GIOChannel *handle, int port, SERVER_
 	{
 		g_warning("Failed to associate socket to SSL stream");
 		SSL_free(ssl);
-		SSL_CTX_free(ctx);
+		ssl_ctx_unref(ctx);
 		return NULL;
 	}
 
 	SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE |
 			SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
+	/* try to resume the previous session to this server made with
+	   the same certificate settings */
+	session_key = g_strdup_printf("%s\n%s:%d", ctx->key,
+				      server->connrec->address, port);
+	session = g_hash_table_lookup(ssl_sessions, session_key);
+	if (session != NULL)
+		SSL_set_session(ssl, session);
+
 	chan = g_new0(GIOSSLChannel, 1);
 	chan->fd = fd;
 	chan->giochan = handle;
@@ -525,6 +635,8 @@ static GIOChannel *irssi_ssl_get_iochannel(GIOChannel *handle, int port, SERVER_
 	chan->server = server;
 	chan->port = port;
 	chan->verify = verify;
+	chan->session_key = session_key;
+	SSL_set_app_data(ssl, chan);
 
 	gchan = (GIOChannel *)chan;
 	gchan->funcs = &irssi_ssl_channel_funcs;
@@ -548,6 +660,11 @@ GIOChannel *net_connect_ip_ssl(IPADDR *ip, int port, IPADDR *my_ip, SERVER_REC *
 	return ssl_handle;
 }
 
+GIOChannel *net_start_ssl(GIOChannel *handle, int port, SERVER_REC *server)
+{
+	return irssi_ssl_get_iochannel(handle, port, server);
+}
+
 int irssi_ssl_handshake(GIOChannel *handle)
 {
 	GIOSSLChannel *chan = (GIOSSLChannel *)handle;
@@ -558,6 +675,10 @@ int irssi_ssl_handshake(GIOChannel *handle)
 	ret = SSL_connect(chan->ssl);
 	if (ret <= 0) {
 		err = SSL_get_error(chan->ssl, ret);
+		if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) {
+			/* don't try to resume a session that didn't work */
+			ssl_session_forget(chan->session_key);
+		}
 		switch (err) {
 			case SSL_ERROR_WANT_READ:
 				return 1;
@@ -584,8 +705,10 @@ int irssi_ssl_handshake(GIOChannel *handle)
 		g_warning("SSL server supplied no certificate");
 		return -1;
 	}
-	ret = !chan->verify || irssi_ssl_verify(chan->ssl, chan->ctx, chan->server->connrec->address, chan->port, cert, chan->server);
+	ret = !chan->verify || irssi_ssl_verify(chan->ssl, chan->ctx->ctx, chan->server->connrec->address, chan->port, cert, chan->server);
 	X509_free(cert);
+	if (!ret)
+		ssl_session_forget(chan->session_key);
 	return ret ? 0 : -1;
 }
 
@@ -598,4 +721,11 @@ GIOChannel *net_connect_ip_ssl(IPADDR *ip, int port, IPADDR *my_ip, SERVER_REC *
 	return NULL;
 }
 
+GIOChannel *net_start_ssl(GIOChannel *handle, int port, SERVER_REC *server)
+{
+	g_warning("Connection failed: SSL support not enabled in this build.");
+	errno = ENOSYS;
+	return NULL;
+}
+
 #endif /* ! HAVE_OPENSSL */
@@ -6,6 +6,7 @@ int chat_type; /* chat_protocol_lookup(xx) */
 time_t last_check; /* last time gone was checked */
 
 char *nick;
+char *key; /* nick casefolded for the server, used as the hash key */
 char *host;
 char *realname;
 int hops;
@@ -30,15 +30,91 @@
 #define isalnumhigh(a) \
         (i_isalnum(a) || (unsigned char) (a) >= 128)
 
+static char *nick_casefold(SERVER_REC *server, const char *nick)
+{
+	return server != NULL ? server_casefold(server, nick) :
+		ascii_strdown(g_strdup(nick));
+}
+
+/* keep track of the channels each nick is in, so we don't need to go
+   through all the channels in server to find them */
+static void nick_index_add(CHANNEL_REC *channel, NICK_REC *nick)
+{
+	SERVER_REC *server;
+	GSList *list;
+	char *key;
+
+	server = channel->server;
+	if (server == NULL)
+		return;
+
+	if (server->nick_channels == NULL) {
+		server->nick_channels =
+			g_hash_table_new((GHashFunc) g_str_hash,
+					 (GCompareFunc) g_str_equal);
+	}
+
+	if (!g_hash_table_lookup_extended(server->nick_channels, nick->key,
+					  (gpointer *) &key,
+					  (gpointer *) &list)) {
+		key = g_strdup(nick->key);
+		list = NULL;
+	}
+
+	list = g_slist_prepend(list, nick);
+	list = g_slist_prepend(list, channel);
+	g_hash_table_insert(server->nick_channels, key, list);
+}
+
+static void nick_index_remove(CHANNEL_REC *channel, NICK_REC *nick)
+{
+	SERVER_REC *server;
+	GSList *list, *tmp;
+	char *key;
+
+	server = channel->server;
+	if (server == NULL || server->nick_channels == NULL)
+		return;
+
+	if (!g_hash_table_lookup_extended(server->nick_channels, nick->key,
+					  (gpointer *) &key,
+					  (gpointer *) &list))
+		return;
+
+	for (tmp = list; tmp != NULL; tmp = tmp->next->next) {
+		if (tmp->next->data == nick) {
+			list = g_slist_delete_link(list, tmp->next);
+			list = g_slist_delete_link(list, tmp);
+			break;
+		}
+	}
+
+	if (list != NULL) {
+		g_hash_table_insert(server->nick_channels, key, list);
+		return;
+	}
+
+	g_hash_table_remove(server->nick_channels, key);
+	g_free(key);
+
+	if (g_hash_table_size(server->nick_channels) == 0) {
+		g_hash_table_destroy(server->nick_channels);
+		server->nick_channels = NULL;
+	}
+}
+
 static void nick_hash_add(CHANNEL_REC *channel, NICK_REC *nick)
 {
 	NICK_REC *list;
 
 	nick->next = NULL;
 
-	list = g_hash_table_lookup(channel->nicks, nick->nick);
+	g_free_not_null(nick->key);
+	nick->key = nick_casefold(channel->server, nick->nick);
+
+	list = g_hash_table_lookup(channel->nicks, nick->key);
         if (list == NULL)
-		g_hash_table_insert(channel->nicks, nick->nick, nick);
+		g_hash_table_insert(channel->nicks, nick->key, nick);
 	else {
                 /* multiple nicks with same name */
 		while (list->next != NULL)
@@ -50,20 +126,24 @@ static void nick_hash_add(CHANNEL_REC *channel, NICK_REC *nick)
                 /* move our own nick to beginning of the nick list.. */
 		nicklist_set_own(channel, nick);
 	}
+
+	nick_index_add(channel, nick);
 }
 
 static void nick_hash_remove(CHANNEL_REC *channel, NICK_REC *nick)
 {
 	NICK_REC *list;
 
-	list = g_hash_table_lookup(channel->nicks, nick->nick);
+	list = g_hash_table_lookup(channel->nicks, nick->key);
 	if (list == NULL)
 		return;
 
+	nick_index_remove(channel, nick);
+
 	if (list == nick || list->next == NULL) {
-		g_hash_table_remove(channel->nicks, nick->nick);
+		g_hash_table_remove(channel->nicks, nick->key);
 		if (list->next != NULL) {
-			g_hash_table_insert(channel->nicks, nick->next->nick,
+			g_hash_table_insert(channel->nicks, nick->next->key,
 					    nick->next);
 		}
 	} else {
@@ -107,6 +187,7 @@ static void nicklist_destroy(CHANNEL_REC *channel, NICK_REC *nick)
 
         /*MODULE_DATA_DEINIT(nick);*/
 	g_free(nick->nick);
+	g_free_not_null(nick->key);
 	g_free_not_null(nick->realname);
 	g_free_not_null(nick->host);
 	g_free(nick);
@@ -208,10 +289,16 @@ GSList *nicklist_find_multiple(CHANNEL_REC *channel, const char *mask)
 /* Find nick */
 NICK_REC *nicklist_find(CHANNEL_REC *channel, const char *nick)
 {
+	NICK_REC *rec;
+	char *key;
+
 	g_return_val_if_fail(IS_CHANNEL(channel), NULL);
 	g_return_val_if_fail(nick != NULL, NULL);
 
-	return g_hash_table_lookup(channel->nicks, nick);
+	key = nick_casefold(channel->server, nick);
+	rec = g_hash_table_lookup(channel->nicks, key);
+	g_free(key);
+	return rec;
 }
 
 NICK_REC *nicklist_find_unique(CHANNEL_REC *channel, const char *nick,
@@ -222,7 +309,7 @@ NICK_REC *nicklist_find_unique(CHANNEL_REC *channel, const char *nick,
 	g_return_val_if_fail(IS_CHANNEL(channel), NULL);
 	g_return_val_if_fail(nick != NULL, NULL);
 
-	rec = g_hash_table_lookup(channel->nicks, nick);
+	rec = nicklist_find(channel, nick);
 	while (rec != NULL && rec->unique_id != id)
                 rec = rec->next;
 
@@ -247,7 +334,7 @@ NICK_REC *nicklist_find_mask(CHANNEL_REC *channel, const char *mask)
 		return nicklist_find_wildcards(channel, mask);
 	}
 
-	nickrec = g_hash_table_lookup(channel->nicks, nick);
+	nickrec = nicklist_find(channel, nick);
 
 	if (host != NULL) {
 		while (nickrec != NULL) {
@@ -281,40 +368,21 @@ GSList *nicklist_getnicks(CHANNEL_REC *channel)
 	return list;
 }
 
-typedef struct {
-        CHANNEL_REC *channel;
-	const char *nick;
-	GSList *list;
-} NICKLIST_GET_SAME_REC;
-
-static void get_nicks_same_hash(gpointer key, NICK_REC *nick,
-				NICKLIST_GET_SAME_REC *rec)
-{
-	while (nick != NULL) {
-		if (g_strcasecmp(nick->nick, rec->nick) == 0) {
-			rec->list = g_slist_append(rec->list, rec->channel);
-			rec->list = g_slist_append(rec->list, nick);
-		}
-
-		nick = nick->next;
-	}
-}
-
 GSList *nicklist_get_same(SERVER_REC *server, const char *nick)
 {
-	NICKLIST_GET_SAME_REC rec;
-	GSList *tmp;
+	GSList *list;
+	char *key;
 
 	g_return_val_if_fail(IS_SERVER(server), NULL);
+	g_return_val_if_fail(nick != NULL, NULL);
 
-	rec.nick = nick;
-	rec.list = NULL;
-	for (tmp = server->channels; tmp != NULL; tmp = tmp->next) {
-		rec.channel = tmp->data;
-		g_hash_table_foreach(rec.channel->nicks,
-				     (GHFunc) get_nicks_same_hash, &rec);
-	}
-	return rec.list;
+	if (server->nick_channels == NULL)
+		return NULL;
+
+	key = nick_casefold(server, nick);
+	list = g_slist_copy(g_hash_table_lookup(server->nick_channels, key));
+	g_free(key);
+	return list;
 }
 
 typedef struct {
@@ -455,7 +523,7 @@ void nicklist_set_own(CHANNEL_REC *channel, NICK_REC *nick)
 
 	/* move our nick in the list to first, makes some things easier
 	   (like handling multiple identical nicks in fe-messages.c) */
-	first = g_hash_table_lookup(channel->nicks, nick->nick);
+	first = g_hash_table_lookup(channel->nicks, nick->key);
 	if (first->next == NULL)
 		return;
 
@@ -466,15 +534,48 @@ void nicklist_set_own(CHANNEL_REC *channel, NICK_REC *nick)
                 first = first->next;
 	first->next = next;
 
-        g_hash_table_insert(channel->nicks, nick->nick, nick);
+        g_hash_table_insert(channel->nicks, nick->key, nick);
+}
+
+static void nick_channels_free(char *key, GSList *list)
+{
+	g_free(key);
+	g_slist_free(list);
+}
+
+void nicklist_rehash(SERVER_REC *server)
+{
+	GSList *tmp, *nicks, *ntmp;
+
+	g_return_if_fail(IS_SERVER(server));
+
+	if (server->nick_channels != NULL) {
+		g_hash_table_foreach(server->nick_channels,
+				     (GHFunc) nick_channels_free, NULL);
+		g_hash_table_destroy(server->nick_channels);
+		server->nick_channels = NULL;
+	}
+
+	for (tmp = server->channels; tmp != NULL; tmp = tmp->next) {
+		CHANNEL_REC *channel = tmp->data;
+
+		nicks = nicklist_getnicks(channel);
+		g_hash_table_destroy(channel->nicks);
+		channel->nicks = g_hash_table_new((GHashFunc) g_str_hash,
+						  (GCompareFunc) g_str_equal);
+
+		for (ntmp = nicks; ntmp != NULL; ntmp = ntmp->next)
+			nick_hash_add(channel, ntmp->data);
+		g_slist_free(nicks);
+	}
 }
 
 static void sig_channel_created(CHANNEL_REC *channel)
 {
 	g_return_if_fail(IS_CHANNEL(channel));
 
-	channel->nicks = g_hash_table_new((GHashFunc) g_istr_hash,
-					  (GCompareFunc) g_istr_equal);
+	channel->nicks = g_hash_table_new((GHashFunc) g_str_hash,
+					  (GCompareFunc) g_str_equal);
 }
 
 static void nicklist_remove_hash(gpointer key, NICK_REC *nick,
@@ -484,6 +585,7 @@ static void nicklist_remove_hash(gpointer key, NICK_REC *nick,
 
 	while (nick != NULL) {
                 next = nick->next;
+		nick_index_remove(channel, nick);
 		nicklist_destroy(channel, nick);
                 nick = next;
 	}
@@ -504,7 +606,7 @@ static NICK_REC *nick_nfind(CHANNEL_REC *channel, const char *nick, int len)
 	char *tmpnick;
 
 	tmpnick = g_strndup(nick, len);
-	rec = g_hash_table_lookup(channel->nicks, tmpnick);
+	rec = nicklist_find(channel, tmpnick);
 
 	if (rec != NULL) {
 		/* if there's multiple, get the one with identical case */
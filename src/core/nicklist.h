@@ -56,6 +56,10 @@ int nicklist_compare(NICK_REC *p1, NICK_REC *p2, const char *nick_prefix);
 /* Check is `msg' is meant for `nick'. */
 int nick_match_msg(CHANNEL_REC *channel, const char *msg, const char *nick);
 
+/* Recalculate the nick hash keys, when the server's casefolding
+   has changed */
+void nicklist_rehash(SERVER_REC *server);
+
 void nicklist_init(void);
 void nicklist_deinit(void);
 
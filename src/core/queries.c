@@ -32,6 +32,29 @@ static const char *query_get_target(WI_ITEM_REC *item)
 	return ((QUERY_REC *) item)->name;
 }
 
+static void query_hash_add(QUERY_REC *query)
+{
+	server_name_hash_add(query->server, &query->server->queries_hash,
+			     query->name, query);
+}
+
+static void query_hash_remove(QUERY_REC *query)
+{
+	server_name_hash_remove(query->server, query->server->queries_hash,
+				query->name, query);
+}
+
+void queries_rehash(SERVER_REC *server)
+{
+	GSList *tmp;
+
+	g_return_if_fail(IS_SERVER(server));
+
+	server_name_hash_destroy(&server->queries_hash);
+	for (tmp = server->queries; tmp != NULL; tmp = tmp->next)
+		query_hash_add(tmp->data);
+}
+
 void query_init(QUERY_REC *query, int automatic)
 {
 	g_return_if_fail(query != NULL);
@@ -52,6 +75,7 @@ void query_init(QUERY_REC *query, int automatic)
 		if (query->server != NULL) {
 			query->server->queries =
 				g_slist_append(query->server->queries, query);
+			query_hash_add(query);
 		}
 	}
 
@@ -69,6 +93,7 @@ void query_destroy(QUERY_REC *query)
 	if (query->server != NULL) {
 		query->server->queries =
 			g_slist_remove(query->server->queries, query);
+		query_hash_remove(query);
 	}
 	signal_emit("query destroyed", 1, query);
 
@@ -85,8 +110,6 @@ void query_destroy(QUERY_REC *query)
 
 static QUERY_REC *query_find_server(SERVER_REC *server, const char *nick)
 {
-	GSList *tmp;
-
 	g_return_val_if_fail(IS_SERVER(server), NULL);
 
 	if (server->query_find_func != NULL) {
@@ -94,14 +117,7 @@ static QUERY_REC *query_find_server(SERVER_REC *server, const char *nick)
 		return server->query_find_func(server, nick);
 	}
 
-	for (tmp = server->queries; tmp != NULL; tmp = tmp->next) {
-		QUERY_REC *rec = tmp->data;
-
-		if (g_strcasecmp(rec->name, nick) == 0)
-			return rec;
-	}
-
-	return NULL;
+	return server_name_hash_find(server, server->queries_hash, nick);
 }
 
 QUERY_REC *query_find(SERVER_REC *server, const char *nick)
@@ -130,9 +146,15 @@ void query_change_nick(QUERY_REC *query, const char *nick)
 
 	g_return_if_fail(IS_QUERY(query));
 
+	if (query->server != NULL)
+		query_hash_remove(query);
+
         oldnick = query->name;
 	query->name = g_strdup(nick);
 
+	if (query->server != NULL)
+		query_hash_add(query);
+
 	g_free(query->visible_name);
 	query->visible_name = g_strdup(nick);
 
@@ -157,11 +179,15 @@ void query_change_server(QUERY_REC *query, SERVER_REC *server)
 	if (query->server != NULL) {
 		query->server->queries =
                         g_slist_remove(query->server->queries, query);
+		query_hash_remove(query);
 	}
-	if (server != NULL)
-                server->queries = g_slist_append(server->queries, query);
 
 	query->server = server;
+	if (server != NULL) {
+                server->queries = g_slist_append(server->queries, query);
+		query_hash_add(query);
+	}
+
 	signal_emit("query server changed", 1, query);
 }
 
@@ -28,6 +28,9 @@ void query_change_nick(QUERY_REC *query, const char *nick);
 void query_change_address(QUERY_REC *query, const char *address);
 void query_change_server(QUERY_REC *query, SERVER_REC *server);
 
+/* Rebuild server->queries_hash, when the casefolding has changed */
+void queries_rehash(SERVER_REC *server);
+
 void queries_init(void);
 void queries_deinit(void);
 
@@ -41,3 +41,5 @@ unsigned int ssl_verify:1;
 unsigned int no_connect:1; /* don't connect() at all, it's done by plugin */
 char *channels;
 char *away_reason;
+
+int reconnect_attempts; /* failed reconnects since last successful connect */
@@ -25,6 +25,7 @@ int readtag; /* input tag */
 GIOChannel *connect_pipe[2];
 int connect_tag;
 int connect_pid;
+NET_CONNECT_RACE_REC *connect_race; /* connect attempts in progress */
 
 RAWLOG_REC *rawlog;
 GHashTable *module_data;
@@ -43,6 +44,10 @@ int lag; /* server lag in milliseconds */
 
 GSList *channels;
 GSList *queries;
+GHashTable *nick_channels; /* nick -> channel, nick, channel, nick, ... for
+			      every channel the nick is in */
+GHashTable *channels_hash; /* casefolded name and visible_name -> GSList of channels */
+GHashTable *queries_hash; /* casefolded name -> GSList of queries */
 
 /* -- support for multiple server types -- */
 
@@ -68,5 +73,11 @@ QUERY_REC *(*query_find_func)(SERVER_REC *server, const char *nick);
 int (*mask_match_func)(const char *mask, const char *data);
 /* returns true if `msg' was meant for `nick' */
 int (*nick_match_msg)(const char *nick, const char *msg);
+/* returns the number of commands waiting to be sent to server */
+int (*get_send_queue_length)(SERVER_REC *server);
+/* casefold `str' in place so that names that the server considers equal
+   become equal. ASCII lowercasing is used if NULL. Change it only with
+   server_set_casefold(). */
+void (*casefold_func)(char *str);
 
 #undef STRUCT_SERVER_CONNECT_REC
@@ -27,15 +27,51 @@
 #include "servers.h"
 #include "servers-setup.h"
 #include "servers-reconnect.h"
+#include "chatnets.h"
 
 #include "settings.h"
 
+/* never wait longer than this many times server_reconnect_time */
+#define RECONNECT_MAX_BACKOFF 64
+
 GSList *reconnects;
 static int last_reconnect_tag;
 static int reconnect_timeout_tag;
-static int reconnect_time;
+static int reconnect_time, reconnect_max_time;
+static int max_connecting;
 static int connect_timeout;
 
+/* Exponential backoff from server_reconnect_time up to
+   server_reconnect_max_time, plus up to 25% of random jitter so that
+   servers which were lost at the same time don't reconnect at the
+   same time. */
+static int reconnect_delay(SERVER_CONNECT_REC *conn)
+{
+	int delay, attempts;
+
+	delay = reconnect_time;
+	for (attempts = conn->reconnect_attempts; attempts > 0; attempts--) {
+		if (delay >= reconnect_time * RECONNECT_MAX_BACKOFF)
+			break;
+		delay *= 2;
+	}
+
+	if (reconnect_max_time > 0 && delay > reconnect_max_time)
+		delay = MAX(reconnect_max_time, reconnect_time);
+
+	if (delay >= 4)
+		delay += g_random_int_range(0, delay/4);
+	return delay;
+}
+
+static int reconnect_priority(SERVER_CONNECT_REC *conn)
+{
+	CHATNET_REC *chatnet;
+
+	chatnet = conn->chatnet == NULL ? NULL : chatnet_find(conn->chatnet);
+	return chatnet == NULL ? 0 : chatnet->reconnect_priority;
+}
+
 void reconnect_save_status(SERVER_CONNECT_REC *conn, SERVER_REC *server)
 {
         g_free_not_null(conn->tag);
@@ -68,6 +104,7 @@ static void server_reconnect_add(SERVER_CONNECT_REC *conn,
 	rec = g_new(RECONNECT_REC, 1);
 	rec->tag = ++last_reconnect_tag;
 	rec->next_connect = next_connect;
+	rec->priority = reconnect_priority(conn);
 
 	rec->conn = conn;
 	conn->reconnecting = TRUE;
@@ -90,47 +127,103 @@ void server_reconnect_destroy(RECONNECT_REC *rec)
 	    last_reconnect_tag = 0;
 }
 
-static int server_reconnect_timeout(void)
+int server_reconnect_connecting_count(void)
 {
-	SERVER_CONNECT_REC *conn;
-	GSList *list, *tmp, *next;
+	GSList *tmp;
 	time_t now;
+	int count;
 
+	/* servers are in lookup_servers until the connection is made,
+	   after that count them until they're registered to the server */
 	now = time(NULL);
-
-	/* timeout any connections that haven't gotten to connected-stage */
-	for (tmp = servers; tmp != NULL; tmp = next) {
+	count = g_slist_length(lookup_servers);
+	for (tmp = servers; tmp != NULL; tmp = tmp->next) {
 		SERVER_REC *server = tmp->data;
 
-		next = tmp->next;
-		if (!server->connected &&
-		    server->connect_time + connect_timeout < now &&
-		    connect_timeout > 0) {
-			server->connection_lost = TRUE;
-			server_disconnect(server);
-		}
+		if ((!server->connected || server->real_connect_time == 0) &&
+		    (connect_timeout <= 0 ||
+		     server->connect_time + connect_timeout >= now))
+			count++;
 	}
 
+	return count;
+}
+
+static int reconnect_cmp(RECONNECT_REC *r1, RECONNECT_REC *r2)
+{
+	if (r1->priority != r2->priority)
+		return r1->priority > r2->priority ? -1 : 1;
+
+	return r1->next_connect < r2->next_connect ? -1 :
+		r1->next_connect > r2->next_connect ? 1 : 0;
+}
+
+/* start the reconnects whose time has come, highest priority first,
+   while there are free connection slots */
+static void server_reconnect_start(void)
+{
+	SERVER_CONNECT_REC *conn;
+	GSList *list, *tmp;
+	time_t now;
+	int slots;
+
+	now = time(NULL);
+	list = NULL;
+	for (tmp = reconnects; tmp != NULL; tmp = tmp->next) {
+		RECONNECT_REC *rec = tmp->data;
+
+		if (rec->next_connect <= now)
+			list = g_slist_insert_sorted(list, rec, (GCompareFunc) reconnect_cmp);
+	}
+
+	if (list == NULL)
+		return;
+
+	slots = max_connecting <= 0 ? -1 :
+		max_connecting - server_reconnect_connecting_count();
+
 	/* If server_connect() removes the next reconnection in queue,
 	   we're screwed. I don't think this should happen anymore, but just
 	   to be sure we don't crash, do this safely. */
-	list = g_slist_copy(reconnects);
-	for (tmp = list; tmp != NULL; tmp = tmp->next) {
+	for (tmp = list; tmp != NULL && slots != 0; tmp = tmp->next) {
 		RECONNECT_REC *rec = tmp->data;
 
 		if (g_slist_find(reconnects, rec) == NULL)
 			continue;
 
-		if (rec->next_connect <= now) {
-			conn = rec->conn;
-			server_connect_ref(conn);
-			server_reconnect_destroy(rec);
-			server_connect(conn);
-			server_connect_unref(conn);
-		}
+		conn = rec->conn;
+		server_connect_ref(conn);
+		server_reconnect_destroy(rec);
+		server_connect(conn);
+		server_connect_unref(conn);
+
+		if (slots > 0) slots--;
 	}
 
 	g_slist_free(list);
+}
+
+static int server_reconnect_timeout(void)
+{
+	GSList *tmp, *next;
+	time_t now;
+
+	now = time(NULL);
+
+	/* timeout any connections that haven't gotten to connected-stage */
+	for (tmp = servers; tmp != NULL; tmp = next) {
+		SERVER_REC *server = tmp->data;
+
+		next = tmp->next;
+		if (!server->connected &&
+		    server->connect_time + connect_timeout < now &&
+		    connect_timeout > 0) {
+			server->connection_lost = TRUE;
+			server_disconnect(server);
+		}
+	}
+
+	server_reconnect_start();
 	return 1;
 }
 
@@ -141,7 +234,7 @@ static void sserver_connect(SERVER_SETUP_REC *rec, SERVER_CONNECT_REC *conn)
 	if (conn->port == 0) conn->port = rec->port;
 
 	server_setup_fill_reconn(conn, rec);
-	server_reconnect_add(conn, rec->last_connect+reconnect_time);
+	server_reconnect_add(conn, rec->last_connect+reconnect_delay(conn));
 	server_connect_unref(conn);
 }
 
@@ -190,6 +283,7 @@ server_connect_copy_skeleton(SERVER_CONNECT_REC *src, int connect_info)
 	dest->away_reason = g_strdup(src->away_reason);
 	dest->no_autojoin_channels = src->no_autojoin_channels;
 	dest->no_autosendcmd = src->no_autosendcmd;
+	dest->reconnect_attempts = src->reconnect_attempts;
 
 	dest->use_ssl = src->use_ssl;
 	dest->ssl_cert = g_strdup(src->ssl_cert);
@@ -233,6 +327,10 @@ static void sig_reconnect(SERVER_REC *server)
                 reconnect_save_status(conn, server);
 	}
 
+	/* back off if we couldn't get registered to the server */
+	conn->reconnect_attempts = server->real_connect_time != 0 ? 0 :
+		server->connrec->reconnect_attempts+1;
+
 	sserver = server_setup_find(server->connrec->address,
 				    server->connrec->port,
 				    server->connrec->chatnet);
@@ -254,7 +352,7 @@ static void sig_reconnect(SERVER_REC *server)
 		conn->password = g_strdup(server->connrec->password);
 
 		server_reconnect_add(conn, (server->connect_time == 0 ? time(NULL) :
-					    server->connect_time) + reconnect_time);
+					    server->connect_time) + reconnect_delay(conn));
 		server_connect_unref(conn);
 		return;
 	}
@@ -341,32 +439,22 @@ static RECONNECT_REC *reconnect_find_tag(int tag)
 	return NULL;
 }
 
+/* make all reconnects due now, the scheduler starts them as connection
+   slots become free */
 static void reconnect_all(void)
 {
-	GSList *list;
-	SERVER_CONNECT_REC *conn;
-	RECONNECT_REC *rec;
+	GSList *tmp;
+	time_t now;
 
-	/* first move reconnects to another list so if server_connect()
-	   fails and goes to reconnection list again, we won't get stuck
-	   here forever */
-	list = NULL;
-	while (reconnects != NULL) {
-		rec = reconnects->data;
+	now = time(NULL);
+	for (tmp = reconnects; tmp != NULL; tmp = tmp->next) {
+		RECONNECT_REC *rec = tmp->data;
 
-		list = g_slist_append(list, rec->conn);
-                server_connect_ref(rec->conn);
-		server_reconnect_destroy(rec);
+		if (rec->next_connect > now)
+			rec->next_connect = now;
 	}
 
-
-	while (list != NULL) {
-		conn = list->data;
-
-		server_connect(conn);
-                server_connect_unref(conn);
-                list = g_slist_remove(list, conn);
-	}
+	server_reconnect_start();
 }
 
 /* SYNTAX: RECONNECT <tag> [<quit message>] */
@@ -468,12 +556,16 @@ static void sig_chat_protocol_deinit(CHAT_PROTOCOL_REC *proto)
 static void read_settings(void)
 {
 	reconnect_time = settings_get_time("server_reconnect_time")/1000;
+	reconnect_max_time = settings_get_time("server_reconnect_max_time")/1000;
+	max_connecting = settings_get_int("server_reconnect_max_connecting");
         connect_timeout = settings_get_time("server_connect_timeout")/1000;
 }
 
 void servers_reconnect_init(void)
 {
 	settings_add_time("server", "server_reconnect_time", "5min");
+	settings_add_time("server", "server_reconnect_max_time", "1h");
+	settings_add_int("server", "server_reconnect_max_connecting", 5);
 	settings_add_time("server", "server_connect_timeout", "5min");
 
 	reconnects = NULL;
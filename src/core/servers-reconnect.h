@@ -8,12 +8,17 @@
 typedef struct {
         int tag;
 	time_t next_connect;
+	int priority; /* chatnet's reconnect_priority */
 
 	SERVER_CONNECT_REC *conn;
 } RECONNECT_REC;
 
 extern GSList *reconnects;
 
+/* Number of connections that haven't finished connecting yet, reconnects
+   wait while there are server_reconnect_max_connecting of them */
+int server_reconnect_connecting_count(void);
+
 void reconnect_save_status(SERVER_CONNECT_REC *conn, SERVER_REC *server);
 void server_reconnect_destroy(RECONNECT_REC *rec);
 
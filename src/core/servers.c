@@ -34,9 +34,62 @@
 #include "servers-setup.h"
 #include "channels.h"
 #include "queries.h"
+#include "nicklist.h"
 
 GSList *servers, *lookup_servers;
 
+/* connected servers by tag, and lists of them by chatnet in the
+   same order as in `servers' */
+static GHashTable *servers_tag_hash, *servers_chatnet_hash;
+
+static void server_hash_add(SERVER_REC *server)
+{
+	const char *chatnet;
+	GSList *list;
+	char *key;
+
+	if (g_hash_table_lookup(servers_tag_hash, server->tag) == NULL)
+		g_hash_table_insert(servers_tag_hash, server->tag, server);
+
+	chatnet = server->connrec->chatnet;
+	if (chatnet == NULL || *chatnet == '\0')
+		return;
+
+	if (!g_hash_table_lookup_extended(servers_chatnet_hash, chatnet,
+					  (gpointer *) &key,
+					  (gpointer *) &list)) {
+		key = g_strdup(chatnet);
+		list = NULL;
+	}
+	list = g_slist_append(list, server);
+	g_hash_table_insert(servers_chatnet_hash, key, list);
+}
+
+static void server_hash_remove(SERVER_REC *server)
+{
+	const char *chatnet;
+	GSList *list;
+	char *key;
+
+	if (g_hash_table_lookup(servers_tag_hash, server->tag) == server)
+		g_hash_table_remove(servers_tag_hash, server->tag);
+
+	chatnet = server->connrec->chatnet;
+	if (chatnet == NULL || *chatnet == '\0' ||
+	    !g_hash_table_lookup_extended(servers_chatnet_hash, chatnet,
+					  (gpointer *) &key,
+					  (gpointer *) &list))
+		return;
+
+	list = g_slist_remove(list, server);
+	if (list != NULL)
+		g_hash_table_insert(servers_chatnet_hash, key, list);
+	else {
+		g_hash_table_remove(servers_chatnet_hash, key);
+		g_free(key);
+	}
+}
+
 /* connection to server failed */
 void server_connect_failed(SERVER_REC *server, const char *msg)
 {
@@ -50,6 +103,10 @@ void server_connect_failed(SERVER_REC *server, const char *msg)
 		g_source_remove(server->connect_tag);
 		server->connect_tag = -1;
 	}
+	if (server->connect_race != NULL) {
+		net_connect_race_cancel(server->connect_race);
+		server->connect_race = NULL;
+	}
 	if (server->handle != NULL) {
 		net_sendbuffer_destroy(server->handle, TRUE);
 		server->handle = NULL;
@@ -144,6 +201,7 @@ void server_connect_finished(SERVER_REC *server)
 	server->connect_time = time(NULL);
 
 	servers = g_slist_append(servers, server);
+	server_hash_add(server);
 	signal_emit("server connected", 1, server);
 }
 
@@ -200,60 +258,138 @@ static void server_connect_callback_init_ssl(SERVER_REC *server, GIOChannel *han
 }
 #endif
 
-static void server_real_connect(SERVER_REC *server, IPADDR *ip,
-				const char *unix_socket)
+static void server_real_connect_failed(SERVER_REC *server, int error,
+				      IPADDR *own_ip)
 {
-	GIOChannel *handle;
-	IPADDR *own_ip = NULL;
 	const char *errmsg;
 	char *errmsg2;
 	char ipaddr[MAX_IP_LEN];
-        int port;
 
-	g_return_if_fail(ip != NULL || unix_socket != NULL);
+	errmsg = g_strerror(error);
+	errmsg2 = NULL;
+	if (error == EADDRNOTAVAIL) {
+		if (own_ip != NULL) {
+			/* show the IP which is causing the error */
+			net_ip2host(own_ip, ipaddr);
+			errmsg2 = g_strconcat(errmsg, ": ", ipaddr, NULL);
+		}
+		server->no_reconnect = TRUE;
+	}
+	if (server->connrec->use_ssl && error == ENOSYS)
+		server->no_reconnect = TRUE;
+
+	server->connection_lost = TRUE;
+	server_connect_failed(server, errmsg2 ? errmsg2 : errmsg);
+	g_free(errmsg2);
+}
 
-	signal_emit("server connecting", 2, server, ip);
+/* TCP connection is up, start SSL or the login */
+static void server_connect_handle(SERVER_REC *server, GIOChannel *handle,
+				  int port)
+{
+	GIOChannel *ssl_handle;
+	int error;
 
-	if (server->connrec->no_connect)
+	if (server->connrec->use_ssl) {
+		ssl_handle = net_start_ssl(handle, port, server);
+		if (ssl_handle == NULL) {
+			error = errno;
+			net_disconnect(handle);
+			server_real_connect_failed(server, error, NULL);
+			return;
+		}
+		handle = ssl_handle;
+	}
+
+	server->handle = net_sendbuffer_create(handle, 0);
+#ifdef HAVE_OPENSSL
+	/* fewer SSL records */
+	server->handle->coalesce = server->connrec->use_ssl;
+	if (server->connrec->use_ssl) {
+		server_connect_callback_init_ssl(server, handle);
 		return;
+	}
+#endif
 
-	if (ip != NULL) {
-		own_ip = ip == NULL ? NULL :
-			(IPADDR_IS_V6(ip) ? server->connrec->own_ip6 :
-			 server->connrec->own_ip4);
-		port = server->connrec->proxy != NULL ?
-			server->connrec->proxy_port : server->connrec->port;
-		handle = server->connrec->use_ssl ?
-			net_connect_ip_ssl(ip, port, own_ip, server) : net_connect_ip(ip, port, own_ip);
-	} else {
-		handle = net_connect_unix(unix_socket);
+	lookup_servers = g_slist_remove(lookup_servers, server);
+	server_connect_finished(server);
+}
+
+static int server_connect_port(SERVER_REC *server)
+{
+	return server->connrec->proxy != NULL ?
+		server->connrec->proxy_port : server->connrec->port;
+}
+
+static void server_connect_race_callback(int event, GIOChannel *handle,
+					 IPADDR *ip, int msecs, int error,
+					 SERVER_REC *server)
+{
+	SERVER_CONNECT_REC *conn;
+
+	conn = server->connrec;
+	switch (event) {
+	case NET_RACE_ATTEMPT:
+		signal_emit("server connecting", 2, server, ip);
+		break;
+	case NET_RACE_ATTEMPT_FAILED:
+		signal_emit("server connect attempt", 4, server, ip,
+			    GINT_TO_POINTER(msecs), g_strerror(error));
+		break;
+	case NET_RACE_CONNECTED:
+		server->connect_race = NULL;
+		signal_emit("server connect attempt", 4, server, ip,
+			    GINT_TO_POINTER(msecs), NULL);
+		server_connect_handle(server, handle,
+				      server_connect_port(server));
+		break;
+	case NET_RACE_FAILED:
+		server->connect_race = NULL;
+		/* the bind address of the failed attempt's family */
+		server_real_connect_failed(server, error,
+					   IPADDR_IS_V6(ip) ?
+					   conn->own_ip6 : conn->own_ip4);
+		break;
+	}
+}
+
+/* connect to the first of the addresses that answers */
+static void server_real_connect(SERVER_REC *server, IPADDR **ips, int count)
+{
+	g_return_if_fail(ips != NULL && count > 0);
+
+	if (server->connrec->no_connect) {
+		signal_emit("server connecting", 2, server, ips[0]);
+		return;
 	}
 
+	server->connect_race =
+		net_connect_race(ips, count, server_connect_port(server),
+				 server->connrec->own_ip4,
+				 server->connrec->own_ip6,
+				 settings_get_time("server_connect_race_delay"),
+				 (NET_RACE_CALLBACK)
+				 server_connect_race_callback, server);
+}
+
+static void server_real_connect_unix(SERVER_REC *server,
+				     const char *unix_socket)
+{
+	GIOChannel *handle;
+
+	g_return_if_fail(unix_socket != NULL);
+
+	signal_emit("server connecting", 2, server, NULL);
+
+	if (server->connrec->no_connect)
+		return;
+
+	handle = net_connect_unix(unix_socket);
 	if (handle == NULL) {
 		/* failed */
-		errmsg = g_strerror(errno);
-		errmsg2 = NULL;
-		if (errno == EADDRNOTAVAIL) {
-			if (own_ip != NULL) {
-				/* show the IP which is causing the error */
-				net_ip2host(own_ip, ipaddr);
-				errmsg2 = g_strconcat(errmsg, ": ", ipaddr, NULL);
-			}
-			server->no_reconnect = TRUE;
-		}
-		if (server->connrec->use_ssl && errno == ENOSYS)
-			server->no_reconnect = TRUE;
-
-		server->connection_lost = TRUE;
-		server_connect_failed(server, errmsg2 ? errmsg2 : errmsg);
-		g_free(errmsg2);
+		server_real_connect_failed(server, errno, NULL);
 	} else {
 		server->handle = net_sendbuffer_create(handle, 0);
-#ifdef HAVE_OPENSSL
-		if (server->connrec->use_ssl)
-			server_connect_callback_init_ssl(server, handle);
-		else
-#endif
 		server->connect_tag =
 			g_input_add(handle, G_INPUT_WRITE | G_INPUT_READ,
 				    (GInputFunction)
@@ -265,9 +401,10 @@ static void server_real_connect(SERVER_REC *server, IPADDR *ip,
 static void server_connect_callback_readpipe(SERVER_REC *server)
 {
 	RESOLVED_IP_REC iprec;
-        IPADDR *ip;
+	IPADDR *ips[2];
 	const char *errormsg;
-	char *servername = NULL;
+	char *servername;
+	int count;
 
 	g_source_remove(server->connect_tag);
 	server->connect_tag = -1;
@@ -282,39 +419,34 @@ static void server_connect_callback_readpipe(SERVER_REC *server)
 	server->connect_pipe[0] = NULL;
 	server->connect_pipe[1] = NULL;
 
-	/* figure out if we should use IPv4 or v6 address */
+	/* figure out if we should use IPv4 or v6 address. if both were
+	   found, try them both - /SET resolve_prefer_ipv6 says which one
+	   gets a head start. */
 	if (iprec.error != 0) {
                 /* error */
-		ip = NULL;
+		count = 0;
 	} else if (server->connrec->family == AF_INET) {
 		/* force IPv4 connection */
-		ip = iprec.ip4.family == 0 ? NULL : &iprec.ip4;
-		servername = iprec.host4;
+		count = iprec.ip4.family == 0 ? 0 : 1;
+		ips[0] = &iprec.ip4;
 	} else if (server->connrec->family == AF_INET6) {
 		/* force IPv6 connection */
-		ip = iprec.ip6.family == 0 ? NULL : &iprec.ip6;
-		servername = iprec.host6;
+		count = iprec.ip6.family == 0 ? 0 : 1;
+		ips[0] = &iprec.ip6;
 	} else {
-		/* pick the one that was found, or if both do it like
-		   /SET resolve_prefer_ipv6 says. */
-		if (iprec.ip4.family == 0 ||
-		    (iprec.ip6.family != 0 &&
-		     settings_get_bool("resolve_prefer_ipv6"))) {
-			ip = &iprec.ip6;
-			servername = iprec.host6;
-		} else {
-			ip = &iprec.ip4;
-			servername = iprec.host4;
-		}
+		count = net_resolved_ips(&iprec,
+					 settings_get_bool("resolve_prefer_ipv6"),
+					 ips);
 	}
 
-	if (ip != NULL) {
+	if (count > 0) {
 		/* host lookup ok */
+		servername = ips[0] == &iprec.ip4 ? iprec.host4 : iprec.host6;
 		if (servername) {
 			g_free(server->connrec->address);
 			server->connrec->address = g_strdup(servername);
 		}
-		server_real_connect(server, ip, NULL);
+		server_real_connect(server, ips, count);
 		errormsg = NULL;
 	} else {
 		if (iprec.error == 0 || net_hosterror_notfound(iprec.error)) {
@@ -407,7 +539,7 @@ int server_start_connect(SERVER_REC *server)
 		server_connect_finished(server);
 	} else if (server->connrec->unix_socket) {
 		/* connect with unix socket */
-		server_real_connect(server, NULL, server->connrec->address);
+		server_real_connect_unix(server, server->connrec->address);
 	} else {
 		/* resolve host name */
 		if (pipe(fd) != 0) {
@@ -473,7 +605,7 @@ void server_disconnect(SERVER_REC *server)
 	if (server->disconnected)
 		return;
 
-	if (server->connect_tag != -1) {
+	if (server->connect_tag != -1 || server->connect_race != NULL) {
 		/* still connecting to server.. */
 		if (server->connect_pid != -1)
 			net_disconnect_nonblock(server->connect_pid);
@@ -482,6 +614,7 @@ void server_disconnect(SERVER_REC *server)
 	}
 
 	servers = g_slist_remove(servers, server);
+	server_hash_remove(server);
 
 	server->disconnected = TRUE;
 	signal_emit("server disconnected", 1, server);
@@ -531,6 +664,8 @@ int server_unref(SERVER_REC *server)
 	}
 
         MODULE_DATA_DEINIT(server);
+	server_name_hash_destroy(&server->channels_hash);
+	server_name_hash_destroy(&server->queries_hash);
 	server_connect_unref(server->connrec);
 	if (server->rawlog != NULL) rawlog_destroy(server->rawlog);
 	g_free(server->version);
@@ -545,19 +680,10 @@ int server_unref(SERVER_REC *server)
 
 SERVER_REC *server_find_tag(const char *tag)
 {
-	GSList *tmp;
-
 	g_return_val_if_fail(tag != NULL, NULL);
 	if (*tag == '\0') return NULL;
 
-	for (tmp = servers; tmp != NULL; tmp = tmp->next) {
-		SERVER_REC *server = tmp->data;
-
-		if (g_strcasecmp(server->tag, tag) == 0)
-			return server;
-	}
-
-	return NULL;
+	return g_hash_table_lookup(servers_tag_hash, tag);
 }
 
 SERVER_REC *server_find_lookup_tag(const char *tag)
@@ -579,20 +705,13 @@ SERVER_REC *server_find_lookup_tag(const char *tag)
 
 SERVER_REC *server_find_chatnet(const char *chatnet)
 {
-	GSList *tmp;
+	GSList *list;
 
 	g_return_val_if_fail(chatnet != NULL, NULL);
 	if (*chatnet == '\0') return NULL;
 
-	for (tmp = servers; tmp != NULL; tmp = tmp->next) {
-		SERVER_REC *server = tmp->data;
-
-		if (server->connrec->chatnet != NULL &&
-		    g_strcasecmp(server->connrec->chatnet, chatnet) == 0)
-			return server;
-	}
-
-	return NULL;
+	list = g_hash_table_lookup(servers_chatnet_hash, chatnet);
+	return list == NULL ? NULL : list->data;
 }
 
 void server_connect_ref(SERVER_CONNECT_REC *conn)
@@ -677,6 +796,119 @@ void server_connect_own_ip_save(SERVER_CONNECT_REC *conn,
 	}
 }
 
+char *server_casefold(SERVER_REC *server, const char *str)
+{
+	char *ret;
+
+	g_return_val_if_fail(str != NULL, NULL);
+
+	ret = g_strdup(str);
+	if (server->casefold_func != NULL)
+		server->casefold_func(ret);
+	else
+		ascii_strdown(ret);
+	return ret;
+}
+
+void server_set_casefold(SERVER_REC *server, void (*func)(char *str))
+{
+	g_return_if_fail(IS_SERVER(server));
+
+	if (server->casefold_func == func)
+		return;
+
+	server->casefold_func = func;
+	channels_rehash(server);
+	queries_rehash(server);
+	nicklist_rehash(server);
+}
+
+void server_name_hash_add(SERVER_REC *server, GHashTable **hash,
+			  const char *name, void *data)
+{
+	GSList *list;
+	char *key;
+
+	if (*hash == NULL) {
+		*hash = g_hash_table_new((GHashFunc) g_str_hash,
+					 (GCompareFunc) g_str_equal);
+	}
+
+	/* records sharing the casefolded name are kept in a list, the
+	   first one added is the one that's found */
+	key = server_casefold(server, name);
+	list = g_hash_table_lookup(*hash, key);
+	if (list == NULL)
+		g_hash_table_insert(*hash, key, g_slist_append(NULL, data));
+	else {
+		g_slist_append(list, data);
+		g_free(key);
+	}
+}
+
+int server_name_hash_remove(SERVER_REC *server, GHashTable *hash,
+			    const char *name, void *data)
+{
+	void *origkey, *value;
+	GSList *list, *link;
+	char *key;
+
+	if (hash == NULL)
+		return FALSE;
+
+	key = server_casefold(server, name);
+	if (!g_hash_table_lookup_extended(hash, key, &origkey, &value)) {
+		g_free(key);
+		return FALSE;
+	}
+	g_free(key);
+
+	list = value;
+	link = g_slist_find(list, data);
+	if (link == NULL)
+		return FALSE;
+
+	list = g_slist_delete_link(list, link);
+	if (list != NULL)
+		g_hash_table_insert(hash, origkey, list);
+	else {
+		g_hash_table_remove(hash, origkey);
+		g_free(origkey);
+	}
+	return TRUE;
+}
+
+void *server_name_hash_find(SERVER_REC *server, GHashTable *hash,
+			    const char *name)
+{
+	GSList *list;
+	char *key;
+
+	if (hash == NULL)
+		return NULL;
+
+	key = server_casefold(server, name);
+	list = g_hash_table_lookup(hash, key);
+	g_free(key);
+	return list == NULL ? NULL : list->data;
+}
+
+static void name_hash_free(void *key, GSList *list)
+{
+	g_slist_free(list);
+	g_free(key);
+}
+
+void server_name_hash_destroy(GHashTable **hash)
+{
+	if (*hash == NULL)
+		return;
+
+	g_hash_table_foreach(*hash, (GHFunc) name_hash_free, NULL);
+	g_hash_table_destroy(*hash);
+	*hash = NULL;
+}
+
 /* `optlist' should contain only one unknown key - the server tag.
    returns NULL if there was unknown -option */
 SERVER_REC *cmd_options_get_server(const char *cmd,
@@ -740,7 +972,12 @@ void servers_init(void)
 {
 	settings_add_bool("server", "resolve_prefer_ipv6", FALSE);
 	settings_add_bool("server", "resolve_reverse_lookup", FALSE);
+	settings_add_time("server", "server_connect_race_delay", "250msec");
 	lookup_servers = servers = NULL;
+	servers_tag_hash = g_hash_table_new((GHashFunc) g_istr_hash,
+					    (GCompareFunc) g_istr_equal);
+	servers_chatnet_hash = g_hash_table_new((GHashFunc) g_istr_hash,
+						(GCompareFunc) g_istr_equal);
 
 	signal_add("chat protocol deinit", (SIGNAL_FUNC) sig_chat_protocol_deinit);
 
@@ -755,6 +992,9 @@ void servers_deinit(void)
 	servers_setup_deinit();
 	servers_reconnect_deinit();
 
+	g_hash_table_destroy(servers_tag_hash);
+	g_hash_table_destroy(servers_chatnet_hash);
+
 	module_uniq_destroy("SERVER");
 	module_uniq_destroy("SERVER CONNECT");
 }
@@ -66,6 +66,23 @@ void server_connect_failed(SERVER_REC *server, const char *msg);
 /* Change your nick */
 void server_change_nick(SERVER_REC *server, const char *nick);
 
+/* Returns `str' casefolded with server's casefold_func */
+char *server_casefold(SERVER_REC *server, const char *str);
+/* Change the casefolding function and rebuild the name hashes with it */
+void server_set_casefold(SERVER_REC *server, void (*func)(char *str));
+
+/* Hashes of channels and queries by their casefolded names. If several
+   records have the same name, the one added first is found. */
+void server_name_hash_add(SERVER_REC *server, GHashTable **hash,
+			  const char *name, void *data);
+/* Remove `data' if it's in the hash with `name'. Returns TRUE if it
+   was, FALSE if it wasn't found. */
+int server_name_hash_remove(SERVER_REC *server, GHashTable *hash,
+			    const char *name, void *data);
+void *server_name_hash_find(SERVER_REC *server, GHashTable *hash,
+			    const char *name);
+void server_name_hash_destroy(GHashTable **hash);
+
 /* Update own IPv4 and IPv6 records */
 void server_connect_own_ip_save(SERVER_CONNECT_REC *conn,
 				IPADDR *ip4, IPADDR *ip6);
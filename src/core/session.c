@@ -25,6 +25,7 @@
 #include "network.h"
 #include "net-sendbuffer.h"
 #include "pidwait.h"
+#include "session.h"
 #include "lib-config/iconfig.h"
 
 #include "chat-protocols.h"
@@ -32,11 +33,279 @@
 #include "servers-setup.h"
 #include "channels.h"
 #include "nicklist.h"
+#include "misc.h"
+
+#include <sys/mman.h>
+
+#define SESSION_SNAPSHOT_MAGIC "IRSSISS1"
+#define SESSION_SNAPSHOT_MAGIC_LEN 8
+
+/* session_snapshot_put_str() length of NULL string */
+#define SNAPSHOT_NULL_STR (-1)
+
+#define SNAPSHOT_NICK_OP	0x01
+#define SNAPSHOT_NICK_HALFOP	0x02
+#define SNAPSHOT_NICK_VOICE	0x04
 
 static char *session_file;
 char *irssi_binary = NULL;
 
 static char **session_args;
+static SESSION_SNAPSHOT_REC *snapshot;
+
+int session_snapshot_offset(SESSION_SNAPSHOT_REC *rec)
+{
+	return rec->data->len;
+}
+
+void session_snapshot_put_int(SESSION_SNAPSHOT_REC *rec, int value)
+{
+	g_string_append_len(rec->data, (const char *) &value,
+			    sizeof(value));
+}
+
+void session_snapshot_put_str(SESSION_SNAPSHOT_REC *rec, const char *str)
+{
+	int len;
+
+	if (str == NULL) {
+		session_snapshot_put_int(rec, SNAPSHOT_NULL_STR);
+		return;
+	}
+
+	/* keep the \0 so restoring can point directly to the map */
+	len = strlen(str);
+	session_snapshot_put_int(rec, len);
+	g_string_append_len(rec->data, str, len+1);
+}
+
+void session_snapshot_put_data(SESSION_SNAPSHOT_REC *rec,
+			       const void *data, int len)
+{
+	session_snapshot_put_int(rec, len);
+	g_string_append_len(rec->data, data, len);
+}
+
+int session_snapshot_seek(SESSION_SNAPSHOT_REC *rec, int offset)
+{
+	if (offset < SESSION_SNAPSHOT_MAGIC_LEN ||
+	    (size_t) offset > rec->map_size)
+		return FALSE;
+
+	rec->pos = offset;
+	return TRUE;
+}
+
+int session_snapshot_get_int(SESSION_SNAPSHOT_REC *rec, int *value)
+{
+	if (rec->map_size - rec->pos < sizeof(*value))
+		return FALSE;
+
+	memcpy(value, rec->map + rec->pos, sizeof(*value));
+	rec->pos += sizeof(*value);
+	return TRUE;
+}
+
+int session_snapshot_get_data(SESSION_SNAPSHOT_REC *rec,
+			      const void **data, int *len)
+{
+	if (!session_snapshot_get_int(rec, len) || *len < 0 ||
+	    rec->map_size - rec->pos < (size_t) *len)
+		return FALSE;
+
+	*data = rec->map + rec->pos;
+	rec->pos += *len;
+	return TRUE;
+}
+
+int session_snapshot_get_str(SESSION_SNAPSHOT_REC *rec, const char **str)
+{
+	int len;
+
+	if (!session_snapshot_get_int(rec, &len))
+		return FALSE;
+
+	if (len == SNAPSHOT_NULL_STR) {
+		*str = NULL;
+		return TRUE;
+	}
+
+	if (len < 0 || rec->map_size - rec->pos <= (size_t) len ||
+	    rec->map[rec->pos+len] != '\0')
+		return FALSE;
+
+	*str = (const char *) rec->map + rec->pos;
+	rec->pos += len+1;
+	return TRUE;
+}
+
+static SESSION_SNAPSHOT_REC *session_snapshot_create(void)
+{
+	SESSION_SNAPSHOT_REC *rec;
+
+	rec = g_new0(SESSION_SNAPSHOT_REC, 1);
+	rec->data = g_string_sized_new(65536);
+	g_string_append_len(rec->data, SESSION_SNAPSHOT_MAGIC,
+			    SESSION_SNAPSHOT_MAGIC_LEN);
+	return rec;
+}
+
+static int session_snapshot_write(SESSION_SNAPSHOT_REC *rec, const char *path)
+{
+	const char *data;
+	size_t left;
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1)
+		return FALSE;
+
+	data = rec->data->str;
+	left = rec->data->len;
+	while (left > 0) {
+		ret = write(fd, data, left);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			close(fd);
+			unlink(path);
+			return FALSE;
+		}
+		data += ret; left -= ret;
+	}
+
+	close(fd);
+	return TRUE;
+}
+
+static SESSION_SNAPSHOT_REC *session_snapshot_open(const char *path)
+{
+	SESSION_SNAPSHOT_REC *rec;
+	struct stat statbuf;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &statbuf) < 0 ||
+	    statbuf.st_size < SESSION_SNAPSHOT_MAGIC_LEN) {
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	if (memcmp(map, SESSION_SNAPSHOT_MAGIC,
+		   SESSION_SNAPSHOT_MAGIC_LEN) != 0) {
+		munmap(map, statbuf.st_size);
+		return NULL;
+	}
+
+	rec = g_new0(SESSION_SNAPSHOT_REC, 1);
+	rec->map = map;
+	rec->map_size = statbuf.st_size;
+	rec->pos = SESSION_SNAPSHOT_MAGIC_LEN;
+	return rec;
+}
+
+static void session_snapshot_destroy(SESSION_SNAPSHOT_REC *rec)
+{
+	if (rec->data != NULL)
+		g_string_free(rec->data, TRUE);
+	else if (rec->map != NULL)
+		munmap((void *) rec->map, rec->map_size);
+	g_free(rec);
+}
+
+/* Move the nicklists of the channel node from the snapshot to the config
+   in the format older irssi used */
+static void session_snapshot_channel_to_config(SESSION_SNAPSHOT_REC *rec,
+					       CONFIG_REC *config,
+					       CONFIG_NODE *node)
+{
+	GHashTable *saved;
+	CONFIG_NODE *list, *nicknode;
+	GSList *tmp;
+	const char *nick, *prefixes;
+	int offset, count, flags;
+
+	offset = config_node_get_int(node, "nicks_offset", -1);
+	config_node_set_str(config, node, "nicks_offset", NULL);
+	if (offset < 0 || !session_snapshot_seek(rec, offset) ||
+	    !session_snapshot_get_int(rec, &count))
+		return;
+
+	/* nodes that modules already saved data to */
+	saved = g_hash_table_new((GHashFunc) g_str_hash,
+				 (GCompareFunc) g_str_equal);
+	list = config_node_section(node, "nicks", NODE_TYPE_LIST);
+	for (tmp = config_node_first(list->value); tmp != NULL;
+	     tmp = config_node_next(tmp)) {
+		nicknode = tmp->data;
+		nick = config_node_get_str(nicknode, "nick", NULL);
+		if (nick != NULL)
+			g_hash_table_insert(saved, (char *) nick, nicknode);
+	}
+
+	for (; count > 0; count--) {
+		if (!session_snapshot_get_str(rec, &nick) ||
+		    !session_snapshot_get_str(rec, &prefixes) ||
+		    !session_snapshot_get_int(rec, &flags) ||
+		    nick == NULL)
+			break;
+
+		nicknode = g_hash_table_lookup(saved, nick);
+		if (nicknode == NULL) {
+			nicknode = config_node_section(list, NULL,
+						       NODE_TYPE_BLOCK);
+			config_node_set_str(config, nicknode, "nick", nick);
+		}
+		config_node_set_bool(config, nicknode, "op",
+				     flags & SNAPSHOT_NICK_OP);
+		config_node_set_bool(config, nicknode, "halfop",
+				     flags & SNAPSHOT_NICK_HALFOP);
+		config_node_set_bool(config, nicknode, "voice",
+				     flags & SNAPSHOT_NICK_VOICE);
+		config_node_set_str(config, nicknode, "prefixes", prefixes);
+	}
+	g_hash_table_destroy(saved);
+}
+
+/* Writing the snapshot failed, save the nicklists to the config instead
+   so they don't get lost */
+static void session_snapshot_to_config(SESSION_SNAPSHOT_REC *rec,
+				       CONFIG_REC *config)
+{
+	CONFIG_NODE *node;
+	GSList *tmp, *chan;
+
+	/* read the unwritten data directly from memory */
+	rec->map = (const unsigned char *) rec->data->str;
+	rec->map_size = rec->data->len;
+
+	node = config_node_traverse(config, "(servers", FALSE);
+	if (node == NULL)
+		return;
+
+	tmp = config_node_first(node->value);
+	for (; tmp != NULL; tmp = config_node_next(tmp)) {
+		node = config_node_section(tmp->data, "channels", -1);
+		if (node == NULL || node->type != NODE_TYPE_LIST)
+			continue;
+
+		chan = config_node_first(node->value);
+		for (; chan != NULL; chan = config_node_next(chan)) {
+			session_snapshot_channel_to_config(rec, config,
+							   chan->data);
+		}
+	}
+}
 
 void session_set_binary(const char *path)
 {
@@ -59,7 +328,7 @@ void session_upgrade(void)
 static void cmd_upgrade(const char *data)
 {
 	CONFIG_REC *session;
-	char *session_file, *str;
+	char *session_file, *snapshot_file, *str;
 	char *binary;
 
 	if (*data == '\0')
@@ -73,7 +342,19 @@ static void cmd_upgrade(const char *data)
 	session = config_open(session_file, 0600);
         unlink(session_file);
 
-	signal_emit("session save", 1, session);
+	snapshot = session_snapshot_create();
+	signal_emit("session save", 2, session, snapshot);
+
+	snapshot_file = g_strconcat(session_file, ".bin", NULL);
+	if (!session_snapshot_write(snapshot, snapshot_file)) {
+		g_warning("Couldn't write session snapshot %s, "
+			  "scrollback won't be kept", snapshot_file);
+		session_snapshot_to_config(snapshot, session);
+	}
+	session_snapshot_destroy(snapshot);
+	snapshot = NULL;
+	g_free(snapshot_file);
+
         config_write(session, NULL, -1);
         config_close(session);
 
@@ -90,30 +371,51 @@ static void cmd_upgrade(const char *data)
 }
 
 static void session_save_nick(CHANNEL_REC *channel, NICK_REC *nick,
-			      CONFIG_REC *config, CONFIG_NODE *node)
+			      CONFIG_REC *config, CONFIG_NODE *parent)
 {
-	node = config_node_section(node, NULL, NODE_TYPE_BLOCK);
+	CONFIG_NODE *node;
+	int flags;
 
-	config_node_set_str(config, node, "nick", nick->nick);
-	config_node_set_bool(config, node, "op", nick->op);
-	config_node_set_bool(config, node, "halfop", nick->halfop);
-	config_node_set_bool(config, node, "voice", nick->voice);
+	flags = (nick->op ? SNAPSHOT_NICK_OP : 0) |
+		(nick->halfop ? SNAPSHOT_NICK_HALFOP : 0) |
+		(nick->voice ? SNAPSHOT_NICK_VOICE : 0);
 
-	config_node_set_str(config, node, "prefixes", nick->prefixes);
+	session_snapshot_put_str(snapshot, nick->nick);
+	session_snapshot_put_str(snapshot, nick->prefixes);
+	session_snapshot_put_int(snapshot, flags);
 
+	/* modules may still save their own data for the nick. the node
+	   is kept only if they did. */
+	node = config_node_section(parent, NULL, NODE_TYPE_BLOCK);
 	signal_emit("session save nick", 4, channel, nick, config, node);
+	if (node->value == NULL)
+		config_node_remove(config, parent, node);
+	else
+		config_node_set_str(config, node, "nick", nick->nick);
 }
 
+/* nicklists are saved to the binary snapshot, the channel node only
+   has the offset */
 static void session_save_channel_nicks(CHANNEL_REC *channel, CONFIG_REC *config,
 				       CONFIG_NODE *node)
 {
+	CONFIG_NODE *nicknode;
 	GSList *tmp, *nicks;
 
-	node = config_node_section(node, "nicks", NODE_TYPE_LIST);
+	if (snapshot == NULL)
+		return;
+
         nicks = nicklist_getnicks(channel);
+	config_node_set_int(config, node, "nicks_offset",
+			    session_snapshot_offset(snapshot));
+	nicknode = config_node_section(node, "nicks", NODE_TYPE_LIST);
+	session_snapshot_put_int(snapshot, g_slist_length(nicks));
 	for (tmp = nicks; tmp != NULL; tmp = tmp->next)
-		session_save_nick(channel, tmp->data, config, node);
+		session_save_nick(channel, tmp->data, config, nicknode);
         g_slist_free(nicks);
+
+	if (nicknode->value == NULL)
+		config_node_remove(config, node, nicknode);
 }
 
 static void session_save_channel(CHANNEL_REC *channel, CONFIG_REC *config,
@@ -181,12 +483,47 @@ static void session_save_server(SERVER_REC *server, CONFIG_REC *config,
         server_disconnect(server);
 }
 
+static void session_restore_snapshot_nicks(CHANNEL_REC *channel, int offset)
+{
+	NICK_REC *rec;
+	const char *nick, *prefixes;
+	int count, flags;
+
+	if (snapshot == NULL || !session_snapshot_seek(snapshot, offset) ||
+	    !session_snapshot_get_int(snapshot, &count))
+		return;
+
+	for (; count > 0; count--) {
+		if (!session_snapshot_get_str(snapshot, &nick) ||
+		    !session_snapshot_get_str(snapshot, &prefixes) ||
+		    !session_snapshot_get_int(snapshot, &flags) ||
+		    nick == NULL)
+			break;
+
+		rec = g_new0(NICK_REC, 1);
+		rec->nick = g_strdup(nick);
+		rec->op = (flags & SNAPSHOT_NICK_OP) != 0;
+		rec->halfop = (flags & SNAPSHOT_NICK_HALFOP) != 0;
+		rec->voice = (flags & SNAPSHOT_NICK_VOICE) != 0;
+		if (prefixes != NULL)
+			strocpy(rec->prefixes, prefixes, sizeof(rec->prefixes));
+
+		nicklist_insert(channel, rec);
+	}
+}
+
 static void session_restore_channel_nicks(CHANNEL_REC *channel,
 					  CONFIG_NODE *node)
 {
 	GSList *tmp;
+	int offset;
+
+	offset = config_node_get_int(node, "nicks_offset", -1);
+	if (offset >= 0)
+		session_restore_snapshot_nicks(channel, offset);
 
-	/* restore nicks */
+	/* restore nicks saved by an older irssi, or the data modules
+	   saved for them with "session save nick" */
 	node = config_node_section(node, "nicks", -1);
 	if (node != NULL && node->type == NODE_TYPE_LIST) {
 		tmp = config_node_first(node->value);
@@ -314,6 +651,7 @@ static void sig_session_restore(CONFIG_REC *config)
 static void sig_init_finished(void)
 {
 	CONFIG_REC *session;
+	char *snapshot_file;
 
 	if (session_file == NULL)
 		return;
@@ -322,11 +660,22 @@ static void sig_init_finished(void)
 	if (session == NULL)
 		return;
 
+	/* the snapshot is missing when upgrading from an older irssi */
+	snapshot_file = g_strconcat(session_file, ".bin", NULL);
+	snapshot = session_snapshot_open(snapshot_file);
+
 	config_parse(session);
-        signal_emit("session restore", 1, session);
+        signal_emit("session restore", 2, session, snapshot);
 	config_close(session);
 
+	if (snapshot != NULL) {
+		session_snapshot_destroy(snapshot);
+		snapshot = NULL;
+	}
+
+	unlink(snapshot_file);
 	unlink(session_file);
+	g_free(snapshot_file);
 }
 
 void session_register_options(void)
@@ -1,8 +1,37 @@
 #ifndef __SESSION_H
 #define __SESSION_H
 
+/* Binary session snapshot, written next to the session config file for
+   the bulky data (nicklists, scrollback) which would be slow to save as
+   config nodes. When saving `data' is used, when restoring the file is
+   mmap()ed and read with `pos'. */
+typedef struct {
+	GString *data;
+
+	const unsigned char *map;
+	size_t map_size, pos;
+} SESSION_SNAPSHOT_REC;
+
 extern char *irssi_binary;
 
+/* Current write position, can be given to session_snapshot_seek() when
+   restoring */
+int session_snapshot_offset(SESSION_SNAPSHOT_REC *snapshot);
+void session_snapshot_put_int(SESSION_SNAPSHOT_REC *snapshot, int value);
+/* `str' may be NULL */
+void session_snapshot_put_str(SESSION_SNAPSHOT_REC *snapshot, const char *str);
+void session_snapshot_put_data(SESSION_SNAPSHOT_REC *snapshot,
+			       const void *data, int len);
+
+/* The get functions return FALSE if the snapshot is truncated. Returned
+   strings and data point to the mapped file and are valid until the
+   "session restore" signal has finished. */
+int session_snapshot_seek(SESSION_SNAPSHOT_REC *snapshot, int offset);
+int session_snapshot_get_int(SESSION_SNAPSHOT_REC *snapshot, int *value);
+int session_snapshot_get_str(SESSION_SNAPSHOT_REC *snapshot, const char **str);
+int session_snapshot_get_data(SESSION_SNAPSHOT_REC *snapshot,
+			      const void **data, int *len);
+
 void session_set_binary(const char *path);
 void session_upgrade(void);
 
@@ -198,7 +198,7 @@ static void cmd_channel_list_joined(void)
 
 		if (nicks->len > 1) g_string_truncate(nicks, nicks->len-1);
 		printformat(NULL, NULL, MSGLEVEL_CLIENTCRAP, TXT_CHANLIST_LINE,
-			    channel->visible_name, channel->mode,
+			    channel->visible_name, channel_get_mode(channel),
 			    channel->server->tag, nicks->str);
 
 		g_slist_free(nicklist);
@@ -45,6 +45,7 @@
 #include "window-items.h"
 #include "windows-layout.h"
 #include "fe-recode.h"
+#include "utf8.h"
 
 #include <signal.h>
 
@@ -234,6 +235,7 @@ void fe_common_core_deinit(void)
 	fe_messages_deinit();
 	fe_ignore_messages_deinit();
 	fe_recode_deinit();
+	wcwidth_deinit();
 
         theme_unregister();
 	themes_deinit();
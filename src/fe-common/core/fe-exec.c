@@ -28,6 +28,7 @@
 #include "net-sendbuffer.h"
 #include "misc.h"
 #include "levels.h"
+#include "settings.h"
 
 #include "servers.h"
 #include "channels.h"
@@ -41,8 +42,16 @@
 #include <signal.h>
 #include <sys/wait.h>
 
+/* read size is adjusted between these by how much output there is */
+#define EXEC_READ_MIN 512
+#define EXEC_READ_MAX 65536
+/* how long to wait for the end of output after the process has exited,
+   something it left in the background may be keeping the pipe open */
+#define EXEC_EXIT_GRACE_TIME 1000
+
 GSList *processes;
 static int signal_exec_input;
+static char *read_buffer;
 
 static void exec_wi_destroy(EXEC_WI_REC *rec)
 {
@@ -179,9 +188,15 @@ static void process_destroy(PROCESS_REC *rec, int status)
 
 	if (rec->read_tag != -1)
 		g_source_remove(rec->read_tag);
+	if (rec->flush_tag != -1)
+		g_source_remove(rec->flush_tag);
+	if (rec->exit_tag != -1)
+		g_source_remove(rec->exit_tag);
 	if (rec->target_item != NULL)
                 exec_wi_destroy(rec->target_item);
 
+	g_queue_foreach(rec->pending, (GFunc) g_free, NULL);
+	g_queue_free(rec->pending);
 	line_split_free(rec->databuf);
         g_io_channel_close(rec->in);
         g_io_channel_unref(rec->in);
@@ -352,29 +367,164 @@ static void process_exec(PROCESS_REC *rec, const char *cmd)
 	_exit(-1);
 }
 
+static void sig_exec_input_reader(PROCESS_REC *rec);
+
+static void process_read_start(PROCESS_REC *rec)
+{
+	if (rec->read_tag != -1 || rec->eof)
+		return;
+
+	rec->read_tag = g_input_add(rec->in, G_INPUT_READ,
+				    (GInputFunction) sig_exec_input_reader,
+				    rec);
+}
+
+static void process_read_stop(PROCESS_REC *rec)
+{
+	if (rec->read_tag != -1) {
+		g_source_remove(rec->read_tag);
+		rec->read_tag = -1;
+	}
+}
+
+/* process has exited and all of its output is handled */
+static void process_finish(PROCESS_REC *rec)
+{
+	int status;
+
+	status = rec->exit_status;
+	if (WIFSIGNALED(status)) {
+		status = WTERMSIG(status);
+		if (!rec->silent) {
+			printtext(NULL, NULL, MSGLEVEL_CLIENTNOTICE,
+				  "process %d (%s) terminated with signal %d (%s)",
+				  rec->id, rec->args,
+				  status, g_strsignal(status));
+		}
+	} else {
+		status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		if (!rec->silent) {
+			printtext(NULL, NULL, MSGLEVEL_CLIENTNOTICE,
+				  "process %d (%s) terminated with return code %d",
+				  rec->id, rec->args, status);
+		}
+	}
+	process_destroy(rec, status);
+}
+
+/* returns TRUE if the server we're sending the output to has too much
+   in its queue already */
+static int process_send_blocked(PROCESS_REC *rec)
+{
+	SERVER_REC *server;
+
+	if (rec->target == NULL)
+		return FALSE;
+
+	server = rec->target_server != NULL ?
+		server_find_tag(rec->target_server) :
+		active_win->active_server;
+	if (server == NULL || server->get_send_queue_length == NULL)
+		return FALSE;
+
+	return server->get_send_queue_length(server) >=
+		settings_get_int("exec_send_queue_max");
+}
+
+static void process_flush(PROCESS_REC *rec);
+
+static int process_flush_timeout(PROCESS_REC *rec)
+{
+	rec->flush_tag = -1;
+	process_flush(rec);
+	return FALSE;
+}
+
+static void process_flush_start(PROCESS_REC *rec, int msecs)
+{
+	if (rec->flush_tag == -1) {
+		rec->flush_tag = g_timeout_add(msecs, (GSourceFunc)
+					       process_flush_timeout, rec);
+	}
+}
+
+/* send or print the pending output, a limited amount of it at a time so
+   the UI keeps responding. rec may be destroyed when this returns. */
+static void process_flush(PROCESS_REC *rec)
+{
+	char *str;
+	int count, max_lines;
+
+	max_lines = settings_get_int("exec_flush_lines");
+	for (count = 0; !g_queue_is_empty(rec->pending); count++) {
+		if (count >= max_lines) {
+			/* continue after handling other events */
+			process_flush_start(rec, 0);
+			return;
+		}
+		if (process_send_blocked(rec)) {
+			/* wait for the server's send queue to empty */
+			process_flush_start(rec, 1000);
+			return;
+		}
+
+		str = g_queue_pop_head(rec->pending);
+		signal_emit_id(signal_exec_input, 2, rec, str);
+		g_free(str);
+
+		if (g_slist_find(processes, rec) == NULL) {
+			/* destroyed by the signal handler */
+			return;
+		}
+	}
+
+	if (rec->eof && rec->exited)
+		process_finish(rec);
+	else
+		process_read_start(rec);
+}
+
 static void sig_exec_input_reader(PROCESS_REC *rec)
 {
-        char tmpbuf[512], *str;
+        char *str;
         int recvlen;
 	int ret;
 
 	g_return_if_fail(rec != NULL);
 
-	recvlen = net_receive(rec->in, tmpbuf, sizeof(tmpbuf));
+	recvlen = net_receive(rec->in, read_buffer, rec->read_size);
+	if (recvlen == rec->read_size && rec->read_size < EXEC_READ_MAX) {
+		/* lots of output, read more at once */
+		rec->read_size *= 2;
+	} else if (recvlen >= 0 && recvlen < rec->read_size/4 &&
+		   rec->read_size > EXEC_READ_MIN) {
+		rec->read_size /= 2;
+	}
+
 	do {
-		ret = line_split(tmpbuf, recvlen, &str, &rec->databuf);
+		ret = line_split(read_buffer, recvlen, &str, &rec->databuf);
 		if (ret == -1) {
 			/* link to terminal closed? */
-			g_source_remove(rec->read_tag);
-                        rec->read_tag = -1;
+			process_read_stop(rec);
+			rec->eof = TRUE;
 			break;
 		}
 
 		if (ret > 0) {
-			signal_emit_id(signal_exec_input, 2, rec, str);
+			g_queue_push_tail(rec->pending, g_strdup(str));
                         if (recvlen > 0) recvlen = 0;
 		}
 	} while (ret > 0);
+
+	if ((int) rec->pending->length >= settings_get_int("exec_buffer_lines")) {
+		/* don't read more before the pending lines are handled */
+		process_read_stop(rec);
+	}
+
+	if (rec->batch)
+		process_flush_start(rec, settings_get_time("exec_batch_time"));
+	else if (rec->flush_tag == -1)
+		process_flush(rec);
 }
 
 static void handle_exec(const char *args, GHashTable *optlist,
@@ -499,11 +649,17 @@ static void handle_exec(const char *args, GHashTable *optlist,
         /* starting a new process */
 	rec = g_new0(PROCESS_REC, 1);
 	rec->pid = -1;
+	rec->read_tag = -1;
+	rec->flush_tag = -1;
+	rec->exit_tag = -1;
+	rec->read_size = EXEC_READ_MIN;
+	rec->pending = g_queue_new();
         rec->shell = g_hash_table_lookup(optlist, "nosh") == NULL;
 
 	process_exec(rec, args);
 	if (rec->pid == -1) {
                 /* pipe() or fork() failed */
+		g_queue_free(rec->pending);
 		g_free(rec);
 		cmd_return_error(CMDERR_ERRNO);
 	}
@@ -519,14 +675,13 @@ static void handle_exec(const char *args, GHashTable *optlist,
 	rec->notice = notice;
         rec->silent = g_hash_table_lookup(optlist, "-") != NULL;
         rec->quiet = g_hash_table_lookup(optlist, "quiet") != NULL;
+	rec->batch = g_hash_table_lookup(optlist, "batch") != NULL;
 	rec->name = g_strdup(g_hash_table_lookup(optlist, "name"));
 
 	level = g_hash_table_lookup(optlist, "level");
 	rec->level = level == NULL ? MSGLEVEL_CLIENTCRAP : level2bits(level, NULL);
 
-	rec->read_tag = g_input_add(rec->in, G_INPUT_READ,
-				    (GInputFunction) sig_exec_input_reader,
-				    rec);
+	process_read_start(rec);
 	processes = g_slist_append(processes, rec);
 
 	if (rec->target == NULL && interactive)
@@ -535,7 +690,7 @@ static void handle_exec(const char *args, GHashTable *optlist,
 	signal_emit("exec new", 1, rec);
 }
 
-/* SYNTAX: EXEC [-] [-nosh] [-out | -msg <target> | -notice <target>]
+/* SYNTAX: EXEC [-] [-nosh] [-batch] [-out | -msg <target> | -notice <target>]
 		[-name <name>] <cmd line>
 	   EXEC -out | -window | -msg <target> | -notice <target> |
 		-close | -<signal> %<id>
@@ -556,35 +711,36 @@ static void cmd_exec(const char *data, SERVER_REC *server, WI_ITEM_REC *item)
 	}
 }
 
+/* the process exited a while ago but its output hasn't ended, stop
+   waiting for it and finish once the already read lines are handled */
+static int process_exit_timeout(PROCESS_REC *rec)
+{
+	rec->exit_tag = -1;
+	process_read_stop(rec);
+	rec->eof = TRUE;
+
+	if (g_queue_is_empty(rec->pending) && rec->flush_tag == -1)
+		process_finish(rec);
+	return FALSE;
+}
+
 static void sig_pidwait(void *pid, void *statusp)
 {
 	PROCESS_REC *rec;
-        char *str;
-	int status = GPOINTER_TO_INT(statusp);
 
         rec = process_find_pid(GPOINTER_TO_INT(pid));
 	if (rec == NULL) return;
 
-	/* process exited - print the last line if
-	   there wasn't a newline at end. */
-	if (line_split("\n", 1, &str, &rec->databuf) > 0 && *str != '\0')
-		signal_emit_id(signal_exec_input, 2, rec, str);
-
-	if (!rec->silent) {
-		if (WIFSIGNALED(status)) {
-			status = WTERMSIG(status);
-			printtext(NULL, NULL, MSGLEVEL_CLIENTNOTICE,
-				  "process %d (%s) terminated with signal %d (%s)",
-				  rec->id, rec->args,
-				  status, g_strsignal(status));
-		} else {
-                        status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-			printtext(NULL, NULL, MSGLEVEL_CLIENTNOTICE,
-				  "process %d (%s) terminated with return code %d",
-				  rec->id, rec->args, status);
-		}
-	}
-	process_destroy(rec, status);
+	/* process exited - finish once all of its output is read
+	   and handled */
+	rec->exit_status = GPOINTER_TO_INT(statusp);
+	rec->exited = TRUE;
+	if (!rec->eof) {
+		rec->exit_tag = g_timeout_add(EXEC_EXIT_GRACE_TIME,
+					      (GSourceFunc) process_exit_timeout,
+					      rec);
+	} else if (g_queue_is_empty(rec->pending) && rec->flush_tag == -1)
+		process_finish(rec);
 }
 
 static void sig_exec_input(PROCESS_REC *rec, const char *text)
@@ -654,7 +810,14 @@ static void event_text(const char *data, SERVER_REC *server, EXEC_WI_REC *item)
 void fe_exec_init(void)
 {
 	command_bind("exec", NULL, (SIGNAL_FUNC) cmd_exec);
-	command_set_options("exec", "!- interactive nosh +name out +msg +notice +in window close +level quiet");
+	command_set_options("exec", "!- interactive nosh +name out +msg +notice +in window close +level quiet batch");
+
+	settings_add_int("exec", "exec_buffer_lines", 1000);
+	settings_add_int("exec", "exec_flush_lines", 100);
+	settings_add_int("exec", "exec_send_queue_max", 10);
+	settings_add_time("exec", "exec_batch_time", "200msec");
+
+	read_buffer = g_malloc(EXEC_READ_MAX);
 
         signal_exec_input = signal_get_uniq_id("exec input");
         signal_add("pidwait", (SIGNAL_FUNC) sig_pidwait);
@@ -675,6 +838,7 @@ void fe_exec_deinit(void)
 	}
 
 	command_unbind("exec", (SIGNAL_FUNC) cmd_exec);
+	g_free(read_buffer);
 
         signal_remove("pidwait", (SIGNAL_FUNC) sig_pidwait);
         signal_remove("exec input", (SIGNAL_FUNC) sig_exec_input);
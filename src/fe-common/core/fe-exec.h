@@ -29,6 +29,12 @@ struct PROCESS_REC {
         NET_SENDBUF_REC *out;
         LINEBUF_REC *databuf;
 	int read_tag;
+	int read_size; /* how much to read at once, grows with the output */
+
+	GQueue *pending; /* output lines waiting to be sent or printed */
+	int flush_tag;
+	int exit_tag; /* waiting for the output to end after the exit */
+	int exit_status;
 
         int level; /* what level to use when printing the text */
         char *target; /* send text with /msg <target> ... */
@@ -42,6 +48,9 @@ struct PROCESS_REC {
 	unsigned int quiet:1; /* don't print process output at all */
 	unsigned int target_channel:1; /* target is a channel */
 	unsigned int target_nick:1; /* target is a nick */
+	unsigned int batch:1; /* handle the output in batches */
+	unsigned int eof:1; /* all output has been read */
+	unsigned int exited:1; /* process has exited */
 };
 
 extern GSList *processes;
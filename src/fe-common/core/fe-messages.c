@@ -547,7 +547,7 @@ static void sig_nicklist_new(CHANNEL_REC *channel, NICK_REC *nick)
 	if (nick->host == NULL)
                 return;
 
-	firstnick = g_hash_table_lookup(channel->nicks, nick->nick);
+	firstnick = g_hash_table_lookup(channel->nicks, nick->key);
 	if (firstnick->next == NULL)
 		return;
 
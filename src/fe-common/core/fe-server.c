@@ -71,6 +71,7 @@ static void print_reconnects(void)
 
 		tag = g_strdup_printf("RECON-%d", rec->tag);
 		left = rec->next_connect-time(NULL);
+		if (left < 0) left = 0;
 		next_connect = g_strdup_printf("%02d:%02d", left/60, left%60);
 		printformat(NULL, NULL, MSGLEVEL_CRAP, TXT_SERVER_RECONNECT_LIST,
 			    tag, conn->address, conn->port,
@@ -81,6 +82,50 @@ static void print_reconnects(void)
 	}
 }
 
+/* SYNTAX: RECONNECT STATUS */
+static void cmd_reconnect_status(const char *data)
+{
+	GSList *tmp;
+	char *tag, *next_connect;
+	time_t now;
+	int left;
+
+	if (g_ascii_strcasecmp(data, "status") != 0)
+		return;
+	signal_stop();
+
+	printformat(NULL, NULL, MSGLEVEL_CLIENTCRAP, TXT_RECONNECT_STATUS,
+		    g_slist_length(reconnects),
+		    server_reconnect_connecting_count(),
+		    settings_get_int("server_reconnect_max_connecting"));
+
+	now = time(NULL);
+	for (tmp = reconnects; tmp != NULL; tmp = tmp->next) {
+		RECONNECT_REC *rec = tmp->data;
+		SERVER_CONNECT_REC *conn = rec->conn;
+
+		tag = g_strdup_printf("RECON-%d", rec->tag);
+		left = rec->next_connect-now;
+		if (left <= 0) {
+			printformat(NULL, NULL, MSGLEVEL_CLIENTCRAP,
+				    TXT_RECONNECT_STATUS_WAITING,
+				    tag, conn->address, conn->port,
+				    conn->chatnet == NULL ? "" : conn->chatnet,
+				    conn->reconnect_attempts+1, rec->priority);
+		} else {
+			next_connect = g_strdup_printf("%02d:%02d", left/60, left%60);
+			printformat(NULL, NULL, MSGLEVEL_CLIENTCRAP,
+				    TXT_RECONNECT_STATUS_LINE,
+				    tag, conn->address, conn->port,
+				    conn->chatnet == NULL ? "" : conn->chatnet,
+				    conn->reconnect_attempts+1, rec->priority,
+				    next_connect);
+			g_free(next_connect);
+		}
+		g_free(tag);
+	}
+}
+
 static SERVER_SETUP_REC *create_server_setup(GHashTable *optlist)
 {
 	CHAT_PROTOCOL_REC *rec;
@@ -298,6 +343,26 @@ static void sig_server_connecting(SERVER_REC *server, IPADDR *ip)
 		    server->connrec->address, ipaddr, server->connrec->port);
 }
 
+static void sig_server_connect_attempt(SERVER_REC *server, IPADDR *ip,
+				       void *msecs, const char *error)
+{
+	char ipaddr[MAX_IP_LEN];
+
+	g_return_if_fail(server != NULL);
+	g_return_if_fail(ip != NULL);
+
+	net_ip2host(ip, ipaddr);
+	if (error == NULL) {
+		printformat(server, NULL, MSGLEVEL_CLIENTNOTICE,
+			    TXT_CONNECT_ATTEMPT_OK, server->connrec->address,
+			    ipaddr, GPOINTER_TO_INT(msecs));
+	} else {
+		printformat(server, NULL, MSGLEVEL_CLIENTNOTICE,
+			    TXT_CONNECT_ATTEMPT_FAILED, server->connrec->address,
+			    ipaddr, GPOINTER_TO_INT(msecs), error);
+	}
+}
+
 static void sig_server_connected(SERVER_REC *server)
 {
 	g_return_if_fail(server != NULL);
@@ -379,10 +444,12 @@ void fe_server_init(void)
 	command_bind("server remove", NULL, (SIGNAL_FUNC) cmd_server_remove);
 	command_bind_first("server", NULL, (SIGNAL_FUNC) server_command);
 	command_bind_first("disconnect", NULL, (SIGNAL_FUNC) server_command);
+	command_bind_first("reconnect", NULL, (SIGNAL_FUNC) cmd_reconnect_status);
 	command_set_options("server add", "4 6 ssl +ssl_cert +ssl_pkey ssl_verify +ssl_cafile +ssl_capath auto noauto proxy noproxy -host -port");
 
 	signal_add("server looking", (SIGNAL_FUNC) sig_server_looking);
 	signal_add("server connecting", (SIGNAL_FUNC) sig_server_connecting);
+	signal_add("server connect attempt", (SIGNAL_FUNC) sig_server_connect_attempt);
 	signal_add("server connected", (SIGNAL_FUNC) sig_server_connected);
 	signal_add("server connect failed", (SIGNAL_FUNC) sig_connect_failed);
 	signal_add("server disconnected", (SIGNAL_FUNC) sig_server_disconnected);
@@ -403,9 +470,11 @@ void fe_server_deinit(void)
 	command_unbind("server remove", (SIGNAL_FUNC) cmd_server_remove);
 	command_unbind("server", (SIGNAL_FUNC) server_command);
 	command_unbind("disconnect", (SIGNAL_FUNC) server_command);
+	command_unbind("reconnect", (SIGNAL_FUNC) cmd_reconnect_status);
 
 	signal_remove("server looking", (SIGNAL_FUNC) sig_server_looking);
 	signal_remove("server connecting", (SIGNAL_FUNC) sig_server_connecting);
+	signal_remove("server connect attempt", (SIGNAL_FUNC) sig_server_connect_attempt);
 	signal_remove("server connected", (SIGNAL_FUNC) sig_server_connected);
 	signal_remove("server connect failed", (SIGNAL_FUNC) sig_connect_failed);
 	signal_remove("server disconnected", (SIGNAL_FUNC) sig_server_disconnected);
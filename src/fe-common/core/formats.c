@@ -38,6 +38,25 @@ static const char *format_backs = "04261537";
 static const char *format_fores = "kbgcrmyw";
 static const char *format_boldfores = "KBGCRMYW";
 
+#define CODE_STYLE 0x01 /* starts a color or style code */
+#define CODE_DIGIT 0x02
+
+#define S CODE_STYLE
+#define D CODE_DIGIT
+static const unsigned char code_types[256] = {
+	0, 0, S, S, S, 0, S, S, 0, 0, 0, 0, 0, 0, 0, S,
+	0, 0, 0, 0, 0, 0, S, 0, 0, 0, 0, S, 0, 0, 0, S,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0
+};
+#undef S
+#undef D
+
+#define IS_COLOR_CODE(c) \
+	((code_types[(unsigned char) (c)] & CODE_STYLE) != 0)
+#define IS_CODE_DIGIT(c) \
+	((code_types[(unsigned char) (c)] & CODE_DIGIT) != 0)
+
 static int signal_gui_print_text;
 static int hide_text_style, hide_server_tags, hide_colors;
 
@@ -736,7 +755,7 @@ static const char *get_ansi_color(THEME_REC *theme, const char *str,
 	for (;; str++) {
 		if (*str == '\0') return start;
 
-		if (i_isdigit(*str)) {
+		if (IS_CODE_DIGIT(*str)) {
 			num = num*10 + (*str-'0');
 			continue;
 		}
@@ -789,39 +808,46 @@ static const char *get_ansi_color(THEME_REC *theme, const char *str,
 	return str;
 }
 
+/* parse a 1-2 digit MIRC color number, returns -1 if there's none */
+static int get_mirc_color_num(const char **str)
+{
+	const char *p = *str;
+	int num;
+
+	if (!IS_CODE_DIGIT(*p))
+		return -1;
+
+	num = *p++ - '0';
+	if (IS_CODE_DIGIT(*p))
+		num = num*10 + (*p++ - '0');
+
+	*str = p;
+	return num;
+}
+
 /* parse MIRC color string */
 static void get_mirc_color(const char **str, int *fg_ret, int *bg_ret)
 {
-	int fg, bg;
+	int fg, bg, num;
 
 	fg = fg_ret == NULL ? -1 : *fg_ret;
 	bg = bg_ret == NULL ? -1 : *bg_ret;
 
-	if (!i_isdigit(**str) && **str != ',') {
+	num = get_mirc_color_num(str);
+	if (num == -1 && **str != ',') {
 		fg = -1;
 		bg = -1;
 	} else {
 		/* foreground color */
-		if (**str != ',') {
-			fg = **str-'0';
-			(*str)++;
-			if (i_isdigit(**str)) {
-				fg = fg*10 + (**str-'0');
-				(*str)++;
-			}
-		}
+		if (num != -1)
+			fg = num;
 		if (**str == ',') {
 			/* background color */
-			if (!i_isdigit((*str)[1]))
+			if (!IS_CODE_DIGIT((*str)[1]))
 				bg = -1;
 			else {
 				(*str)++;
-				bg = **str-'0';
-				(*str)++;
-				if (i_isdigit(**str)) {
-					bg = bg*10 + (**str-'0');
-					(*str)++;
-				}
+				bg = get_mirc_color_num(str);
 			}
 		}
 	}
@@ -830,9 +856,33 @@ static void get_mirc_color(const char **str, int *fg_ret, int *bg_ret)
 	if (bg_ret) *bg_ret = bg;
 }
 
-#define IS_COLOR_CODE(c) \
-	((c) == 2 || (c) == 3 || (c) == 4 || (c) == 6 || (c) == 7 || \
-	(c) == 15 || (c) == 22 || (c) == 27 || (c) == 31)
+/* If `str' starts with a color or style code, return the position after
+   it. Otherwise return NULL. */
+static const char *skip_code(const char *str)
+{
+	if (!IS_COLOR_CODE(*str))
+		return NULL;
+
+	switch (*str) {
+	case 3:
+		/* mirc color */
+		str++;
+		get_mirc_color(&str, NULL, NULL);
+		return str;
+	case 4:
+		/* irssi color or style */
+		if (str[1] == '\0')
+			return str+1;
+		if (str[1] < FORMAT_STYLE_SPECIAL && str[2] != '\0')
+			return str+3;
+		return str+2;
+	case 27:
+		/* ansi color */
+		return get_ansi_color(current_theme, str+1, NULL, NULL, NULL);
+	default:
+		return str+1;
+	}
+}
 
 /* Return how many characters in `str' must be skipped before `len'
    characters of text is skipped. */
@@ -840,6 +890,7 @@ int strip_real_length(const char *str, int len,
 		      int *last_color_pos, int *last_color_len)
 {
 	const char *start = str;
+	const char *next;
 
 	if (last_color_pos != NULL)
 		*last_color_pos = -1;
@@ -847,37 +898,23 @@ int strip_real_length(const char *str, int len,
 		*last_color_len = -1;
 
 	while (*str != '\0') {
-		if (*str == 3) {
-			const char *mircstart = str;
+		next = skip_code(str);
+		if (next == NULL) {
+			if (len-- == 0)
+				break;
+			str++;
+			continue;
+		}
 
+		if (*str == 3 || (*str == 4 && (next-str == 3 ||
+				  str[1] == FORMAT_STYLE_DEFAULTS))) {
+			/* a color change */
 			if (last_color_pos != NULL)
 				*last_color_pos = (int) (str-start);
-			str++;
-			get_mirc_color(&str, NULL, NULL);
 			if (last_color_len != NULL)
-				*last_color_len = (int) (str-mircstart);
-
-		} else if (*str == 4 && str[1] != '\0') {
-			if (str[1] < FORMAT_STYLE_SPECIAL && str[2] != '\0') {
-				if (last_color_pos != NULL)
-					*last_color_pos = (int) (str-start);
-				if (last_color_len != NULL)
-					*last_color_len = 3;
-				str++;
-			} else if (str[1] == FORMAT_STYLE_DEFAULTS) {
-				if (last_color_pos != NULL)
-					*last_color_pos = (int) (str-start);
-				if (last_color_len != NULL)
-					*last_color_len = 2;
-			}
-			str += 2;
-		} else {
-			if (!IS_COLOR_CODE(*str)) {
-				if (len-- == 0)
-					break;
-			}
-			str++;
+				*last_color_len = (int) (next-str);
 		}
+		str = next;
 	}
 
 	return (int) (str-start);
@@ -885,39 +922,16 @@ int strip_real_length(const char *str, int len,
 
 char *strip_codes(const char *input)
 {
-	const char *p;
+	const char *p, *next;
 	char *str, *out;
 
 	out = str = g_strdup(input);
-	for (p = input; *p != '\0'; p++) {
-		if (*p == 3) {
-			p++;
-
-			/* mirc color */
-			get_mirc_color(&p, NULL, NULL);
-			p--;
-			continue;
-		}
-
-		if (*p == 4 && p[1] != '\0') {
-			if (p[1] >= FORMAT_STYLE_SPECIAL) {
-				p++;
-				continue;
-			}
-
-			/* irssi color */
-			if (p[2] != '\0') {
-				p += 2;
-				continue;
-			}
-		}
-
-		if (*p == 27 && p[1] != '\0') {
-			p++;
-			p = get_ansi_color(current_theme, p, NULL, NULL, NULL);
-			p--;
-		} else if (!IS_COLOR_CODE(*p))
-			*out++ = *p;
+	for (p = input; *p != '\0'; ) {
+		next = skip_code(p);
+		if (next != NULL)
+			p = next;
+		else
+			*out++ = *p++;
 	}
 
 	*out = '\0';
@@ -349,37 +349,38 @@ static void sig_print_text(TEXT_DEST_REC *dest, const char *text,
 	color = hilight_get_color(hilight);
 	hilight_len = hilight_end-hilight_start;
 
+	/* `stripped' is `text' without the codes, so it's used for the
+	   hilighted part instead of stripping it again */
 	if (!hilight->word) {
 		/* hilight whole line */
-		char *tmp = strip_codes(text);
-		newstr = g_strconcat(color, tmp, NULL);
-                g_free(tmp);
+		newstr = g_strconcat(color, stripped, NULL);
 	} else {
 		/* hilight part of the line */
                 GString *tmp;
-                char *middle;
-		int pos, color_pos, color_len;
+		int start, pos, color_pos, color_len;
+		int middle_color_pos, middle_color_len;
 
                 tmp = g_string_new(NULL);
 
                 /* start of the line */
-		pos = strip_real_length(text, hilight_start, NULL, NULL);
-		g_string_append(tmp, text);
-                g_string_truncate(tmp, pos);
+		start = strip_real_length(text, hilight_start,
+					  &color_pos, &color_len);
+		g_string_append_len(tmp, text, start);
 
 		/* color */
                 g_string_append(tmp, color);
 
 		/* middle of the line, stripped */
-		middle = strip_codes(text+pos);
-                pos = tmp->len;
-		g_string_append(tmp, middle);
-                g_string_truncate(tmp, pos+hilight_len);
-                g_free(middle);
-
-		/* end of the line */
-		pos = strip_real_length(text, hilight_end,
-					&color_pos, &color_len);
+		g_string_append_len(tmp, stripped+hilight_start, hilight_len);
+
+		/* end of the line, continuing from the start */
+		pos = start + strip_real_length(text+start, hilight_len,
+						&middle_color_pos,
+						&middle_color_len);
+		if (middle_color_pos >= 0) {
+			color_pos = start + middle_color_pos;
+			color_len = middle_color_len;
+		}
 		if (color_pos > 0)
 			g_string_append_len(tmp, text+color_pos, color_len);
                 else {
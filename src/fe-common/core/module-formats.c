@@ -72,6 +72,8 @@ FORMAT_REC fecommon_core_formats[] = {
 	{ "looking_up", "Looking up {server $0}", 1, { 0 } },
 	{ "connecting", "Connecting to {server $0} [$1] port {hilight $2}", 3, { 0, 0, 1 } },
 	{ "reconnecting", "Reconnecting to {server $0} [$1] port {hilight $2} - use /RMRECONNS to abort", 3, { 0, 0, 1 } },
+	{ "connect_attempt_ok", "Connected to {server $0} [$1] in {hilight $2}ms", 3, { 0, 0, 1 } },
+	{ "connect_attempt_failed", "Connection to {server $0} [$1] failed after {hilight $2}ms {reason $3}", 4, { 0, 0, 1, 0 } },
 	{ "connection_established", "Connection to {server $0} established", 1, { 0 } },
 	{ "cant_connect", "Unable to connect server {server $0} port {hilight $1} {reason $2}", 3, { 0, 1, 0 } },
 	{ "connection_lost", "Connection lost to {server $0}", 1, { 0 } },
@@ -86,6 +88,9 @@ FORMAT_REC fecommon_core_formats[] = {
 	{ "server_reconnect_list", "{server $0}: $1:$2 ($3) ($5 left before reconnecting)", 6, { 0, 0, 1, 0, 0, 0 } },
 	{ "server_reconnect_removed", "Removed reconnection to server {server $0} port {hilight $1}", 3, { 0, 1, 0 } },
 	{ "server_reconnect_not_found", "Reconnection tag {server $0} not found", 1, { 0 } },
+	{ "server_reconnect_status", "{hilight $0} reconnections queued, {hilight $1} connections in progress (max. $2)", 3, { 1, 1, 1 } },
+	{ "server_reconnect_status_line", "{server $0}: $1:$2 ($3) attempt $4, priority $5, $6 left before reconnecting", 7, { 0, 0, 1, 0, 1, 1, 0 } },
+	{ "server_reconnect_status_waiting", "{server $0}: $1:$2 ($3) attempt $4, priority $5, waiting for a free connection slot", 6, { 0, 0, 1, 0, 1, 1 } },
 	{ "setupserver_added", "Server {server $0} saved", 2, { 0, 1 } },
 	{ "setupserver_removed", "Server {server $0} removed", 2, { 0, 1 } },
 	{ "setupserver_not_found", "Server {server $0} not found", 2, { 0, 1 } },
@@ -49,6 +49,8 @@ enum {
 	TXT_LOOKING_UP,
 	TXT_CONNECTING,
  	TXT_RECONNECTING,
+	TXT_CONNECT_ATTEMPT_OK,
+	TXT_CONNECT_ATTEMPT_FAILED,
         TXT_CONNECTION_ESTABLISHED,
 	TXT_CANT_CONNECT,
 	TXT_CONNECTION_LOST,
@@ -63,6 +65,9 @@ enum {
 	TXT_SERVER_RECONNECT_LIST,
 	TXT_RECONNECT_REMOVED,
 	TXT_RECONNECT_NOT_FOUND,
+	TXT_RECONNECT_STATUS,
+	TXT_RECONNECT_STATUS_LINE,
+	TXT_RECONNECT_STATUS_WAITING,
 	TXT_SETUPSERVER_ADDED,
 	TXT_SETUPSERVER_REMOVED,
 	TXT_SETUPSERVER_NOT_FOUND,
@@ -35,6 +35,7 @@
 static int beep_msg_level, beep_when_away, beep_when_window_active;
 
 static int signal_gui_print_text_finished;
+static int signal_gui_print_line;
 static int signal_print_starting;
 static int signal_print_text;
 static int signal_print_format;
@@ -445,9 +446,13 @@ static void sig_print_text(TEXT_DEST_REC *dest, const char *text)
 
 	g_free_not_null(tmp);
 
-	format_send_to_gui(dest, str);
+	signal_emit_id(signal_gui_print_line, 2, dest, str);
 	g_free(str);
+}
 
+static void sig_gui_print_line(TEXT_DEST_REC *dest, const char *text)
+{
+	format_send_to_gui(dest, text);
 	signal_emit_id(signal_gui_print_text_finished, 1, dest->window);
 }
 
@@ -490,12 +495,14 @@ void printtext_init(void)
 {
 	sending_print_starting = FALSE;
 	signal_gui_print_text_finished = signal_get_uniq_id("gui print text finished");
+	signal_gui_print_line = signal_get_uniq_id("gui print line");
 	signal_print_starting = signal_get_uniq_id("print starting");
 	signal_print_text = signal_get_uniq_id("print text");
 	signal_print_format = signal_get_uniq_id("print format");
 
 	read_settings();
 	signal_add("print text", (SIGNAL_FUNC) sig_print_text);
+	signal_add_last("gui print line", (SIGNAL_FUNC) sig_gui_print_line);
 	signal_add("gui dialog", (SIGNAL_FUNC) sig_gui_dialog);
 	signal_add("setup changed", (SIGNAL_FUNC) read_settings);
 }
@@ -503,6 +510,7 @@ void printtext_init(void)
 void printtext_deinit(void)
 {
 	signal_remove("print text", (SIGNAL_FUNC) sig_print_text);
+	signal_remove("gui print line", (SIGNAL_FUNC) sig_gui_print_line);
 	signal_remove("gui dialog", (SIGNAL_FUNC) sig_gui_dialog);
 	signal_remove("setup changed", (SIGNAL_FUNC) read_settings);
 }
@@ -10,7 +10,23 @@
 
 /* Returns width for character (0-2). */
 int mk_wcwidth(unichar c);
+/* Free the width lookup tables */
+void wcwidth_deinit(void);
 
 #define unichar_isprint(c) (((c) & ~0x80) >= 32)
 
+/* Returns the number of printable ASCII characters other than space at
+   the beginning of str, but at most max. They all have width 1 and need
+   no decoding. */
+static inline int ascii_run_length(const unsigned char *str, int max)
+{
+	int len;
+
+	for (len = 0; len < max; len++) {
+		if (str[len] <= ' ' || str[len] >= 0x7f)
+			break;
+	}
+	return len;
+}
+
 #endif
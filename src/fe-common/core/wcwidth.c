@@ -119,7 +119,7 @@ static int bisearch(unichar ucs, const struct interval *table, int max) {
  * in ISO 10646.
  */
 
-int mk_wcwidth(unichar ucs)
+static int mk_wcwidth_real(unichar ucs)
 {
   /* sorted list of non-overlapping intervals of non-spacing characters */
   /* generated by "uniset +cat=Me +cat=Mn +cat=Cf -00AD +1160-11FF +200B c" */
@@ -204,6 +204,74 @@ int mk_wcwidth(unichar ucs)
 }
 
 
+/* Two level lookup table for the widths: the code points are split into
+ * blocks of 256 characters and each block's widths are calculated the
+ * first time a character from it is needed. Blocks where every character
+ * has the same width of 1 share the same table. */
+
+#define WIDTH_BLOCK_BITS 8
+#define WIDTH_BLOCK_SIZE (1 << WIDTH_BLOCK_BITS)
+#define WIDTH_BLOCKS (0x110000 >> WIDTH_BLOCK_BITS)
+
+static signed char *width_blocks[WIDTH_BLOCKS];
+static signed char width_block_single[WIDTH_BLOCK_SIZE];
+
+static signed char *width_block_fill(int block)
+{
+  signed char *widths;
+  unichar ucs;
+  int i, single;
+
+  widths = g_malloc(WIDTH_BLOCK_SIZE);
+  ucs = (unichar) block << WIDTH_BLOCK_BITS;
+
+  single = TRUE;
+  for (i = 0; i < WIDTH_BLOCK_SIZE; i++) {
+    widths[i] = mk_wcwidth_real(ucs + i);
+    if (widths[i] != 1)
+      single = FALSE;
+  }
+
+  if (single) {
+    g_free(widths);
+    if (width_block_single[0] == 0)
+      memset(width_block_single, 1, sizeof(width_block_single));
+    widths = width_block_single;
+  }
+
+  width_blocks[block] = widths;
+  return widths;
+}
+
+int mk_wcwidth(unichar ucs)
+{
+  signed char *widths;
+
+  /* printable ASCII is by far the most common */
+  if (ucs >= 32 && ucs < 0x7f)
+    return 1;
+
+  if (ucs >= 0x110000)
+    return mk_wcwidth_real(ucs);
+
+  widths = width_blocks[ucs >> WIDTH_BLOCK_BITS];
+  if (widths == NULL)
+    widths = width_block_fill(ucs >> WIDTH_BLOCK_BITS);
+  return widths[ucs & (WIDTH_BLOCK_SIZE-1)];
+}
+
+void wcwidth_deinit(void)
+{
+  int i;
+
+  for (i = 0; i < WIDTH_BLOCKS; i++) {
+    if (width_blocks[i] != width_block_single)
+      g_free(width_blocks[i]);
+    width_blocks[i] = NULL;
+  }
+}
+
+
 #if 0
 int mk_wcswidth(const unichar *pwcs, size_t n)
 {
@@ -154,12 +154,12 @@ static void event_ban_list(IRC_SERVER_REC *server, const char *data)
 		(long) (time(NULL) - atol(tims));
 
 	chanrec = irc_channel_find(server, channel);
-	banrec = chanrec == NULL ? NULL : banlist_find(chanrec->banlist, ban);
+	banrec = chanrec == NULL ? NULL : modelist_find(chanrec, 'b', ban);
 
 	channel = get_visible_target(server, channel);
 	printformat(server, channel, MSGLEVEL_CRAP,
 		    *setby == '\0' ? IRCTXT_BANLIST : IRCTXT_BANLIST_LONG,
-		    banrec == NULL ? 0 : g_slist_index(chanrec->banlist, banrec)+1,
+		    banrec == NULL ? 0 : g_list_index(chanrec->banlist, banrec)+1,
 		    channel, ban, setby, secs);
 
 	g_free(params);
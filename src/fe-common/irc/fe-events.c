@@ -315,12 +315,21 @@ static void event_silence(IRC_SERVER_REC *server, const char *data, const char *
 
 static void channel_sync(CHANNEL_REC *channel)
 {
+	IRC_CHANNEL_REC *irc_channel;
+	long msecs;
+	char *secs;
+
 	g_return_if_fail(channel != NULL);
 
+	irc_channel = IRC_CHANNEL(channel);
+	msecs = irc_channel != NULL ? irc_channel->sync_msecs :
+		(long) (time(NULL)-channel->createtime) * 1000;
+	secs = g_strdup_printf("%ld.%02ld", msecs/1000, (msecs%1000)/10);
+
 	printformat(channel->server, channel->visible_name,
 		    MSGLEVEL_CLIENTNOTICE|MSGLEVEL_NO_ACT,
-		    IRCTXT_CHANNEL_SYNCED, channel->visible_name,
-		    (long) (time(NULL)-channel->createtime));
+		    IRCTXT_CHANNEL_SYNCED, channel->visible_name, secs);
+	g_free(secs);
 }
 
 static void event_connected(IRC_SERVER_REC *server)
@@ -198,7 +198,7 @@ static void bans_ask_channel(const char *channel, IRC_SERVER_REC *server,
 
 static void bans_show_channel(IRC_CHANNEL_REC *channel, IRC_SERVER_REC *server)
 {
-	GSList *tmp;
+	GList *tmp;
         int counter;
 
 	if (channel->banlist == NULL) {
@@ -72,6 +72,8 @@ static void cmd_network_list(void)
 			g_string_append_printf(str, "max_modes: %d, ", rec->max_modes);
 		if (rec->max_whois > 0)
 			g_string_append_printf(str, "max_whois: %d, ", rec->max_whois);
+		if (rec->reconnect_priority != 0)
+			g_string_append_printf(str, "priority: %d, ", rec->reconnect_priority);
 
 		if (str->len > 1) g_string_truncate(str, str->len-2);
 		printformat(NULL, NULL, MSGLEVEL_CLIENTCRAP,
@@ -85,7 +87,7 @@ static void cmd_network_list(void)
                       [-host <host>] [-autosendcmd <cmd>]
 		      [-querychans <count>] [-whois <count>] [-msgs <count>]
 		      [-kicks <count>] [-modes <count>]
-		      [-cmdspeed <ms>] [-cmdmax <count>] <name> */
+		      [-cmdspeed <ms>] [-cmdmax <count>] [-priority <n>] <name> */
 static void cmd_network_add(const char *data)
 {
 	GHashTable *optlist;
@@ -129,6 +131,8 @@ static void cmd_network_add(const char *data)
 	if (value != NULL) rec->max_cmds_at_once = atoi(value);
 	value = g_hash_table_lookup(optlist, "querychans");
 	if (value != NULL) rec->max_query_chans = atoi(value);
+	value = g_hash_table_lookup(optlist, "priority");
+	if (value != NULL) rec->reconnect_priority = atoi(value);
 
 	value = g_hash_table_lookup(optlist, "nick");
 	if (value != NULL && *value != '\0') rec->nick = g_strdup(value);
@@ -186,7 +190,7 @@ void fe_ircnet_init(void)
 	command_bind("network add", NULL, (SIGNAL_FUNC) cmd_network_add);
 	command_bind("network remove", NULL, (SIGNAL_FUNC) cmd_network_remove);
 
-	command_set_options("network add", "-kicks -msgs -modes -whois -cmdspeed -cmdmax -nick -user -realname -host -autosendcmd -querychans -usermode");
+	command_set_options("network add", "-kicks -msgs -modes -whois -cmdspeed -cmdmax -nick -user -realname -host -autosendcmd -querychans -usermode -priority");
 }
 
 void fe_ircnet_deinit(void)
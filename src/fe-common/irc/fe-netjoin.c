@@ -41,17 +41,22 @@ typedef struct {
 	GSList *now_channels;
 } NETJOIN_REC;
 
+typedef struct {
+	char *name;
+	GSList *joins; /* NETJOIN_REC, now_channels entry, ... newest first */
+} NETJOIN_CHAN_REC;
+
 typedef struct {
 	IRC_SERVER_REC *server;
 	time_t last_netjoin;
 
-	GSList *netjoins;
-} NETJOIN_SERVER_REC;
+	GSList *netjoins; /* newest first */
+	GHashTable *nicks; /* nick -> NETJOIN_REC */
 
-typedef struct {
-	int count;
-        GString *nicks;
-} TEMP_PRINT_REC;
+	/* joins not yet printed, grouped by channel as they arrive */
+	GSList *channels; /* newest first */
+	GHashTable *channels_hash; /* name -> NETJOIN_CHAN_REC */
+} NETJOIN_SERVER_REC;
 
 static int join_tag;
 static int netjoin_max_nicks, hide_netsplit_quits;
@@ -75,40 +80,43 @@ static NETJOIN_SERVER_REC *netjoin_find_server(IRC_SERVER_REC *server)
 }
 
 static NETJOIN_REC *netjoin_add(IRC_SERVER_REC *server, const char *nick,
-				GSList *channels)
+				NETSPLIT_REC *split)
 {
 	NETJOIN_REC *rec;
 	NETJOIN_SERVER_REC *srec;
+	int i;
 
 	g_return_val_if_fail(server != NULL, NULL);
 	g_return_val_if_fail(nick != NULL, NULL);
 
 	rec = g_new0(NETJOIN_REC, 1);
 	rec->nick = g_strdup(nick);
-	while (channels != NULL) {
-		NETSPLIT_CHAN_REC *channel = channels->data;
-
-		rec->old_channels = g_slist_append(rec->old_channels,
-						   g_strdup(channel->name));
-		channels = channels->next;
+	for (i = split->channels_count-1; i >= 0; i--) {
+		rec->old_channels = g_slist_prepend(rec->old_channels,
+				g_strdup(split->channels[i].name));
 	}
 
 	srec = netjoin_find_server(server);
 	if (srec == NULL) {
 		srec = g_new0(NETJOIN_SERVER_REC, 1);
 		srec->server = server;
+		srec->nicks = g_hash_table_new((GHashFunc) g_istr_hash,
+					       (GCompareFunc) g_istr_equal);
+		srec->channels_hash =
+			g_hash_table_new((GHashFunc) g_istr_hash,
+					 (GCompareFunc) g_istr_equal);
                 joinservers = g_slist_append(joinservers, srec);
 	}
 
 	srec->last_netjoin = time(NULL);
-	srec->netjoins = g_slist_append(srec->netjoins, rec);
+	srec->netjoins = g_slist_prepend(srec->netjoins, rec);
+	g_hash_table_insert(srec->nicks, rec->nick, rec);
 	return rec;
 }
 
 static NETJOIN_REC *netjoin_find(IRC_SERVER_REC *server, const char *nick)
 {
 	NETJOIN_SERVER_REC *srec;
-	GSList *tmp;
 
 	g_return_val_if_fail(server != NULL, NULL);
 	g_return_val_if_fail(nick != NULL, NULL);
@@ -116,20 +124,32 @@ static NETJOIN_REC *netjoin_find(IRC_SERVER_REC *server, const char *nick)
 	srec = netjoin_find_server(server);
         if (srec == NULL) return NULL;
 
-	for (tmp = srec->netjoins; tmp != NULL; tmp = tmp->next) {
-		NETJOIN_REC *rec = tmp->data;
+	return g_hash_table_lookup(srec->nicks, nick);
+}
 
-		if (g_strcasecmp(rec->nick, nick) == 0)
-			return rec;
+/* remember that `rec' joined `channel' (allocated now_channels entry) */
+static void netjoin_add_channel(NETJOIN_SERVER_REC *server, NETJOIN_REC *rec,
+				char *channel)
+{
+	NETJOIN_CHAN_REC *chanrec;
+
+	rec->now_channels = g_slist_append(rec->now_channels, channel);
+
+	chanrec = g_hash_table_lookup(server->channels_hash, channel+1);
+	if (chanrec == NULL) {
+		chanrec = g_new0(NETJOIN_CHAN_REC, 1);
+		chanrec->name = g_strdup(channel+1);
+		server->channels = g_slist_prepend(server->channels, chanrec);
+		g_hash_table_insert(server->channels_hash,
+				    chanrec->name, chanrec);
 	}
 
-	return NULL;
+	chanrec->joins = g_slist_prepend(chanrec->joins, channel);
+	chanrec->joins = g_slist_prepend(chanrec->joins, rec);
 }
 
-static void netjoin_remove(NETJOIN_SERVER_REC *server, NETJOIN_REC *rec)
+static void netjoin_free(NETJOIN_REC *rec)
 {
-	server->netjoins = g_slist_remove(server->netjoins, rec);
-
         g_slist_foreach(rec->old_channels, (GFunc) g_free, NULL);
 	g_slist_foreach(rec->now_channels, (GFunc) g_free, NULL);
 	g_slist_free(rec->old_channels);
@@ -139,45 +159,86 @@ static void netjoin_remove(NETJOIN_SERVER_REC *server, NETJOIN_REC *rec)
 	g_free(rec);
 }
 
+static void netjoin_channels_free(NETJOIN_SERVER_REC *server)
+{
+	while (server->channels != NULL) {
+		NETJOIN_CHAN_REC *chanrec = server->channels->data;
+
+		g_hash_table_remove(server->channels_hash, chanrec->name);
+		server->channels = g_slist_remove(server->channels, chanrec);
+
+		g_slist_free(chanrec->joins);
+		g_free(chanrec->name);
+		g_free(chanrec);
+	}
+}
+
 static void netjoin_server_remove(NETJOIN_SERVER_REC *server)
 {
 	joinservers = g_slist_remove(joinservers, server);
 
-	while (server->netjoins != NULL)
-		netjoin_remove(server, server->netjoins->data);
+	netjoin_channels_free(server);
+	g_hash_table_destroy(server->channels_hash);
+
+	g_slist_foreach(server->netjoins, (GFunc) netjoin_free, NULL);
+	g_slist_free(server->netjoins);
+	g_hash_table_destroy(server->nicks);
         g_free(server);
 }
 
-static void print_channel_netjoins(char *channel, TEMP_PRINT_REC *rec,
+static void print_channel_netjoins(NETJOIN_CHAN_REC *chanrec,
 				   NETJOIN_SERVER_REC *server)
 {
-	if (rec->nicks->len > 0)
-		g_string_truncate(rec->nicks, rec->nicks->len-2);
+	GString *nicks;
+	GSList *joins, *tmp;
+	int count;
+
+	/* joins are stored newest first, print them in arrival order */
+	joins = g_slist_reverse(g_slist_copy(chanrec->joins));
+
+	nicks = g_string_new(NULL);
+	count = 0;
+	for (tmp = joins; tmp != NULL; tmp = tmp->next->next) {
+		char *channel = tmp->data;
+		NETJOIN_REC *rec = tmp->next->data;
+
+		if (++count > netjoin_max_nicks)
+			continue;
+
+		if (*channel != ' ')
+			g_string_append_c(nicks, *channel);
+		g_string_append_printf(nicks, "%s, ", rec->nick);
+	}
+	g_slist_free(joins);
 
-	printformat(server->server, channel, MSGLEVEL_JOINS,
-		    rec->count > netjoin_max_nicks ?
+	if (nicks->len > 0)
+		g_string_truncate(nicks, nicks->len-2);
+
+	printformat(server->server, chanrec->name, MSGLEVEL_JOINS,
+		    count > netjoin_max_nicks ?
 		    IRCTXT_NETSPLIT_JOIN_MORE : IRCTXT_NETSPLIT_JOIN,
-		    rec->nicks->str, rec->count-netjoin_max_nicks);
+		    nicks->str, count-netjoin_max_nicks);
 
-	g_string_free(rec->nicks, TRUE);
-	g_free(rec);
-	g_free(channel);
+	g_string_free(nicks, TRUE);
 }
 
 static void print_netjoins(NETJOIN_SERVER_REC *server)
 {
-	TEMP_PRINT_REC *temp;
-	GHashTable *channels;
-	GSList *tmp, *next, *old;
+	GSList *tmp, *next, *old, *netjoins;
 
 	g_return_if_fail(server != NULL);
 
 	printing_joins = TRUE;
 
-	/* save nicks to string, clear now_channels and remove the same
-	   channels from old_channels list */
-	channels = g_hash_table_new((GHashFunc) g_istr_hash,
-				    (GCompareFunc) g_istr_equal);
+	/* the joins are already grouped by channel, just print them */
+	server->channels = g_slist_reverse(server->channels);
+	g_slist_foreach(server->channels, (GFunc) print_channel_netjoins,
+			server);
+	netjoin_channels_free(server);
+
+	/* clear now_channels and remove the same channels from
+	   old_channels list */
+	netjoins = NULL;
 	for (tmp = server->netjoins; tmp != NULL; tmp = next) {
 		NETJOIN_REC *rec = tmp->data;
 
@@ -186,24 +247,6 @@ static void print_netjoins(NETJOIN_SERVER_REC *server)
 			char *channel = rec->now_channels->data;
 			char *realchannel = channel + 1;
 
-			temp = g_hash_table_lookup(channels, realchannel);
-			if (temp == NULL) {
-				temp = g_new0(TEMP_PRINT_REC, 1);
-				temp->nicks = g_string_new(NULL);
-				g_hash_table_insert(channels,
-						    g_strdup(realchannel),
-						    temp);
-			}
-
-			temp->count++;
-			if (temp->count <= netjoin_max_nicks) {
-				if (*channel != ' ')
-					g_string_append_c(temp->nicks,
-							  *channel);
-				g_string_append_printf(temp->nicks, "%s, ",
-						  rec->nick);
-			}
-
 			/* remove the channel from old_channels too */
 			old = gslist_find_icase_string(rec->old_channels,
 						       realchannel);
@@ -219,13 +262,15 @@ static void print_netjoins(NETJOIN_SERVER_REC *server)
 			g_free(channel);
 		}
 
-		if (rec->old_channels == NULL)
-                        netjoin_remove(server, rec);
+		if (rec->old_channels == NULL) {
+			g_hash_table_remove(server->nicks, rec->nick);
+			netjoin_free(rec);
+		} else {
+			netjoins = g_slist_prepend(netjoins, rec);
+		}
 	}
-
-	g_hash_table_foreach(channels, (GHFunc) print_channel_netjoins,
-			     server);
-	g_hash_table_destroy(channels);
+	g_slist_free(server->netjoins);
+	server->netjoins = g_slist_reverse(netjoins);
 
 	if (server->netjoins == NULL)
 		netjoin_server_remove(server);
@@ -309,7 +354,6 @@ static void msg_join(IRC_SERVER_REC *server, const char *channel,
 {
 	NETSPLIT_REC *split;
 	NETJOIN_REC *netjoin;
-	GSList *channels;
 	int rejoin = 1;
 
 	if (!IS_IRC_SERVER(server))
@@ -329,17 +373,10 @@ static void msg_join(IRC_SERVER_REC *server, const char *channel,
 		if (!gslist_find_icase_string(netjoin->old_channels, channel))
 			return;
 	} else {
-		channels = split->channels;
-		while (channels != NULL) {
-			NETSPLIT_CHAN_REC *schannel = channels->data;
-
-			if (!strcasecmp(schannel->name, channel))
-				break;
-			channels = channels->next;
-		}
 		/* we still need to create a NETJOIN_REC now as the
 		 * NETSPLIT_REC will be destroyed */
-		if (channels == NULL)
+		if (netsplit_find_channel(server, nick, address,
+					  channel) == NULL)
 			rejoin = 0;
 	}
 
@@ -350,12 +387,12 @@ static void msg_join(IRC_SERVER_REC *server, const char *channel,
 	}
 
 	if (netjoin == NULL)
-		netjoin = netjoin_add(server, nick, split->channels);
+		netjoin = netjoin_add(server, nick, split);
 
 	if (rejoin)
 	{
-		netjoin->now_channels = g_slist_append(netjoin->now_channels,
-						       g_strconcat(" ", channel, NULL));
+		netjoin_add_channel(netjoin_find_server(server), netjoin,
+				    g_strconcat(" ", channel, NULL));
 		signal_stop();
 	}
 }
@@ -22,6 +22,7 @@
 #include "module-formats.h"
 #include "signals.h"
 #include "levels.h"
+#include "misc.h"
 #include "settings.h"
 
 #include "irc-servers.h"
@@ -54,109 +55,228 @@ static int get_last_split(IRC_SERVER_REC *server)
 
 typedef struct {
 	char *name;
-	int nick_count, maxnickpos;
-	GString *nicks;
+	int prints;
+} TEMP_SPLIT_DEST_REC;
+
+typedef struct {
+	NETSPLIT_REC *split; /* NULL if the nick has already rejoined */
+	TEMP_SPLIT_DEST_REC *dest;
+	char prefix; /* '@', '+' or '\0' */
+} TEMP_SPLIT_NICK_REC;
+
+typedef struct {
+	char *name;
+	GSList *nicks; /* TEMP_SPLIT_NICK_REC, newest first */
 } TEMP_SPLIT_CHAN_REC;
 
 typedef struct {
-        IRC_SERVER_REC *server_rec;
-	GSList *servers; /* if many servers splitted from the same one */
-	GSList *channels;
+	char *source; /* source server */
+	GSList *destservers; /* if many servers splitted from the same one */
+	GSList *channels; /* newest first */
+	GHashTable *channels_hash;
 } TEMP_SPLIT_REC;
 
-static GSList *get_source_servers(const char *server, GSList **servers)
+typedef struct {
+        IRC_SERVER_REC *server;
+	GSList *splits; /* newest first */
+	GHashTable *splits_hash; /* source server -> TEMP_SPLIT_REC */
+} TEMP_SPLIT_SERVER_REC;
+
+/* splits that haven't been printed yet, collected as they arrive */
+static GSList *split_servers;
+/* NETSPLIT_REC -> GSList of its unprinted TEMP_SPLIT_NICK_RECs */
+static GHashTable *split_nicks;
+
+static TEMP_SPLIT_SERVER_REC *split_server_find(IRC_SERVER_REC *server)
 {
-	GSList *list, *next, *tmp;
+	GSList *tmp;
 
-	list = NULL;
-	for (tmp = *servers; tmp != NULL; tmp = next) {
-		NETSPLIT_SERVER_REC *rec = tmp->data;
-		next = tmp->next;
+	for (tmp = split_servers; tmp != NULL; tmp = tmp->next) {
+		TEMP_SPLIT_SERVER_REC *rec = tmp->data;
 
-		if (g_strcasecmp(rec->server, server) == 0) {
-			rec->prints = 0;
-			list = g_slist_append(list, rec);
-			*servers = g_slist_remove(*servers, rec);
-		}
+		if (rec->server == server)
+			return rec;
 	}
 
-	return list;
+	return NULL;
+}
+
+static TEMP_SPLIT_REC *split_source_get(IRC_SERVER_REC *server,
+					const char *source)
+{
+	TEMP_SPLIT_SERVER_REC *srec;
+	TEMP_SPLIT_REC *rec;
+
+	srec = split_server_find(server);
+	if (srec == NULL) {
+		srec = g_new0(TEMP_SPLIT_SERVER_REC, 1);
+		srec->server = server;
+		srec->splits_hash = g_hash_table_new((GHashFunc) g_istr_hash,
+						     (GCompareFunc) g_istr_equal);
+		split_servers = g_slist_append(split_servers, srec);
+	}
+
+	rec = g_hash_table_lookup(srec->splits_hash, source);
+	if (rec == NULL) {
+		rec = g_new0(TEMP_SPLIT_REC, 1);
+		rec->source = g_strdup(source);
+		rec->channels_hash = g_hash_table_new((GHashFunc) g_istr_hash,
+						      (GCompareFunc) g_istr_equal);
+		srec->splits = g_slist_prepend(srec->splits, rec);
+		g_hash_table_insert(srec->splits_hash, rec->source, rec);
+	}
+
+	return rec;
 }
 
-static TEMP_SPLIT_CHAN_REC *find_split_chan(TEMP_SPLIT_REC *rec,
-					    const char *name)
+static TEMP_SPLIT_DEST_REC *split_dest_get(TEMP_SPLIT_REC *rec,
+					   const char *destserver)
 {
+	TEMP_SPLIT_DEST_REC *dest;
 	GSList *tmp;
 
-	for (tmp = rec->channels; tmp != NULL; tmp = tmp->next) {
-		TEMP_SPLIT_CHAN_REC *chanrec = tmp->data;
+	for (tmp = rec->destservers; tmp != NULL; tmp = tmp->next) {
+		dest = tmp->data;
 
-		if (g_strcasecmp(chanrec->name, name) == 0)
-			return chanrec;
+		if (g_strcasecmp(dest->name, destserver) == 0)
+			return dest;
 	}
 
-	return NULL;
+	dest = g_new0(TEMP_SPLIT_DEST_REC, 1);
+	dest->name = g_strdup(destserver);
+	rec->destservers = g_slist_append(rec->destservers, dest);
+	return dest;
 }
 
-static void get_server_splits(void *key, NETSPLIT_REC *split,
-			      TEMP_SPLIT_REC *rec)
+static void split_add(NETSPLIT_REC *split, IRC_SERVER_REC *server)
 {
+	TEMP_SPLIT_REC *rec;
+	TEMP_SPLIT_DEST_REC *dest;
 	TEMP_SPLIT_CHAN_REC *chanrec;
-	GSList *tmp;
+	TEMP_SPLIT_NICK_REC *nickrec;
+	GSList *nicks;
+	int i;
 
-	if (split->printed ||
-	    g_slist_find(rec->servers, split->server) == NULL)
-		return;
+	rec = split_source_get(server, split->server->server);
+	dest = split_dest_get(rec, split->server->destserver);
 
 	split->printed = TRUE;
-	for (tmp = split->channels; tmp != NULL; tmp = tmp->next) {
-		NETSPLIT_CHAN_REC *splitchan = tmp->data;
+	nicks = g_hash_table_lookup(split_nicks, split);
+	for (i = 0; i < split->channels_count; i++) {
+		NETSPLIT_CHAN_REC *splitchan = &split->channels[i];
 
-		if (ignore_check(SERVER(rec->server_rec), split->nick,
+		if (ignore_check(SERVER(server), split->nick,
 				 split->address, splitchan->name, "",
 				 MSGLEVEL_QUITS))
 			continue;
 
-		chanrec = find_split_chan(rec, splitchan->name);
+		chanrec = g_hash_table_lookup(rec->channels_hash,
+					      splitchan->name);
 		if (chanrec == NULL) {
 			chanrec = g_new0(TEMP_SPLIT_CHAN_REC, 1);
-			chanrec->name = splitchan->name;
-			chanrec->nicks = g_string_new(NULL);
+			chanrec->name = g_strdup(splitchan->name);
 
-			rec->channels = g_slist_append(rec->channels, chanrec);
+			rec->channels = g_slist_prepend(rec->channels, chanrec);
+			g_hash_table_insert(rec->channels_hash,
+					    chanrec->name, chanrec);
 		}
 
-		split->server->prints++;
-		chanrec->nick_count++;
-		if (netsplit_nicks_hide_threshold <= 0 ||
-		    chanrec->nick_count <= netsplit_nicks_hide_threshold) {
-			if (splitchan->op)
-				g_string_append_c(chanrec->nicks, '@');
-			else if (splitchan->voice)
-				g_string_append_c(chanrec->nicks, '+');
-			g_string_append_printf(chanrec->nicks, "%s, ", split->nick);
-
-			if (chanrec->nick_count == netsplit_max_nicks)
-                                chanrec->maxnickpos = chanrec->nicks->len;
-		}
+		nickrec = g_new0(TEMP_SPLIT_NICK_REC, 1);
+		nickrec->split = split;
+		nickrec->dest = dest;
+		nickrec->prefix = splitchan->op ? '@' :
+			splitchan->voice ? '+' : '\0';
+
+		chanrec->nicks = g_slist_prepend(chanrec->nicks, nickrec);
+		nicks = g_slist_prepend(nicks, nickrec);
 	}
+
+	if (nicks != NULL)
+		g_hash_table_insert(split_nicks, split, nicks);
 }
 
-static void print_server_splits(IRC_SERVER_REC *server, TEMP_SPLIT_REC *rec)
+/* the nick rejoined (or the split expired) before it was printed */
+static void sig_netsplit_remove(NETSPLIT_REC *split)
+{
+	GSList *nicks, *tmp;
+
+	nicks = g_hash_table_lookup(split_nicks, split);
+	if (nicks == NULL)
+		return;
+
+	for (tmp = nicks; tmp != NULL; tmp = tmp->next) {
+		TEMP_SPLIT_NICK_REC *nickrec = tmp->data;
+
+		nickrec->split = NULL;
+	}
+	g_hash_table_remove(split_nicks, split);
+	g_slist_free(nicks);
+}
+
+/* "@nick1, +nick2, .." of the nicks that haven't rejoined yet, returns
+   NULL if there's none. `count' is set to the number of nicks and `maxpos'
+   to the string length after netsplit_max_nicks of them. */
+static GString *split_chan_nicks(TEMP_SPLIT_CHAN_REC *chan,
+				 int *count, int *maxpos)
 {
-	GString *destservers;
-	char *sourceserver;
+	GString *nicks;
 	GSList *tmp;
 
-	destservers = g_string_new(NULL);
-	for (tmp = rec->servers; tmp != NULL; tmp = tmp->next) {
-		NETSPLIT_SERVER_REC *rec = tmp->data;
+	*count = *maxpos = 0;
+	nicks = g_string_new(NULL);
+	for (tmp = chan->nicks; tmp != NULL; tmp = tmp->next) {
+		TEMP_SPLIT_NICK_REC *nickrec = tmp->data;
+
+		if (nickrec->split == NULL)
+			continue;
+
+		(*count)++;
+		if (netsplit_nicks_hide_threshold > 0 &&
+		    *count > netsplit_nicks_hide_threshold)
+			continue;
+
+		if (nickrec->prefix != '\0')
+			g_string_append_c(nicks, nickrec->prefix);
+		g_string_append_printf(nicks, "%s, ", nickrec->split->nick);
+
+		if (*count == netsplit_max_nicks)
+			*maxpos = nicks->len;
+	}
+
+	if (*count == 0) {
+		g_string_free(nicks, TRUE);
+		return NULL;
+	}
 
-		if (rec->prints > 0) {
-			g_string_append_printf(destservers, "%s, ",
-					  rec->destserver);
+	g_string_truncate(nicks, nicks->len-2);
+	return nicks;
+}
+
+static void print_server_splits(IRC_SERVER_REC *server, TEMP_SPLIT_REC *rec)
+{
+	GString *destservers, *nicks;
+	GSList *tmp, *ntmp;
+	int count, maxpos;
+
+	/* only count the nicks that haven't rejoined already */
+	for (tmp = rec->channels; tmp != NULL; tmp = tmp->next) {
+		TEMP_SPLIT_CHAN_REC *chan = tmp->data;
+
+		for (ntmp = chan->nicks; ntmp != NULL; ntmp = ntmp->next) {
+			TEMP_SPLIT_NICK_REC *nickrec = ntmp->data;
+
+			if (nickrec->split != NULL)
+				nickrec->dest->prints++;
 		}
 	}
+
+	destservers = g_string_new(NULL);
+	for (tmp = rec->destservers; tmp != NULL; tmp = tmp->next) {
+		TEMP_SPLIT_DEST_REC *dest = tmp->data;
+
+		if (dest->prints > 0)
+			g_string_append_printf(destservers, "%s, ", dest->name);
+	}
 	if (destservers->len == 0) {
                 /* no nicks to print in this server */
 		g_string_free(destservers, TRUE);
@@ -164,61 +284,99 @@ static void print_server_splits(IRC_SERVER_REC *server, TEMP_SPLIT_REC *rec)
 	}
 	g_string_truncate(destservers, destservers->len-2);
 
-	sourceserver = ((NETSPLIT_SERVER_REC *) (rec->servers->data))->server;
+	rec->channels = g_slist_reverse(rec->channels);
 	for (tmp = rec->channels; tmp != NULL; tmp = tmp->next) {
 		TEMP_SPLIT_CHAN_REC *chan = tmp->data;
 
-		g_string_truncate(chan->nicks, chan->nicks->len-2);
+		chan->nicks = g_slist_reverse(chan->nicks);
+		nicks = split_chan_nicks(chan, &count, &maxpos);
+		if (nicks == NULL)
+			continue;
 
-		if (netsplit_max_nicks > 0 &&
-		    chan->nick_count > netsplit_max_nicks) {
-			g_string_truncate(chan->nicks, chan->maxnickpos);
+		if (netsplit_max_nicks > 0 && count > netsplit_max_nicks) {
+			g_string_truncate(nicks, maxpos);
 			printformat(server, chan->name, MSGLEVEL_QUITS,
-				    IRCTXT_NETSPLIT_MORE, sourceserver,
-				    destservers->str, chan->nicks->str,
-				    chan->nick_count - netsplit_max_nicks);
+				    IRCTXT_NETSPLIT_MORE, rec->source,
+				    destservers->str, nicks->str,
+				    count - netsplit_max_nicks);
 		} else {
 			printformat(server, chan->name, MSGLEVEL_QUITS,
-				    IRCTXT_NETSPLIT, sourceserver,
-				    destservers->str, chan->nicks->str);
+				    IRCTXT_NETSPLIT, rec->source,
+				    destservers->str, nicks->str);
 		}
+		g_string_free(nicks, TRUE);
 	}
 
 	g_string_free(destservers, TRUE);
 }
 
+static void temp_split_nick_free(TEMP_SPLIT_NICK_REC *rec)
+{
+	GSList *nicks;
+
+	if (rec->split != NULL) {
+		/* forget all the split's nicks, they're being freed too */
+		nicks = g_hash_table_lookup(split_nicks, rec->split);
+		if (nicks != NULL) {
+			g_hash_table_remove(split_nicks, rec->split);
+			g_slist_free(nicks);
+		}
+	}
+	g_free(rec);
+}
+
 static void temp_split_chan_free(TEMP_SPLIT_CHAN_REC *rec)
 {
-	g_string_free(rec->nicks, TRUE);
+	g_slist_foreach(rec->nicks, (GFunc) temp_split_nick_free, NULL);
+	g_slist_free(rec->nicks);
+	g_free(rec->name);
 	g_free(rec);
 }
 
-static void print_splits(IRC_SERVER_REC *server)
+static void temp_split_dest_free(TEMP_SPLIT_DEST_REC *rec)
 {
-	TEMP_SPLIT_REC temp;
-	GSList *servers;
+	g_free(rec->name);
+	g_free(rec);
+}
 
-	printing_splits = TRUE;
+static void temp_split_free(TEMP_SPLIT_REC *rec)
+{
+	g_slist_foreach(rec->channels, (GFunc) temp_split_chan_free, NULL);
+	g_slist_foreach(rec->destservers, (GFunc) temp_split_dest_free, NULL);
+	g_slist_free(rec->channels);
+	g_slist_free(rec->destservers);
+	g_hash_table_destroy(rec->channels_hash);
+	g_free(rec->source);
+	g_free(rec);
+}
 
-	servers = g_slist_copy(server->split_servers);
-	while (servers != NULL) {
-		NETSPLIT_SERVER_REC *sserver = servers->data;
+static void split_server_free(TEMP_SPLIT_SERVER_REC *rec)
+{
+	split_servers = g_slist_remove(split_servers, rec);
 
-		/* get all the splitted servers that have the same
-		   source server */
-                temp.servers = get_source_servers(sserver->server, &servers);
-                temp.server_rec = server;
-		temp.channels = NULL;
+	g_slist_foreach(rec->splits, (GFunc) temp_split_free, NULL);
+	g_slist_free(rec->splits);
+	g_hash_table_destroy(rec->splits_hash);
+	g_free(rec);
+}
 
-		g_hash_table_foreach(server->splits,
-				     (GHFunc) get_server_splits, &temp);
-		print_server_splits(server, &temp);
+static void print_splits(IRC_SERVER_REC *server)
+{
+	TEMP_SPLIT_SERVER_REC *srec;
+	GSList *tmp;
 
-		g_slist_foreach(temp.channels,
-				(GFunc) temp_split_chan_free, NULL);
-		g_slist_free(temp.servers);
-		g_slist_free(temp.channels);
-	}
+	srec = split_server_find(server);
+	if (srec == NULL)
+		return;
+
+	printing_splits = TRUE;
+
+	/* the splits were already grouped by their source server and
+	   channel when they arrived, just print them */
+	srec->splits = g_slist_reverse(srec->splits);
+	for (tmp = srec->splits; tmp != NULL; tmp = tmp->next)
+		print_server_splits(server, tmp->data);
+	split_server_free(srec);
 
 	printing_splits = FALSE;
 }
@@ -249,7 +407,7 @@ static void sig_print_starting(void)
 	for (tmp = servers; tmp != NULL; tmp = tmp->next) {
 		IRC_SERVER_REC *rec = tmp->data;
 
-		if (IS_IRC_SERVER(rec) && rec->split_servers != NULL)
+		if (IS_IRC_SERVER(rec))
 			print_splits(rec);
 	}
 }
@@ -280,6 +438,21 @@ static int sig_check_splits(void)
 	return 1;
 }
 
+static void sig_netsplit_new(NETSPLIT_REC *split, IRC_SERVER_REC *server)
+{
+	if (settings_get_bool("hide_netsplit_quits"))
+		split_add(split, server);
+}
+
+static void sig_server_disconnected(IRC_SERVER_REC *server)
+{
+	TEMP_SPLIT_SERVER_REC *rec;
+
+	rec = split_server_find(server);
+	if (rec != NULL)
+		split_server_free(rec);
+}
+
 static void sig_netsplit_servers(void)
 {
 	if (settings_get_bool("hide_netsplit_quits") && split_tag == -1) {
@@ -306,8 +479,8 @@ static void split_print(NETSPLIT_REC *rec, SERVER_REC *server)
 	NETSPLIT_CHAN_REC *chan;
         char *chanstr;
 
-	chan = rec->channels->data;
-	chanstr = chan == NULL ? "" :
+	chan = rec->channels;
+	chanstr = chan == NULL ? g_strdup("") :
 		g_strconcat(chan->op ? "@" :
 			    (chan->voice ? "+" : ""), chan->name, NULL);
 
@@ -357,8 +530,14 @@ void fe_netsplit_init(void)
 	split_tag = -1;
 	printing_splits = FALSE;
 
+	split_nicks = g_hash_table_new((GHashFunc) g_direct_hash,
+				       (GCompareFunc) g_direct_equal);
+
 	read_settings();
-	signal_add("netsplit new", (SIGNAL_FUNC) sig_netsplit_servers);
+	signal_add("netsplit new", (SIGNAL_FUNC) sig_netsplit_new);
+	signal_add("netsplit remove", (SIGNAL_FUNC) sig_netsplit_remove);
+	signal_add("netsplit batch", (SIGNAL_FUNC) sig_netsplit_servers);
+	signal_add("server disconnected", (SIGNAL_FUNC) sig_server_disconnected);
 	signal_add("setup changed", (SIGNAL_FUNC) read_settings);
 	command_bind_irc("netsplit", NULL, (SIGNAL_FUNC) cmd_netsplit);
 }
@@ -370,7 +549,14 @@ void fe_netsplit_deinit(void)
 		signal_remove("print starting", (SIGNAL_FUNC) sig_print_starting);
 	}
 
-	signal_remove("netsplit new", (SIGNAL_FUNC) sig_netsplit_servers);
+	while (split_servers != NULL)
+		split_server_free(split_servers->data);
+	g_hash_table_destroy(split_nicks);
+
+	signal_remove("netsplit new", (SIGNAL_FUNC) sig_netsplit_new);
+	signal_remove("netsplit remove", (SIGNAL_FUNC) sig_netsplit_remove);
+	signal_remove("netsplit batch", (SIGNAL_FUNC) sig_netsplit_servers);
+	signal_remove("server disconnected", (SIGNAL_FUNC) sig_server_disconnected);
 	signal_remove("setup changed", (SIGNAL_FUNC) read_settings);
 	command_unbind("netsplit", (SIGNAL_FUNC) cmd_netsplit);
 }
@@ -76,7 +76,7 @@ FORMAT_REC fecommon_irc_formats[] = {
 	{ "invitelist", "{channel $0}: invite {ban $1}", 2, { 0, 0 } },
 	{ "invitelist_long", "{channel $0}: invite {ban $1} {comment by {nick $2}, $3 secs ago}", 4, { 0, 0, 0, 1 } },
 	{ "no_such_channel", "{channel $0}: No such channel", 1, { 0 } },
-	{ "channel_synced", "Join to {channel $0} was synced in {hilight $1} secs", 2, { 0, 2 } },
+	{ "channel_synced", "Join to {channel $0} was synced in {hilight $1} secs", 2, { 0, 0 } },
 
 	/* ---- */
 	{ NULL, "Nick", 0 },
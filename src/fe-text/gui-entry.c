@@ -278,6 +278,9 @@ static void gui_entry_draw_from(GUI_ENTRY_REC *entry, int pos)
 
 static void gui_entry_draw(GUI_ENTRY_REC *entry)
 {
+	if (term_detached)
+		return;
+
 	if (entry->redraw_needed_from >= 0) {
 		gui_entry_draw_from(entry, entry->redraw_needed_from);
                 entry->redraw_needed_from = -1;
@@ -29,8 +29,19 @@
 #include "gui-printtext.h"
 #include "gui-windows.h"
 
+/* header of a line in GUI_WINDOW_REC->deferred, followed by the text */
+typedef struct {
+	time_t time;
+	int level;
+	int len; /* length of text, including the \0 */
+} DEFERRED_LINE_REC;
+
 int mirc_colors[] = { 15, 0, 1, 2, 12, 4, 5, 6, 14, 10, 3, 11, 9, 13, 8, 7 };
 static int scrollback_lines, scrollback_time, scrollback_burst_remove;
+static int scrollback_max_size;
+static int scrollback_lazy_render;
+static int scrollback_disk_overflow;
+static time_t deferred_line_time;
 
 static int next_xpos, next_ypos;
 
@@ -114,6 +125,15 @@ void gui_printtext_after(TEXT_DEST_REC *dest, LINE_REC *prev, const char *str)
 	gui->use_insert_after = FALSE;
 }
 
+/* Remove the first line of the view, saving it to disk first if
+   scrollback_disk_overflow is set */
+static void remove_first_line(TEXT_BUFFER_VIEW_REC *view)
+{
+	if (scrollback_disk_overflow)
+		textbuffer_disk_save_first(view->buffer);
+	textbuffer_view_remove_line(view, view->buffer->first_line);
+}
+
 static void remove_old_lines(TEXT_BUFFER_VIEW_REC *view)
 {
 	LINE_REC *line;
@@ -132,9 +152,99 @@ static void remove_old_lines(TEXT_BUFFER_VIEW_REC *view)
 				   only scrollback_time setting. */
 				break;
 			}
-			textbuffer_view_remove_line(view, line);
+			if (scrollback_disk_overflow && !view->bottom &&
+			    line == view->startline) {
+				/* the lines being looked at may have just
+				   been loaded from disk, keep them */
+				break;
+			}
+			remove_first_line(view);
+		}
+	}
+}
+
+/* Compact the hidden windows whose text chunks are mostly empty */
+static void scrollback_compact(void)
+{
+	GSList *tmp;
+
+	for (tmp = windows; tmp != NULL; tmp = tmp->next) {
+		WINDOW_REC *window = tmp->data;
+		TEXT_BUFFER_VIEW_REC *view = WINDOW_GUI(window)->view;
+
+		if (view->window == NULL &&
+		    view->buffer->chunks_size > view->buffer->text_size*2)
+			textbuffer_view_compact(view);
+	}
+}
+
+/* Find the window to remove lines from when scrollback_max_size is
+   exceeded - the larger and the longer not viewed, the better. Windows
+   are never made to have less than a screenful of lines. */
+static WINDOW_REC *scrollback_find_evictable(void)
+{
+	WINDOW_REC *best;
+	GSList *tmp;
+	time_t now;
+	double score, best_score;
+	int age;
+
+	now = time(NULL);
+	best = NULL; best_score = 0;
+	for (tmp = windows; tmp != NULL; tmp = tmp->next) {
+		WINDOW_REC *window = tmp->data;
+		GUI_WINDOW_REC *gui = WINDOW_GUI(window);
+
+		if (gui->view->buffer->lines_count <= gui->view->height)
+			continue;
+
+		age = gui->view->window != NULL ? 0 :
+			(int) (now - gui->last_viewed);
+		score = (double) textbuffer_get_size(gui->view->buffer) *
+			(1.0 + age/60.0);
+		if (score > best_score) {
+			best = window;
+			best_score = score;
 		}
 	}
+
+	return best;
+}
+
+/* Keep the total size of all scrollbacks below scrollback_max_size */
+static void scrollback_check_size(void)
+{
+	TEXT_BUFFER_VIEW_REC *view;
+	WINDOW_REC *window;
+	size_t limit;
+	int count;
+
+	if (scrollback_max_size <= 0 ||
+	    textbuffer_get_total_size() <= (size_t) scrollback_max_size)
+		return;
+
+	/* go a bit below the limit so we don't need to do this after
+	   every printed line */
+	limit = scrollback_max_size - scrollback_max_size/10;
+
+	scrollback_compact();
+	while (textbuffer_get_total_size() > limit) {
+		window = scrollback_find_evictable();
+		if (window == NULL)
+			break;
+
+		view = WINDOW_GUI(window)->view;
+		count = view->buffer->lines_count/10;
+		if (count < scrollback_burst_remove)
+			count = scrollback_burst_remove;
+		if (count > view->buffer->lines_count - view->height)
+			count = view->buffer->lines_count - view->height;
+		if (count <= 0)
+			count = 1;
+
+		while (count-- > 0)
+			remove_first_line(view);
+	}
 }
 
 static void get_colors(int flags, int *fg, int *bg, int *attr)
@@ -199,7 +309,8 @@ static void sig_gui_print_text(WINDOW_REC *window, void *fgcolor,
 	}
 
 	lineinfo.level = dest == NULL ? 0 : dest->level;
-        lineinfo.time = time(NULL);
+	lineinfo.time = deferred_line_time != 0 ?
+		deferred_line_time : time(NULL);
 
         gui = WINDOW_GUI(window);
 	view = gui->view;
@@ -229,13 +340,143 @@ static void sig_gui_printtext_finished(WINDOW_REC *window)
 
         view_add_eol(view, &insert_after);
 	remove_old_lines(view);
+	scrollback_check_size();
+}
+
+/* drop the oldest deferred lines that remove_old_lines() would remove
+   anyway once they're added to view */
+static void deferred_remove_old_lines(GUI_WINDOW_REC *gui)
+{
+	DEFERRED_LINE_REC rec;
+	time_t old_time;
+	gsize pos;
+
+	if (scrollback_lines == 0 || gui->deferred_count < scrollback_lines*2)
+		return;
+
+	old_time = time(NULL)-scrollback_time+1;
+	pos = 0;
+	while (gui->deferred_count > scrollback_lines) {
+		memcpy(&rec, gui->deferred->str + pos, sizeof(rec));
+		if (rec.time >= old_time)
+			break;
+
+		pos += sizeof(rec) + rec.len;
+		gui->deferred_count--;
+	}
+
+	if (pos > 0)
+		g_string_erase(gui->deferred, 0, pos);
+}
+
+static void sig_gui_print_line(TEXT_DEST_REC *dest, const char *text)
+{
+	GUI_WINDOW_REC *gui;
+	DEFERRED_LINE_REC rec;
+	gsize start;
+	int beep;
+
+	if (!scrollback_lazy_render || dest->window == NULL)
+		return;
+
+	gui = WINDOW_GUI(dest->window);
+	if (gui == NULL || gui->view->window != NULL || gui->use_insert_after)
+		return;
+
+	/* window isn't visible - just store the line, it's converted to
+	   textbuffer when the window is shown */
+	if (gui->deferred == NULL)
+		gui->deferred = g_string_new(NULL);
+
+	start = gui->deferred->len;
+	g_string_set_size(gui->deferred, start + sizeof(rec));
+
+	/* bells are handled now, not when the line is added to view */
+	beep = FALSE;
+	for (; *text != '\0'; text++) {
+		if (*text == 7)
+			beep = TRUE;
+		else
+			g_string_append_c(gui->deferred, *text);
+	}
+	g_string_append_c(gui->deferred, '\0');
+
+	rec.time = time(NULL);
+	rec.level = dest->level;
+	rec.len = gui->deferred->len - start - sizeof(rec);
+	memcpy(gui->deferred->str + start, &rec, sizeof(rec));
+
+	gui->deferred_count++;
+	deferred_remove_old_lines(gui);
+
+	if (beep && settings_get_bool("bell_beeps"))
+		signal_emit("beep", 0);
+	signal_stop();
+}
+
+void gui_printtext_flush_deferred(WINDOW_REC *window)
+{
+	GUI_WINDOW_REC *gui;
+	DEFERRED_LINE_REC rec;
+	TEXT_DEST_REC dest;
+	GString *deferred;
+	gsize pos;
+
+	g_return_if_fail(window != NULL);
+
+	gui = WINDOW_GUI(window);
+	if (gui->deferred == NULL)
+		return;
+
+	deferred = gui->deferred;
+	gui->deferred = NULL;
+	gui->deferred_count = 0;
+
+	for (pos = 0; pos < deferred->len; pos += rec.len) {
+		memcpy(&rec, deferred->str + pos, sizeof(rec));
+		pos += sizeof(rec);
+
+		format_create_dest(&dest, NULL, NULL, rec.level, window);
+		deferred_line_time = rec.time;
+		format_send_to_gui(&dest, deferred->str + pos);
+		signal_emit("gui print text finished", 1, window);
+	}
+	deferred_line_time = 0;
+
+	g_string_free(deferred, TRUE);
+}
+
+void gui_printtext_clear_deferred(WINDOW_REC *window)
+{
+	GUI_WINDOW_REC *gui;
+
+	g_return_if_fail(window != NULL);
+
+	gui = WINDOW_GUI(window);
+	if (gui->deferred != NULL) {
+		g_string_free(gui->deferred, TRUE);
+		gui->deferred = NULL;
+		gui->deferred_count = 0;
+	}
 }
 
 static void read_settings(void)
 {
+	GSList *tmp;
+
 	scrollback_lines = settings_get_int("scrollback_lines");
 	scrollback_time = settings_get_time("scrollback_time")/1000;
         scrollback_burst_remove = settings_get_int("scrollback_burst_remove");
+	scrollback_max_size = settings_get_size("scrollback_max_size");
+	scrollback_disk_overflow = settings_get_bool("scrollback_disk_overflow");
+
+	if (scrollback_lazy_render &&
+	    !settings_get_bool("scrollback_lazy_render")) {
+		/* keep the lines in order */
+		for (tmp = windows; tmp != NULL; tmp = tmp->next)
+			gui_printtext_flush_deferred(tmp->data);
+	}
+	scrollback_lazy_render = settings_get_bool("scrollback_lazy_render");
 }
 
 void gui_printtext_init(void)
@@ -248,7 +489,14 @@ void gui_printtext_init(void)
 	settings_add_int("history", "scrollback_lines", 500);
 	settings_add_time("history", "scrollback_time", "1day");
 	settings_add_int("history", "scrollback_burst_remove", 10);
+	settings_add_bool("history", "scrollback_lazy_render", FALSE);
+	settings_add_size("history", "scrollback_max_size", "0");
+	settings_add_bool("history", "scrollback_disk_overflow", FALSE);
+
+	scrollback_lazy_render = FALSE;
+	deferred_line_time = 0;
 
+	signal_add("gui print line", (SIGNAL_FUNC) sig_gui_print_line);
 	signal_add("gui print text", (SIGNAL_FUNC) sig_gui_print_text);
 	signal_add("gui print text finished", (SIGNAL_FUNC) sig_gui_printtext_finished);
 	signal_add("setup changed", (SIGNAL_FUNC) read_settings);
@@ -260,6 +508,7 @@ void gui_printtext_deinit(void)
 {
 	g_hash_table_destroy(indent_functions);
 
+	signal_remove("gui print line", (SIGNAL_FUNC) sig_gui_print_line);
 	signal_remove("gui print text", (SIGNAL_FUNC) sig_gui_print_text);
 	signal_remove("gui print text finished", (SIGNAL_FUNC) sig_gui_printtext_finished);
 	signal_remove("setup changed", (SIGNAL_FUNC) read_settings);
@@ -19,4 +19,9 @@ INDENT_FUNC get_default_indent_func(void);
 void gui_printtext(int xpos, int ypos, const char *str);
 void gui_printtext_after(TEXT_DEST_REC *dest, LINE_REC *prev, const char *str);
 
+/* Add the lines printed while window was hidden to its view */
+void gui_printtext_flush_deferred(WINDOW_REC *window);
+/* Forget the lines printed while window was hidden */
+void gui_printtext_clear_deferred(WINDOW_REC *window);
+
 #endif
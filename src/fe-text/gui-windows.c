@@ -41,6 +41,7 @@ static GUI_WINDOW_REC *gui_window_init(WINDOW_REC *window,
 
 	gui = g_new0(GUI_WINDOW_REC, 1);
 	gui->parent = parent;
+	gui->last_viewed = time(NULL);
 	gui->view = textbuffer_view_create(textbuffer_create(),
 					   window->width, window->height,
 					   settings_get_bool("scroll"),
@@ -56,6 +57,8 @@ static GUI_WINDOW_REC *gui_window_init(WINDOW_REC *window,
 
 static void gui_window_deinit(GUI_WINDOW_REC *gui)
 {
+	if (gui->deferred != NULL)
+		g_string_free(gui->deferred, TRUE);
         textbuffer_view_destroy(gui->view);
 	g_free(gui);
 }
@@ -137,9 +140,25 @@ void gui_window_resize(WINDOW_REC *window, int width, int height)
 
 void gui_window_scroll(WINDOW_REC *window, int lines)
 {
+	TEXT_BUFFER_VIEW_REC *view;
+	LINE_REC *line;
+	int count;
+
 	g_return_if_fail(window != NULL);
 
-        textbuffer_view_scroll(WINDOW_GUI(window)->view, lines);
+	view = WINDOW_GUI(window)->view;
+	if (lines < 0 && view->buffer->disk_lines > 0) {
+		/* scrolling past the beginning of the buffer, get the
+		   older lines back from disk */
+		count = 0;
+		for (line = view->startline; line != NULL && count < -lines;
+		     line = line->prev)
+			count++;
+		if (count < -lines)
+			textbuffer_disk_load(view->buffer, -lines - count);
+	}
+
+        textbuffer_view_scroll(view, lines);
 	signal_emit("gui page scrolled", 1, window);
 }
 
@@ -260,11 +279,14 @@ static void signal_window_changed(WINDOW_REC *window)
 	}
 
 	old_window = active_mainwin->active;
-	if (old_window != NULL && old_window != window)
+	if (old_window != NULL && old_window != window) {
+		WINDOW_GUI(old_window)->last_viewed = time(NULL);
 		textbuffer_view_set_window(WINDOW_GUI(old_window)->view, NULL);
+	}
 
 	active_mainwin->active = window;
 
+	gui_printtext_flush_deferred(window);
 	textbuffer_view_set_window(WINDOW_GUI(window)->view,
 				   active_mainwin->screen_win);
 	if (WINDOW_GUI(window)->view->dirty)
@@ -20,6 +20,13 @@ typedef struct {
 	unsigned int sticky:1;
 	unsigned int use_insert_after:1;
         LINE_REC *insert_after;
+
+	/* lines printed while the window was hidden, they're added to
+	   the view when it's shown */
+	GString *deferred;
+	int deferred_count;
+
+	time_t last_viewed; /* when the window was last visible */
 } GUI_WINDOW_REC;
 
 void gui_windows_init(void);
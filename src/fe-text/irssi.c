@@ -26,6 +26,7 @@
 #include "levels.h"
 #include "core.h"
 #include "settings.h"
+#include "misc.h"
 #include "session.h"
 
 #include "printtext.h"
@@ -76,8 +77,19 @@ void mainwindows_layout_deinit(void);
 void term_dummy_init(void);
 void term_dummy_deinit(void);
 
+/* never wait longer than this between frames, even when the terminal
+   isn't keeping up */
+#define FRAME_MAX_DELAY 500
+/* terminal is considered backed up when this many bytes are unread */
+#define FRAME_OUTQ_MAX 4096
+
 static int dirty, full_redraw, dummy;
 
+static int frame_time; /* minimum msecs between frames, 0 = no limit */
+static int frame_delay; /* current msecs between frames */
+static int frame_frozen, frame_input, frame_tag;
+static GTimeVal last_frame;
+
 static GMainLoop *main_loop;
 int quitting;
 
@@ -111,7 +123,7 @@ void irssi_set_dirty(void)
 
 static void dirty_check(void)
 {
-	if (!dirty || dummy)
+	if (!dirty || dummy || term_detached)
 		return;
 
         term_resize_dirty();
@@ -135,6 +147,100 @@ static void dirty_check(void)
         dirty = FALSE;
 }
 
+static int sig_frame_timeout(void)
+{
+	/* just wakes up the main loop */
+	frame_tag = -1;
+	return FALSE;
+}
+
+static void frame_wait(int msecs)
+{
+	if (frame_tag == -1) {
+		frame_tag = g_timeout_add(msecs <= 0 ? 1 : msecs,
+					  (GSourceFunc) sig_frame_timeout,
+					  NULL);
+	}
+}
+
+/* Returns TRUE if the screen should be redrawn now. Otherwise makes sure
+   that the main loop wakes up when the next frame is due. */
+static int frame_is_due(void)
+{
+	GTimeVal now;
+	long elapsed;
+
+	if (frame_time <= 0 || frame_input || quitting)
+		return TRUE;
+
+	g_get_current_time(&now);
+	elapsed = get_timeval_diff(&now, &last_frame);
+	if (elapsed < 0 || elapsed >= FRAME_MAX_DELAY)
+		return TRUE;
+
+	if (elapsed < frame_delay) {
+		frame_wait(frame_delay - elapsed);
+		return FALSE;
+	}
+
+	if (term_output_queued() >= FRAME_OUTQ_MAX) {
+		/* terminal hasn't read the previous frame yet, drawing
+		   more would just block us in write() */
+		frame_wait(frame_delay);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void frame_redraw(void)
+{
+	GTimeVal start;
+	long drawtime;
+
+	g_get_current_time(&start);
+
+	if (frame_frozen) {
+		term_refresh_thaw();
+		frame_frozen = FALSE;
+	}
+	dirty_check();
+
+	g_get_current_time(&last_frame);
+	frame_input = FALSE;
+
+	if (frame_tag != -1) {
+		g_source_remove(frame_tag);
+		frame_tag = -1;
+	}
+
+	/* the frame should take at most half of the frame time, if it
+	   took more give the rest of irssi the same time before the
+	   next one */
+	drawtime = get_timeval_diff(&last_frame, &start);
+	if (frame_time <= 0 || drawtime * 2 <= frame_time)
+		frame_delay = frame_time;
+	else
+		frame_delay = drawtime * 2 > FRAME_MAX_DELAY ?
+			FRAME_MAX_DELAY : drawtime * 2;
+}
+
+static void sig_gui_key_pressed(void)
+{
+	/* draw keyboard input without waiting for the next frame */
+	frame_input = TRUE;
+}
+
+static void read_settings(void)
+{
+	int fps;
+
+	fps = settings_get_int("redraw_max_fps");
+	frame_time = fps <= 0 ? 0 : 1000 / fps;
+	if (frame_delay < frame_time)
+		frame_delay = frame_time;
+}
+
 static void textui_init(void)
 {
 #ifdef SIGTRAP
@@ -152,8 +258,16 @@ static void textui_init(void)
 	fe_common_core_init();
 	fe_common_irc_init();
 
+	frame_frozen = frame_input = FALSE;
+	frame_tag = -1;
+	g_get_current_time(&last_frame);
+	settings_add_int("lookandfeel", "redraw_max_fps", 30);
+	read_settings();
+
 	theme_register(gui_text_formats);
 	signal_add_last("gui exit", (SIGNAL_FUNC) sig_exit);
+	signal_add("gui key pressed", (SIGNAL_FUNC) sig_gui_key_pressed);
+	signal_add("setup changed", (SIGNAL_FUNC) read_settings);
 }
 
 static void textui_finish_init(void)
@@ -215,6 +329,8 @@ static void textui_deinit(void)
 
         dirty_check(); /* one last time to print any quit messages */
 	signal_remove("gui exit", (SIGNAL_FUNC) sig_exit);
+	signal_remove("gui key pressed", (SIGNAL_FUNC) sig_gui_key_pressed);
+	signal_remove("setup changed", (SIGNAL_FUNC) read_settings);
 
 	if (dummy)
 		term_dummy_deinit();
@@ -347,14 +463,18 @@ int main(int argc, char **argv)
 	main_loop = g_main_new(TRUE);
 
 	/* Does the same as g_main_run(main_loop), except we
-	   can call our dirty-checker after each iteration */
+	   can call our dirty-checker after each iteration. The screen
+	   stays frozen over several iterations until the next frame
+	   is due, so bursts of text get drawn only once. */
 	while (!quitting) {
 #ifdef USE_GC
 		GC_collect_a_little();
 #endif
-		if (!dummy) term_refresh_freeze();
+		if (!dummy && !frame_frozen) {
+			term_refresh_freeze();
+			frame_frozen = TRUE;
+		}
 		g_main_iteration(TRUE);
-                if (!dummy) term_refresh_thaw();
 
 		if (reload_config) {
                         /* SIGHUP received, do /RELOAD */
@@ -362,7 +482,8 @@ int main(int argc, char **argv)
                         signal_emit("command reload", 1, "");
 		}
 
-		dirty_check();
+		if (frame_is_due())
+			frame_redraw();
 	}
 
 	g_main_destroy(main_loop);
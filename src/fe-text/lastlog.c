@@ -34,6 +34,7 @@
 #define DEFAULT_LASTLOG_BEFORE 3
 #define DEFAULT_LASTLOG_AFTER 3
 #define MAX_LINES_WITHOUT_FORCE 1000
+#define LASTLOG_DISK_LINES 1000
 
 /* Only unknown keys in `optlist' should be levels.
    Returns -1 if unknown option was given. */
@@ -74,15 +75,58 @@ int cmd_options_get_level(const char *cmd, GHashTable *optlist)
 	return retlevel;
 }
 
+/* Search the lines saved to disk. They're read in pieces to temporary
+   buffers, the ones with matches are added to `tmp_buffers' and must be
+   destroyed after the matches aren't needed anymore. */
+static GList *lastlog_find_disk(TEXT_BUFFER_REC *buffer, GSList **tmp_buffers,
+				int level, const char *searchtext,
+				int before, int after,
+				int regexp, int fullword, int case_sensitive)
+{
+	TEXT_BUFFER_REC *tmpbuf;
+	GList *matches, *list;
+	off_t pos;
+
+	matches = NULL; pos = 0;
+	while ((tmpbuf = textbuffer_disk_read(buffer, &pos,
+					      LASTLOG_DISK_LINES)) != NULL) {
+		list = textbuffer_find_text(tmpbuf, NULL, level,
+					    MSGLEVEL_LASTLOG, searchtext,
+					    before, after, regexp,
+					    fullword, case_sensitive);
+		if (list == NULL) {
+			textbuffer_destroy(tmpbuf);
+			continue;
+		}
+
+		*tmp_buffers = g_slist_prepend(*tmp_buffers, tmpbuf);
+		if (matches != NULL && (before > 0 || after > 0) &&
+		    g_list_last(matches)->data != NULL)
+			matches = g_list_append(matches, NULL);
+		matches = g_list_concat(matches, list);
+	}
+
+	return matches;
+}
+
+static void lastlog_free(GList *list, GSList *tmp_buffers)
+{
+	g_list_free(list);
+	g_slist_foreach(tmp_buffers, (GFunc) textbuffer_destroy, NULL);
+	g_slist_free(tmp_buffers);
+}
+
 static void show_lastlog(const char *searchtext, GHashTable *optlist,
 			 int start, int count, FILE *fhandle)
 {
 	WINDOW_REC *window;
         LINE_REC *startline;
-	GList *list, *tmp;
+	TEXT_BUFFER_REC *buffer;
+	GList *list, *tmp, *disk_list;
+	GSList *tmp_buffers;
 	GString *line;
         char *str;
-	int level, before, after, len;
+	int level, before, after, len, regexp, fullword, case_sensitive;
 
         level = cmd_options_get_level("lastlog", optlist);
 	if (level == -1) return; /* error in options */
@@ -108,6 +152,8 @@ static void show_lastlog(const char *searchtext, GHashTable *optlist,
 		}
 	}
 
+	gui_printtext_flush_deferred(window);
+
 	if (g_hash_table_lookup(optlist, "new") != NULL)
 		startline = textbuffer_view_get_bookmark(WINDOW_GUI(window)->view, "lastlog_last_check");
 	else if (g_hash_table_lookup(optlist, "away") != NULL)
@@ -115,6 +161,15 @@ static void show_lastlog(const char *searchtext, GHashTable *optlist,
 	else
 		startline = NULL;
 
+	/* searching the whole buffer includes the lines on disk */
+	buffer = WINDOW_GUI(window)->view->buffer;
+	tmp_buffers = NULL;
+	disk_list = NULL;
+
+	regexp = g_hash_table_lookup(optlist, "regexp") != NULL;
+	fullword = g_hash_table_lookup(optlist, "word") != NULL;
+	case_sensitive = g_hash_table_lookup(optlist, "case") != NULL;
+
 	if (startline == NULL)
                 startline = textbuffer_view_get_lines(WINDOW_GUI(window)->view);
 
@@ -132,12 +187,23 @@ static void show_lastlog(const char *searchtext, GHashTable *optlist,
 			atoi(str) : DEFAULT_LASTLOG_AFTER;
 	}
 
-	list = textbuffer_find_text(WINDOW_GUI(window)->view->buffer, startline,
+	if (startline == buffer->first_line && buffer->disk_lines > 0) {
+		disk_list = lastlog_find_disk(buffer, &tmp_buffers, level,
+					      searchtext, before, after,
+					      regexp, fullword, case_sensitive);
+	}
+
+	list = textbuffer_find_text(buffer, startline,
 				    level, MSGLEVEL_LASTLOG,
 				    searchtext, before, after,
-				    g_hash_table_lookup(optlist, "regexp") != NULL,
-				    g_hash_table_lookup(optlist, "word") != NULL,
-				    g_hash_table_lookup(optlist, "case") != NULL);
+				    regexp, fullword, case_sensitive);
+
+	if (disk_list != NULL) {
+		if (list != NULL && (before > 0 || after > 0) &&
+		    g_list_last(disk_list)->data != NULL)
+			disk_list = g_list_append(disk_list, NULL);
+		list = g_list_concat(disk_list, list);
+	}
 
         len = g_list_length(list);
 	if (count <= 0)
@@ -153,7 +219,7 @@ static void show_lastlog(const char *searchtext, GHashTable *optlist,
 	if (g_hash_table_lookup(optlist, "count") != NULL) {
 		printformat_window(active_win, MSGLEVEL_CLIENTNOTICE,
 				   TXT_LASTLOG_COUNT, len);
-		g_list_free(list);
+		lastlog_free(list, tmp_buffers);
 		return;
 	}
 
@@ -162,7 +228,7 @@ static void show_lastlog(const char *searchtext, GHashTable *optlist,
 		printformat_window(active_win,
 				   MSGLEVEL_CLIENTNOTICE|MSGLEVEL_LASTLOG,
 				   TXT_LASTLOG_TOO_LONG, len);
-		g_list_free(list);
+		lastlog_free(list, tmp_buffers);
 		return;
 	}
 
@@ -219,7 +285,7 @@ static void show_lastlog(const char *searchtext, GHashTable *optlist,
 	textbuffer_view_set_bookmark_bottom(WINDOW_GUI(window)->view,
 					    "lastlog_last_check");
 
-	g_list_free(list);
+	lastlog_free(list, tmp_buffers);
 }
 
 /* SYNTAX: LASTLOG [-] [-file <filename>] [-window <ref#|name>] [-new | -away]
@@ -319,7 +319,7 @@ static void statusbar_calc_item_positions(STATUSBAR_REC *bar)
 
 void statusbar_redraw(STATUSBAR_REC *bar, int force)
 {
-	if (statusbar_need_recreate_items)
+	if (statusbar_need_recreate_items || term_detached)
 		return; /* don't bother yet */
 
 	if (bar != NULL) {
@@ -342,6 +342,11 @@ void statusbar_item_redraw(SBAR_ITEM_REC *item)
 
 	g_return_if_fail(item != NULL);
 
+	if (term_detached) {
+		/* everything is redrawn when terminal is attached again */
+		return;
+	}
+
 	old_active_win = active_win;
         if (item->bar->parent_window != NULL)
 		active_win = item->bar->parent_window->active;
@@ -333,6 +333,11 @@ void term_addstr(TERM_WINDOW *window, const char *str)
         waddstr(window->win, (const char *) str);
 }
 
+void term_addstr_len(TERM_WINDOW *window, const char *str, int len)
+{
+        waddnstr(window->win, str, len);
+}
+
 void term_clrtoeol(TERM_WINDOW *window)
 {
         wclrtoeol(window->win);
@@ -359,6 +364,12 @@ void term_refresh_thaw(void)
 
 void term_refresh(TERM_WINDOW *window)
 {
+	if (term_detached)
+		return;
+
+	if (freeze_refresh == 0)
+		term_refresh_pending();
+
 	if (window != NULL)
 		wnoutrefresh(window->win);
 
@@ -459,6 +459,14 @@ void term_addstr(TERM_WINDOW *window, const char *str)
 	fwrite(str, 1, len, window->term->out);
 }
 
+void term_addstr_len(TERM_WINDOW *window, const char *str, int len)
+{
+	if (vcmove) term_move_real();
+        term_printed_text(len);
+
+	fwrite(str, 1, len, window->term->out);
+}
+
 void term_clrtoeol(TERM_WINDOW *window)
 {
 	/* clrtoeol() doesn't necessarily understand colors */
@@ -486,9 +494,11 @@ void term_move_cursor(int x, int y)
 
 void term_refresh(TERM_WINDOW *window)
 {
-	if (freeze_counter > 0)
+	if (freeze_counter > 0 || term_detached)
 		return;
 
+	term_refresh_pending();
+
 	term_move(root_window, curs_x, curs_y);
 	term_move_real();
 
@@ -38,10 +38,22 @@ int term_width, term_height;
 
 int term_use_colors;
 int term_type;
+int term_detached;
 
 static int force_colors;
 static int resize_dirty;
 
+static TERM_REFRESH_FUNC refresh_func;
+static int refresh_func_running;
+
+static char *detach_socket;
+static int detach_check_time, detach_check_tag, socket_attached;
+
+static const char *screen_dirs[] = {
+	"/run/screen", "/var/run/screen", "/tmp/screens", "/tmp/uscreens",
+	NULL
+};
+
 int term_get_size(int *width, int *height)
 {
 #ifdef TIOCGWINSZ
@@ -87,6 +99,110 @@ void term_resize_dirty(void)
 	}
 }
 
+void term_set_refresh_func(TERM_REFRESH_FUNC func)
+{
+	refresh_func = func;
+}
+
+/* called by term_refresh() when it's not frozen */
+void term_refresh_pending(void)
+{
+	/* the function may call term_refresh() itself */
+	if (refresh_func == NULL || refresh_func_running)
+		return;
+
+	refresh_func_running = TRUE;
+	refresh_func();
+	refresh_func_running = FALSE;
+}
+
+/* Returns the number of bytes written to the terminal that it hasn't
+   read yet, or 0 if it can't be found out. */
+int term_output_queued(void)
+{
+#ifdef TIOCOUTQ
+	int queued;
+
+	if (ioctl(1, TIOCOUTQ, &queued) < 0)
+		return 0;
+	return queued;
+#else
+	return 0;
+#endif
+}
+
+void term_set_detached(int detached)
+{
+	if (term_detached == detached)
+		return;
+
+	term_detached = detached;
+	if (!detached) {
+		/* the terminal may have been resized meanwhile */
+		resize_dirty = TRUE;
+		irssi_redraw();
+	}
+}
+
+/* Returns the socket of the screen or tmux session we're running in */
+static char *get_detach_socket(void)
+{
+	struct stat statbuf;
+	const char *env, *dir, *end;
+	char *path;
+	int i;
+
+	env = g_getenv("TMUX");
+	if (env != NULL && *env != '\0') {
+		/* <socket>,<server pid>,<session> */
+		end = strchr(env, ',');
+		return end == NULL ? g_strdup(env) :
+			g_strndup(env, (int) (end-env));
+	}
+
+	env = g_getenv("STY");
+	if (env == NULL || *env == '\0')
+		return NULL;
+
+	dir = g_getenv("SCREENDIR");
+	if (dir != NULL && *dir != '\0')
+		return g_strconcat(dir, "/", env, NULL);
+
+	for (i = 0; screen_dirs[i] != NULL; i++) {
+		path = g_strdup_printf("%s/S-%s/%s", screen_dirs[i],
+				       g_get_user_name(), env);
+		if (stat(path, &statbuf) == 0)
+			return path;
+		g_free(path);
+	}
+	return NULL;
+}
+
+static int sig_detach_check(void)
+{
+	struct stat statbuf;
+	int attached;
+
+	if (stat(detach_socket, &statbuf) != 0)
+		return 1;
+
+	/* both screen and tmux set the owner execute bit of
+	   their socket while a client is attached */
+	attached = (statbuf.st_mode & S_IXUSR) != 0;
+	if (attached != socket_attached) {
+		socket_attached = attached;
+		term_set_detached(!attached);
+	}
+	return 1;
+}
+
+static void sig_gui_key_pressed(void)
+{
+	/* someone is typing, so someone is also watching */
+	if (term_detached)
+		term_set_detached(FALSE);
+}
+
 #ifdef SIGWINCH
 static void sig_winch(int p)
 {
@@ -106,6 +222,17 @@ static void cmd_redraw(void)
 	irssi_redraw();
 }
 
+/* SYNTAX: RENDER ON|OFF */
+static void cmd_render(const char *data)
+{
+	if (g_ascii_strcasecmp(data, "ON") == 0)
+		term_set_detached(FALSE);
+	else if (g_ascii_strcasecmp(data, "OFF") == 0)
+		term_set_detached(TRUE);
+	else
+		cmd_return_error(CMDERR_NOT_ENOUGH_PARAMS);
+}
+
 static void read_settings(void)
 {
         const char *str;
@@ -135,6 +262,20 @@ static void read_settings(void)
 
 	if (term_use_colors != old_colors)
 		irssi_redraw();
+
+	if (detach_check_time != settings_get_time("term_detach_check")) {
+		detach_check_time = settings_get_time("term_detach_check");
+		if (detach_check_tag != -1) {
+			g_source_remove(detach_check_tag);
+			detach_check_tag = -1;
+		}
+		if (detach_check_time > 0 && detach_socket != NULL) {
+			detach_check_tag =
+				g_timeout_add(detach_check_time,
+					      (GSourceFunc) sig_detach_check,
+					      NULL);
+		}
+	}
 }
 
 void term_common_init(void)
@@ -146,6 +287,13 @@ void term_common_init(void)
 	settings_add_bool("lookandfeel", "colors", TRUE);
 	settings_add_bool("lookandfeel", "term_force_colors", FALSE);
         settings_add_bool("lookandfeel", "mirc_blink_fix", FALSE);
+	settings_add_time("lookandfeel", "term_detach_check", "5s");
+
+	term_detached = FALSE;
+	detach_socket = get_detach_socket();
+	detach_check_time = 0;
+	detach_check_tag = -1;
+	socket_attached = -1;
 
 	force_colors = FALSE;
 	term_use_colors = term_has_colors() && settings_get_bool("colors");
@@ -160,6 +308,10 @@ void term_common_init(void)
 	signal_add("setup changed", (SIGNAL_FUNC) read_settings);
 	command_bind("resize", NULL, (SIGNAL_FUNC) cmd_resize);
 	command_bind("redraw", NULL, (SIGNAL_FUNC) cmd_redraw);
+	command_bind("render", NULL, (SIGNAL_FUNC) cmd_render);
+	/* before the key is handled, so that a key running /RENDER OFF
+	   doesn't immediately turn rendering back on */
+	signal_add_first("gui key pressed", (SIGNAL_FUNC) sig_gui_key_pressed);
 
 #ifdef SIGWINCH
 	sigemptyset (&act.sa_mask);
@@ -173,6 +325,12 @@ void term_common_deinit(void)
 {
 	command_unbind("resize", (SIGNAL_FUNC) cmd_resize);
 	command_unbind("redraw", (SIGNAL_FUNC) cmd_redraw);
+	command_unbind("render", (SIGNAL_FUNC) cmd_render);
+	signal_remove("gui key pressed", (SIGNAL_FUNC) sig_gui_key_pressed);
 	signal_remove("beep", (SIGNAL_FUNC) term_beep);
 	signal_remove("setup changed", (SIGNAL_FUNC) read_settings);
+
+	if (detach_check_tag != -1)
+		g_source_remove(detach_check_tag);
+	g_free_and_null(detach_socket);
 }
@@ -25,6 +25,7 @@ typedef guint32 unichar;
 extern TERM_WINDOW *root_window;
 extern int term_width, term_height;
 extern int term_use_colors, term_type;
+extern int term_detached;
 
 /* Initialize / deinitialize terminal */
 int term_init(void);
@@ -69,6 +70,8 @@ void term_move(TERM_WINDOW *window, int x, int y);
 void term_addch(TERM_WINDOW *window, char chr);
 void term_add_unichar(TERM_WINDOW *window, unichar chr);
 void term_addstr(TERM_WINDOW *window, const char *str);
+/* Add len characters of single byte, single width text */
+void term_addstr_len(TERM_WINDOW *window, const char *str, int len);
 void term_clrtoeol(TERM_WINDOW *window);
 
 void term_move_cursor(int x, int y);
@@ -77,6 +80,18 @@ void term_refresh_freeze(void);
 void term_refresh_thaw(void);
 void term_refresh(TERM_WINDOW *window);
 
+/* Function that is called just before the screen is actually refreshed.
+   It can draw the changes that were postponed while frozen. */
+typedef void (*TERM_REFRESH_FUNC) (void);
+void term_set_refresh_func(TERM_REFRESH_FUNC func);
+
+/* Bytes of output still waiting to be read by the terminal */
+int term_output_queued(void);
+
+/* Stop drawing anything to terminal while nobody is watching it.
+   Everything gets redrawn once it's attached again. */
+void term_set_detached(int detached);
+
 void term_stop(void);
 
 /* keyboard input handling */
@@ -84,6 +99,7 @@ void term_set_input_type(int type);
 void term_gets(GArray *buffer, int *line_count);
 
 /* internal */
+void term_refresh_pending(void);
 void term_common_init(void);
 void term_common_deinit(void);
 
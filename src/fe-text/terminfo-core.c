@@ -170,7 +170,6 @@ static void _scroll_region(TERM_REC *term, int y1, int y2, int count)
         /* setup the scrolling region to wanted area */
         scroll_region_setup(term, y1, y2);
 
-	term->move(term, 0, y1);
 	if (count > 0) {
 		term->move(term, 0, y2);
 		tput(tparm(term->TI_indn, count, count));
@@ -26,9 +26,12 @@
 #include "levels.h"
 #include "settings.h"
 #include "servers.h"
+#include "session.h"
+#include "lib-config/iconfig.h"
 
 #include "printtext.h"
 #include "gui-windows.h"
+#include "gui-printtext.h"
 
 /* SYNTAX: CLEAR [-all] [<refnum>] */
 static void cmd_clear(const char *data)
@@ -48,13 +51,16 @@ static void cmd_clear(const char *data)
 		/* clear all windows */
 		for (tmp = windows; tmp != NULL; tmp = tmp->next) {
 			window = tmp->data;
+			gui_printtext_flush_deferred(window);
 			textbuffer_view_clear(WINDOW_GUI(window)->view);
 		}
 	} else if (*refnum != '\0') {
 		/* clear specified window */
 		window = window_find_refnum(atoi(refnum));
-		if (window != NULL)
+		if (window != NULL) {
+			gui_printtext_flush_deferred(window);
 			textbuffer_view_clear(WINDOW_GUI(window)->view);
+		}
 	} else {
 		/* clear active window */
 		textbuffer_view_clear(WINDOW_GUI(active_win)->view);
@@ -113,13 +119,16 @@ static void cmd_scrollback_clear(const char *data)
 		/* clear all windows */
 		for (tmp = windows; tmp != NULL; tmp = tmp->next) {
 			window = tmp->data;
+			gui_printtext_clear_deferred(window);
 			textbuffer_view_remove_all_lines(WINDOW_GUI(window)->view);
 		}
 	} else if (*refnum != '\0') {
 		/* clear specified window */
 		window = window_find_refnum(atoi(refnum));
-		if (window != NULL)
+		if (window != NULL) {
+			gui_printtext_clear_deferred(window);
 			textbuffer_view_remove_all_lines(WINDOW_GUI(window)->view);
+		}
 	} else {
 		/* clear active window */
 		textbuffer_view_remove_all_lines(WINDOW_GUI(active_win)->view);
@@ -156,13 +165,16 @@ static void cmd_scrollback_levelclear(const char *data)
 		/* clear all windows */
 		for (tmp = windows; tmp != NULL; tmp = tmp->next) {
 			window = tmp->data;
+			gui_printtext_flush_deferred(window);
 			textbuffer_view_remove_lines_by_level(WINDOW_GUI(window)->view, level);
 		}
 	} else if (*refnum != '\0') {
 		/* clear specified window */
 		window = window_find_refnum(atoi(refnum));
-		if (window != NULL)
+		if (window != NULL) {
+			gui_printtext_flush_deferred(window);
 			textbuffer_view_remove_lines_by_level(WINDOW_GUI(window)->view, level);
+		}
 	} else {
 		/* clear active window */
 		textbuffer_view_remove_lines_by_level(WINDOW_GUI(active_win)->view, level);
@@ -176,6 +188,16 @@ static void scrollback_goto_line(int linenum)
         TEXT_BUFFER_VIEW_REC *view;
 
 	view = WINDOW_GUI(active_win)->view;
+
+	/* the lines on disk come first */
+	if (linenum < view->buffer->disk_lines) {
+		textbuffer_disk_load(view->buffer,
+				     view->buffer->disk_lines - linenum);
+	}
+	linenum -= view->buffer->disk_lines;
+	if (linenum < 0)
+		linenum = 0;
+
 	if (view->buffer->lines_count == 0)
 		return;
 
@@ -185,6 +207,7 @@ static void scrollback_goto_line(int linenum)
 
 static void scrollback_goto_time(const char *datearg, const char *timearg)
 {
+        TEXT_BUFFER_VIEW_REC *view;
         LINE_REC *line;
 	struct tm tm;
 	time_t now, stamp;
@@ -249,14 +272,20 @@ static void scrollback_goto_time(const char *datearg, const char *timearg)
 		return;
 	}
 
-	/* scroll to first line after timestamp */
-	line = textbuffer_view_get_lines(WINDOW_GUI(active_win)->view);
-	for (; line != NULL; line = line->next) {
-		if (line->info.time >= stamp) {
-			gui_window_scroll_line(active_win, line);
+	/* get the older lines back from disk until we have the
+	   timestamp in memory */
+	view = WINDOW_GUI(active_win)->view;
+	while (view->buffer->disk_lines > 0 &&
+	       (view->buffer->first_line == NULL ||
+		view->buffer->first_line->info.time > stamp)) {
+		if (textbuffer_disk_load(view->buffer, 100) == 0)
 			break;
-		}
 	}
+
+	/* scroll to first line after timestamp */
+	line = textbuffer_find_time(view->buffer, stamp);
+	if (line != NULL)
+		gui_window_scroll_line(active_win, line);
 }
 
 /* SYNTAX: SCROLLBACK GOTO <+|-linecount>|<linenum>|<timestamp> */
@@ -322,10 +351,7 @@ static void cmd_scrollback_status(void)
 
 		view = WINDOW_GUI(window)->view;
 
-		window_mem = sizeof(TEXT_BUFFER_REC);
-		window_mem += g_slist_length(view->buffer->text_chunks) *
-			sizeof(TEXT_CHUNK_REC);
-		window_mem += view->buffer->lines_count * sizeof(LINE_REC);
+		window_mem = textbuffer_get_size(view->buffer);
 		total_lines += view->buffer->lines_count;
                 total_mem += window_mem;
 		printtext(NULL, NULL, MSGLEVEL_CLIENTCRAP,
@@ -339,6 +365,44 @@ static void cmd_scrollback_status(void)
 		  total_lines, (int)(total_mem / 1024));
 }
 
+/* SYNTAX: SCROLLBACK STATS */
+static void cmd_scrollback_stats(void)
+{
+	GSList *tmp;
+	time_t now;
+	int max_size;
+
+	now = time(NULL);
+	for (tmp = windows; tmp != NULL; tmp = tmp->next) {
+		WINDOW_REC *window = tmp->data;
+		GUI_WINDOW_REC *gui = WINDOW_GUI(window);
+		TEXT_BUFFER_REC *buffer = gui->view->buffer;
+		char *viewed;
+
+		viewed = gui->view->window != NULL ? g_strdup("visible") :
+			g_strdup_printf("not viewed for %ds",
+					(int) (now - gui->last_viewed));
+		printtext(NULL, NULL, MSGLEVEL_CLIENTCRAP,
+			  "Window %d: %d lines, %d bytes in %d chunks "
+			  "(%d%% used), %d lines deferred, "
+			  "%d lines (%d bytes) on disk, %s",
+			  window->refnum, buffer->lines_count,
+			  (int) textbuffer_get_size(buffer),
+			  g_slist_length(buffer->text_chunks),
+			  buffer->chunks_size == 0 ? 100 :
+			  (int) (buffer->text_size * 100 / buffer->chunks_size),
+			  gui->deferred_count, buffer->disk_lines,
+			  (int) buffer->disk_size, viewed);
+		g_free(viewed);
+	}
+
+	max_size = settings_get_size("scrollback_max_size");
+	printtext(NULL, NULL, MSGLEVEL_CLIENTCRAP,
+		  "Total: %d bytes, limit %s",
+		  (int) textbuffer_get_total_size(),
+		  max_size <= 0 ? "none" : settings_get_str("scrollback_max_size"));
+}
+
 static void sig_away_changed(SERVER_REC *server)
 {
 	GSList *tmp;
@@ -349,11 +413,151 @@ static void sig_away_changed(SERVER_REC *server)
 	for (tmp = windows; tmp != NULL; tmp = tmp->next) {
 		WINDOW_REC *rec = tmp->data;
 
+		gui_printtext_flush_deferred(rec);
                 textbuffer_view_set_bookmark_bottom(WINDOW_GUI(rec)->view,
 						    "lastlog_last_away");
 	}
 }
 
+static void session_save_window(WINDOW_REC *window,
+				SESSION_SNAPSHOT_REC *snapshot, GString *str)
+{
+	TEXT_BUFFER_REC *buffer;
+	LINE_REC *line;
+	GSList *tmp, *items;
+
+	session_snapshot_put_int(snapshot, window->refnum);
+	session_snapshot_put_str(snapshot, window->name);
+
+	items = NULL;
+	for (tmp = window->items; tmp != NULL; tmp = tmp->next) {
+		WI_ITEM_REC *item = tmp->data;
+
+		if (item->server != NULL)
+			items = g_slist_append(items, item);
+	}
+
+	session_snapshot_put_int(snapshot, g_slist_length(items));
+	for (tmp = items; tmp != NULL; tmp = tmp->next) {
+		WI_ITEM_REC *item = tmp->data;
+
+		session_snapshot_put_str(snapshot, item->server->tag);
+		session_snapshot_put_str(snapshot, item->visible_name);
+	}
+	g_slist_free(items);
+
+	gui_printtext_flush_deferred(window);
+	buffer = WINDOW_GUI(window)->view->buffer;
+	session_snapshot_put_int(snapshot, buffer->lines_count);
+	for (line = buffer->first_line; line != NULL; line = line->next) {
+		g_string_truncate(str, 0);
+		textbuffer_line_get_data(line, str);
+
+		session_snapshot_put_int(snapshot, line->info.level);
+		session_snapshot_put_int(snapshot, (int) line->info.time);
+		session_snapshot_put_data(snapshot, str->str, str->len);
+	}
+}
+
+/* save the scrollback of all windows to session snapshot */
+static void sig_session_save(CONFIG_REC *config, SESSION_SNAPSHOT_REC *snapshot)
+{
+	GSList *tmp;
+	GString *str;
+
+	if (snapshot == NULL)
+		return;
+
+	config_node_set_int(config, config->mainnode, "scrollback_offset",
+			    session_snapshot_offset(snapshot));
+	session_snapshot_put_int(snapshot, g_slist_length(windows));
+
+	str = g_string_new(NULL);
+	for (tmp = windows; tmp != NULL; tmp = tmp->next)
+		session_save_window(tmp->data, snapshot, str);
+	g_string_free(str, TRUE);
+}
+
+static int session_restore_window(SESSION_SNAPSHOT_REC *snapshot)
+{
+	WINDOW_REC *window;
+	TEXT_BUFFER_VIEW_REC *view;
+	LINE_INFO_REC info;
+	LINE_REC *line;
+	const char *name, *servertag;
+	const void *data;
+	int refnum, count, level, linetime, len, empty;
+
+	if (!session_snapshot_get_int(snapshot, &refnum) ||
+	    !session_snapshot_get_str(snapshot, &name) ||
+	    !session_snapshot_get_int(snapshot, &count))
+		return FALSE;
+
+	window = window_find_refnum(refnum);
+	if (window == NULL) {
+		window = window_create(NULL, FALSE);
+		window_set_refnum(window, refnum);
+	}
+	if (name != NULL && window->name == NULL)
+		window_set_name(window, name);
+
+	/* channels and queries are restored after us, bind them so they
+	   end up back in this window */
+	for (; count > 0; count--) {
+		if (!session_snapshot_get_str(snapshot, &servertag) ||
+		    !session_snapshot_get_str(snapshot, &name))
+			return FALSE;
+
+		if (servertag != NULL && name != NULL)
+			window_bind_add(window, servertag, name);
+	}
+
+	if (!session_snapshot_get_int(snapshot, &count))
+		return FALSE;
+
+	/* the restored lines go before anything that was already printed
+	   to the window */
+	view = WINDOW_GUI(window)->view;
+	empty = view->buffer->first_line == NULL;
+	line = NULL;
+	for (; count > 0; count--) {
+		if (!session_snapshot_get_int(snapshot, &level) ||
+		    !session_snapshot_get_int(snapshot, &linetime) ||
+		    !session_snapshot_get_data(snapshot, &data, &len))
+			return FALSE;
+
+		if (len < 2)
+			continue;
+
+		info.level = level;
+		info.time = (time_t) linetime;
+		line = textbuffer_insert(view->buffer, line, data, len, &info);
+		if (empty)
+			textbuffer_view_insert_line(view, line);
+	}
+
+	return TRUE;
+}
+
+static void sig_session_restore(CONFIG_REC *config,
+				SESSION_SNAPSHOT_REC *snapshot)
+{
+	int offset, count;
+
+	if (snapshot == NULL)
+		return;
+
+	offset = config_node_get_int(config->mainnode, "scrollback_offset", -1);
+	if (offset < 0 || !session_snapshot_seek(snapshot, offset) ||
+	    !session_snapshot_get_int(snapshot, &count))
+		return;
+
+	for (; count > 0; count--) {
+		if (!session_restore_window(snapshot))
+			break;
+	}
+}
+
 void textbuffer_commands_init(void)
 {
 	command_bind("clear", NULL, (SIGNAL_FUNC) cmd_clear);
@@ -365,12 +569,15 @@ void textbuffer_commands_init(void)
 	command_bind("scrollback home", NULL, (SIGNAL_FUNC) cmd_scrollback_home);
 	command_bind("scrollback end", NULL, (SIGNAL_FUNC) cmd_scrollback_end);
 	command_bind("scrollback status", NULL, (SIGNAL_FUNC) cmd_scrollback_status);
+	command_bind("scrollback stats", NULL, (SIGNAL_FUNC) cmd_scrollback_stats);
 
 	command_set_options("clear", "all");
 	command_set_options("scrollback clear", "all");
 	command_set_options("scrollback levelclear", "all -level");
 
 	signal_add("away mode changed", (SIGNAL_FUNC) sig_away_changed);
+	signal_add_first("session save", (SIGNAL_FUNC) sig_session_save);
+	signal_add_first("session restore", (SIGNAL_FUNC) sig_session_restore);
 }
 
 void textbuffer_commands_deinit(void)
@@ -384,6 +591,9 @@ void textbuffer_commands_deinit(void)
 	command_unbind("scrollback home", (SIGNAL_FUNC) cmd_scrollback_home);
 	command_unbind("scrollback end", (SIGNAL_FUNC) cmd_scrollback_end);
 	command_unbind("scrollback status", (SIGNAL_FUNC) cmd_scrollback_status);
+	command_unbind("scrollback stats", (SIGNAL_FUNC) cmd_scrollback_stats);
 
 	signal_remove("away mode changed", (SIGNAL_FUNC) sig_away_changed);
+	signal_remove("session save", (SIGNAL_FUNC) sig_session_save);
+	signal_remove("session restore", (SIGNAL_FUNC) sig_session_restore);
 }
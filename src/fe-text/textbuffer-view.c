@@ -148,7 +148,16 @@ static void update_cmd_color(unsigned char cmd, int *color)
 
 static inline unichar read_unichar(const unsigned char *data, const unsigned char **next, int *width)
 {
-	unichar chr = g_utf8_get_char_validated(data, -1);
+	unichar chr;
+
+	if (*data < 0x80) {
+		/* ASCII, no need to decode */
+		*next = data + 1;
+		*width = 1;
+		return *data;
+	}
+
+	chr = g_utf8_get_char_validated(data, -1);
 
 	if (chr & 0x80000000) {
 		chr = 0xfffd;
@@ -171,7 +180,7 @@ view_update_line_cache(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line)
         unsigned char cmd;
 	const unsigned char *ptr, *next_ptr, *last_space_ptr;
 	int xpos, pos, indent_pos, last_space, last_color, color, linecount;
-	int char_width;
+	int char_width, run;
 
 	g_return_val_if_fail(line->text != NULL, NULL);
 
@@ -209,6 +218,15 @@ view_update_line_cache(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line)
 			continue;
 		}
 
+		/* skip over a run of ASCII that still fits in this line,
+		   it contains no spaces so nothing else needs updating */
+		run = ascii_run_length(ptr, view->width - xpos);
+		if (run > 0) {
+			xpos += run;
+			ptr += run;
+			continue;
+		}
+
 		if (!view->utf8) {
 			/* MH */
 			if (term_type != TERM_TYPE_BIG5 ||
@@ -343,8 +361,10 @@ static int view_line_draw(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line,
 	unsigned char *tmp;
 	unichar chr;
 	int xpos, color, drawcount, first, need_move, need_clrtoeol, char_width;
+	int run;
 
-	if (view->dirty) /* don't bother drawing anything - redraw is coming */
+	/* don't bother drawing anything - redraw is coming */
+	if (view->dirty || term_detached)
                 return 0;
 
 	cache = textbuffer_view_get_line_cache(view, line);
@@ -430,6 +450,18 @@ static int view_line_draw(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line,
 			continue;
 		}
 
+		/* write a run of plain ASCII at once, up to the end of
+		   the screen line or the next subline */
+		run = ascii_run_length(text, term_width - xpos);
+		if (text_newline >= text && text_newline < text + run)
+			run = (int) (text_newline - text);
+		if (run > 0) {
+			term_addstr_len(view->window, (const char *) text, run);
+			xpos += run;
+			text += run;
+			continue;
+		}
+
 		if (view->utf8) {
 			chr = read_unichar(text, &end, &char_width);
 		} else {
@@ -645,7 +677,8 @@ static void view_draw(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line,
 {
 	int linecount;
 
-	if (view->dirty) /* don't bother drawing anything - redraw is coming */
+	/* don't bother drawing anything - redraw is coming */
+	if (view->dirty || term_detached)
                 return;
 
 	while (line != NULL && lines > 0) {
@@ -691,14 +724,45 @@ static void view_draw_bottom(TEXT_BUFFER_VIEW_REC *view, int lines)
         view_draw(view, line, subline, maxline, lines, TRUE);
 }
 
-/* Returns number of lines actually scrolled */
-static int view_scroll(TEXT_BUFFER_VIEW_REC *view, LINE_REC **lines,
-		       int *subline, int scrollcount, int draw_nonclean)
+/* Draw the lines that were added while screen refresh was frozen */
+static void view_flush(TEXT_BUFFER_VIEW_REC *view)
 {
-	int linecount, realcount, scroll_visible;
+	int scroll, rows;
 
-	if (*lines == NULL)
-                return 0;
+	if (view->pending_rows == 0)
+		return;
+
+	scroll = view->pending_scroll;
+	rows = view->pending_rows;
+	view->pending_scroll = view->pending_rows = 0;
+
+	if (view->window == NULL || view->dirty || term_detached)
+		return;
+
+	if (rows >= view->height) {
+		/* everything changed */
+		view_draw_top(view, view->height, TRUE);
+	} else {
+		if (scroll > 0) {
+			term_set_color(view->window, ATTR_RESET);
+			term_window_scroll(view->window, scroll);
+		}
+		view_draw_bottom(view, rows);
+	}
+	term_refresh(view->window);
+}
+
+static void views_flush(void)
+{
+	g_slist_foreach(views, (GFunc) view_flush, NULL);
+}
+
+/* Move `lines' and `subline', returns the number of lines moved,
+   negative if scrolled up. */
+static int view_scroll_lines(TEXT_BUFFER_VIEW_REC *view, LINE_REC **lines,
+			     int *subline, int scrollcount)
+{
+	int linecount, realcount, scroll_visible;
 
 	/* scroll down */
 	scroll_visible = lines == &view->startline;
@@ -746,7 +810,28 @@ static int view_scroll(TEXT_BUFFER_VIEW_REC *view, LINE_REC **lines,
 		}
 	}
 
-	if (scroll_visible && realcount != 0 && view->window != NULL) {
+	return realcount;
+}
+
+/* Returns number of lines actually scrolled */
+static int view_scroll(TEXT_BUFFER_VIEW_REC *view, LINE_REC **lines,
+		       int *subline, int scrollcount, int draw_nonclean)
+{
+	int realcount, scroll_visible;
+
+	if (*lines == NULL)
+                return 0;
+
+	scroll_visible = lines == &view->startline;
+	if (scroll_visible) {
+		/* the postponed drawing assumes the current position */
+		view_flush(view);
+	}
+
+	realcount = view_scroll_lines(view, lines, subline, scrollcount);
+
+	if (scroll_visible && realcount != 0 && view->window != NULL &&
+	    !term_detached) {
 		if (realcount <= -view->height || realcount >= view->height) {
 			/* scrolled more than screenful, redraw the
 			   whole view */
@@ -777,6 +862,9 @@ void textbuffer_view_resize(TEXT_BUFFER_VIEW_REC *view, int width, int height)
         g_return_if_fail(view != NULL);
         g_return_if_fail(width > 0);
 
+	/* the whole view gets redrawn after resize */
+	view->pending_scroll = view->pending_rows = 0;
+
 	if (view->width != width) {
                 /* line cache needs to be recreated */
 		textbuffer_cache_unref(view->cache);
@@ -907,6 +995,26 @@ LINE_CACHE_REC *textbuffer_view_get_line_cache(TEXT_BUFFER_VIEW_REC *view,
         return cache;
 }
 
+/* Scroll the view down when a new line was added at bottom. Drawing is
+   postponed until the screen is refreshed, so that lines added within
+   the same refresh get scrolled and drawn all at once. */
+static void view_insert_scroll(TEXT_BUFFER_VIEW_REC *view, int linecount)
+{
+	int realcount, rows;
+
+	realcount = view_scroll_lines(view, &view->startline,
+				      &view->subline, linecount);
+
+	/* the lines already waiting move up with the scroll, and the
+	   new line may take more rows than were scrolled */
+	rows = view->pending_rows + realcount;
+	if (rows < view->cache->last_linecount)
+		rows = view->cache->last_linecount;
+
+	view->pending_scroll += realcount;
+	view->pending_rows = rows < view->height ? rows : view->height;
+}
+
 static void view_insert_line(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line)
 {
 	int linecount, ypos, subline;
@@ -943,6 +1051,13 @@ static void view_insert_line(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line)
 	if (view->bottom) {
 		if (view->scroll && view->ypos >= view->height) {
 			linecount = view->ypos-view->height+1;
+			if (view->window != NULL && view->startline != NULL) {
+				view_insert_scroll(view, linecount);
+				view->ypos -= linecount;
+				term_refresh(view->window);
+				return;
+			}
+
 			view_scroll(view, &view->startline,
 				    &view->subline, linecount, FALSE);
 			view->ypos -= linecount;
@@ -951,6 +1066,7 @@ static void view_insert_line(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line)
 		}
 
 		if (view->window != NULL) {
+			view_flush(view);
 			ypos = view->ypos+1 - view->cache->last_linecount;
 			if (ypos >= 0)
 				subline = 0;
@@ -1159,18 +1275,15 @@ void textbuffer_view_remove_line(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line)
 
 void textbuffer_view_remove_lines_by_level(TEXT_BUFFER_VIEW_REC *view, int level)
 {
-	LINE_REC *line, *next;
-	
-	term_refresh_freeze();
-	line = textbuffer_view_get_lines(view);
+	GSList *lines, *tmp;
 
-	while (line != NULL) {
-		next = line->next;
+	term_refresh_freeze();
+	lines = textbuffer_find_level(view->buffer, level);
+	for (tmp = lines; tmp != NULL; tmp = tmp->next)
+		textbuffer_view_remove_line(view, tmp->data);
+	g_slist_free(lines);
 
-		if (line->info.level & level)
-			textbuffer_view_remove_line(view, line);
-		line = next;
-	}
+	textbuffer_forget_level(view->buffer, level);
 	textbuffer_view_redraw(view);
 	term_refresh_thaw();
 }
@@ -1196,6 +1309,20 @@ void textbuffer_view_remove_all_lines(TEXT_BUFFER_VIEW_REC *view)
 	g_slist_foreach(view->siblings, (GFunc) textbuffer_view_clear, NULL);
 }
 
+int textbuffer_view_compact(TEXT_BUFFER_VIEW_REC *view)
+{
+	g_return_val_if_fail(view != NULL, FALSE);
+
+	if (!textbuffer_compact(view->buffer))
+		return FALSE;
+
+	/* line caches point to the old texts */
+	view_reset_cache(view);
+	textbuffer_view_redraw(view);
+	g_slist_foreach(view->siblings, (GFunc) textbuffer_view_redraw, NULL);
+	return TRUE;
+}
+
 /* Set a bookmark in view */
 void textbuffer_view_set_bookmark(TEXT_BUFFER_VIEW_REC *view,
 				  const char *name, LINE_REC *line)
@@ -1248,6 +1375,7 @@ void textbuffer_view_set_window(TEXT_BUFFER_VIEW_REC *view,
 
 	if (view->window != window) {
 		view->window = window;
+		view->pending_scroll = view->pending_rows = 0;
                 if (window != NULL)
 			view->dirty = TRUE;
 	}
@@ -1258,8 +1386,9 @@ void textbuffer_view_redraw(TEXT_BUFFER_VIEW_REC *view)
 {
 	g_return_if_fail(view != NULL);
 
-	if (view->window != NULL) {
+	if (view->window != NULL && !term_detached) {
 		view->dirty = FALSE;
+		view->pending_scroll = view->pending_rows = 0;
 		view_draw_top(view, view->height, TRUE);
 		term_refresh(view->window);
 	}
@@ -1300,9 +1429,11 @@ static int sig_check_linecache(void)
 void textbuffer_view_init(void)
 {
 	linecache_tag = g_timeout_add(LINE_CACHE_CHECK_TIME, (GSourceFunc) sig_check_linecache, NULL);
+	term_set_refresh_func(views_flush);
 }
 
 void textbuffer_view_deinit(void)
 {
+	term_set_refresh_func(NULL);
 	g_source_remove(linecache_tag);
 }
@@ -70,6 +70,10 @@ struct _TEXT_BUFFER_VIEW_REC {
 	/* how many empty lines are in screen. a screenful when started
 	   or used /CLEAR */
 	int empty_linecount; 
+	/* lines were added while the screen refresh was frozen - window
+	   still needs to be scrolled pending_scroll rows and the bottom
+	   pending_rows rows redrawn */
+	int pending_scroll, pending_rows;
         /* window is at the bottom of the text buffer */
 	unsigned int bottom:1;
         /* if !bottom - new text has been printed since we were at bottom */
@@ -126,6 +130,8 @@ void textbuffer_view_insert_line(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line);
 void textbuffer_view_remove_line(TEXT_BUFFER_VIEW_REC *view, LINE_REC *line);
 /* Remove all lines from buffer. */
 void textbuffer_view_remove_all_lines(TEXT_BUFFER_VIEW_REC *view);
+/* Compact the memory used by buffer's text, returns TRUE if done */
+int textbuffer_view_compact(TEXT_BUFFER_VIEW_REC *view);
 void textbuffer_view_remove_lines_by_level(TEXT_BUFFER_VIEW_REC *view, int level);
 
 /* Set a bookmark in view */
@@ -26,17 +26,44 @@
 
 #include "textbuffer.h"
 
+#include <sys/stat.h>
+
 #ifdef HAVE_REGEX_H
 #  include <regex.h>
 #endif
 
-#define TEXT_CHUNK_USABLE_SIZE (LINE_TEXT_CHUNK_SIZE-2-(int)sizeof(char*))
+/* space needed after the text for the link to next chunk */
+#define TEXT_CHUNK_LINK_SIZE (2+(int)sizeof(char*))
+#define text_chunk_usable_size(chunk) ((chunk)->size - TEXT_CHUNK_LINK_SIZE)
+#define text_chunk_alloc_size(size) \
+	(G_STRUCT_OFFSET(TEXT_CHUNK_REC, buffer) + (size))
+
+/* header of a line in the disk file. the line data follows, and
+   then len again so the file can be read backwards */
+typedef struct {
+	gint32 len;
+	gint32 level;
+	gint64 time;
+} DISK_LINE_REC;
+
+#define disk_line_size(len) \
+	((off_t) sizeof(DISK_LINE_REC) + (len) + (off_t) sizeof(gint32))
+
+static size_t total_size;
+
+/* while compacting: how much text there is left to append after the
+   current textbuffer_insert(), otherwise -1 */
+static int compact_left = -1;
 
 TEXT_BUFFER_REC *textbuffer_create(void)
 {
 	TEXT_BUFFER_REC *buffer;
 
+	total_size += sizeof(TEXT_BUFFER_REC);
 	buffer = g_slice_new0(TEXT_BUFFER_REC);
+	buffer->disk_handle = -1;
+	buffer->index = g_array_new(FALSE, FALSE, sizeof(TEXT_INDEX_REC));
+	buffer->index_lines = TEXT_INDEX_LINES;
 	buffer->last_eol = TRUE;
 	buffer->last_fg = LINE_COLOR_DEFAULT;
 	buffer->last_bg = LINE_COLOR_DEFAULT | LINE_COLOR_BG;
@@ -48,7 +75,9 @@ void textbuffer_destroy(TEXT_BUFFER_REC *buffer)
 	g_return_if_fail(buffer != NULL);
 
 	textbuffer_remove_all_lines(buffer);
+	g_array_free(buffer->index, TRUE);
         g_slice_free(TEXT_BUFFER_REC, buffer);
+	total_size -= sizeof(TEXT_BUFFER_REC);
 }
 
 static TEXT_CHUNK_REC *text_chunk_find(TEXT_BUFFER_REC *buffer,
@@ -60,7 +89,7 @@ static TEXT_CHUNK_REC *text_chunk_find(TEXT_BUFFER_REC *buffer,
 		TEXT_CHUNK_REC *rec = tmp->data;
 
 		if (data >= rec->buffer &&
-		    data < rec->buffer+sizeof(rec->buffer))
+		    data < rec->buffer+rec->size)
                         return rec;
 	}
 
@@ -72,16 +101,34 @@ static TEXT_CHUNK_REC *text_chunk_find(TEXT_BUFFER_REC *buffer,
 	(chunk)->buffer[(chunk)->pos+1] = LINE_CMD_EOL; \
 	} G_STMT_END
 
-static TEXT_CHUNK_REC *text_chunk_create(TEXT_BUFFER_REC *buffer)
+/* Returns the size for a new chunk when `len' bytes of the current
+   text still need to be appended. */
+static int text_chunk_next_size(int len)
+{
+	int size;
+
+	if (compact_left < 0)
+		return LINE_TEXT_CHUNK_SIZE;
+
+	/* just enough to fit the rest of the compacted text */
+	size = len + compact_left + TEXT_CHUNK_LINK_SIZE + 1;
+	return size < LINE_TEXT_CHUNK_SIZE ? size : LINE_TEXT_CHUNK_SIZE;
+}
+
+static TEXT_CHUNK_REC *text_chunk_create(TEXT_BUFFER_REC *buffer, int size)
 {
 	TEXT_CHUNK_REC *rec;
 	unsigned char *buf, *ptr, **pptr;
 
-	rec = g_slice_new(TEXT_CHUNK_REC);
+	rec = g_slice_alloc(text_chunk_alloc_size(size));
 	rec->pos = 0;
 	rec->refcount = 0;
+	rec->size = size;
+
+	buffer->chunks_size += text_chunk_alloc_size(size);
+	total_size += text_chunk_alloc_size(size);
 
-	if (buffer->cur_line != NULL && buffer->cur_line->text != NULL) {
+	if (buffer->cur_text != NULL) {
 		/* create a link to new block from the old block */
 		buf = buffer->cur_text->buffer + buffer->cur_text->pos;
 		*buf++ = 0; *buf++ = (char) LINE_CMD_CONTINUE;
@@ -103,18 +150,26 @@ static TEXT_CHUNK_REC *text_chunk_create(TEXT_BUFFER_REC *buffer)
 	return rec;
 }
 
+static void text_chunk_free(TEXT_BUFFER_REC *buffer, TEXT_CHUNK_REC *chunk)
+{
+	buffer->chunks_size -= text_chunk_alloc_size(chunk->size);
+	total_size -= text_chunk_alloc_size(chunk->size);
+	g_slice_free1(text_chunk_alloc_size(chunk->size), chunk);
+}
+
 static void text_chunk_destroy(TEXT_BUFFER_REC *buffer, TEXT_CHUNK_REC *chunk)
 {
 	buffer->text_chunks = g_slist_remove(buffer->text_chunks, chunk);
-	g_slice_free(TEXT_CHUNK_REC, chunk);
+	text_chunk_free(buffer, chunk);
 }
 
 static void text_chunk_line_free(TEXT_BUFFER_REC *buffer, LINE_REC *line)
 {
 	TEXT_CHUNK_REC *chunk;
-	const unsigned char *text;
+	const unsigned char *text, *start;
         unsigned char cmd, *tmp = NULL;
 
+	start = line->text;
 	for (text = line->text;; text++) {
 		if (*text != '\0')
                         continue;
@@ -122,8 +177,12 @@ static void text_chunk_line_free(TEXT_BUFFER_REC *buffer, LINE_REC *line)
 		text++;
 		cmd = *text;
 		if (cmd == LINE_CMD_CONTINUE || cmd == LINE_CMD_EOL) {
-			if (cmd == LINE_CMD_CONTINUE)
+			if (cmd == LINE_CMD_CONTINUE) {
 				memcpy(&tmp, text+1, sizeof(char *));
+				buffer->text_size -= text-1 - start;
+			} else {
+				buffer->text_size -= text+1 - start;
+			}
 
 			/* free the previous block */
 			chunk = text_chunk_find(buffer, text);
@@ -138,6 +197,7 @@ static void text_chunk_line_free(TEXT_BUFFER_REC *buffer, LINE_REC *line)
 				break;
 
 			text = tmp-1;
+			start = tmp;
 		}
 	}
 }
@@ -151,16 +211,19 @@ static void text_chunk_append(TEXT_BUFFER_REC *buffer,
 	if (len == 0)
                 return;
 
+	buffer->text_size += len;
+
         chunk = buffer->cur_text;
-	while (chunk->pos + len >= TEXT_CHUNK_USABLE_SIZE) {
-		left = TEXT_CHUNK_USABLE_SIZE - chunk->pos;
+	while (chunk->pos + len >= text_chunk_usable_size(chunk)) {
+		left = text_chunk_usable_size(chunk) - chunk->pos;
 		if (left > 0 && data[left-1] == 0)
 			left--; /* don't split the commands */
 
 		memcpy(chunk->buffer + chunk->pos, data, left);
 		chunk->pos += left;
 
-		chunk = text_chunk_create(buffer);
+		chunk = text_chunk_create(buffer,
+					  text_chunk_next_size(len - left));
 		chunk->refcount++;
 		len -= left; data += left;
 	}
@@ -176,8 +239,9 @@ static LINE_REC *textbuffer_line_create(TEXT_BUFFER_REC *buffer)
 	LINE_REC *rec;
 
 	if (buffer->cur_text == NULL)
-                text_chunk_create(buffer);
+                text_chunk_create(buffer, LINE_TEXT_CHUNK_SIZE);
 
+	total_size += sizeof(LINE_REC);
 	rec = g_slice_new(LINE_REC);
 	rec->text = buffer->cur_text->buffer + buffer->cur_text->pos;
 
@@ -185,6 +249,106 @@ static LINE_REC *textbuffer_line_create(TEXT_BUFFER_REC *buffer)
         return rec;
 }
 
+#define index_entry(buffer, i) \
+	(&g_array_index((buffer)->index, TEXT_INDEX_REC, i))
+#define index_time(buffer, i) \
+	(index_entry(buffer, i)->line->info.time)
+
+/* Add a line to the end of the index */
+static void index_append_line(TEXT_BUFFER_REC *buffer, LINE_REC *line)
+{
+	TEXT_INDEX_REC rec, *last;
+
+	last = buffer->index->len == 0 ? NULL :
+		index_entry(buffer, buffer->index->len-1);
+
+	if (last != NULL && (buffer->index_lines < TEXT_INDEX_LINES ||
+			     line->info.time < last->line->info.time)) {
+		/* the time check keeps the index sorted even if the
+		   clock goes backwards */
+		last->level |= line->info.level;
+		buffer->index_lines++;
+		return;
+	}
+
+	rec.line = line;
+	rec.level = line->info.level;
+	g_array_append_val(buffer->index, rec);
+	buffer->index_lines = 1;
+}
+
+static void index_rebuild(TEXT_BUFFER_REC *buffer)
+{
+	LINE_REC *line;
+
+	g_array_set_size(buffer->index, 0);
+	buffer->index_lines = TEXT_INDEX_LINES;
+	buffer->index_dirty = FALSE;
+
+	for (line = buffer->first_line; line != NULL; line = line->next)
+		index_append_line(buffer, line);
+}
+
+/* Returns the first index entry with time >= stamp */
+static int index_find_time(TEXT_BUFFER_REC *buffer, time_t stamp)
+{
+	int left, right, mid;
+
+	left = 0; right = buffer->index->len;
+	while (left < right) {
+		mid = (left+right)/2;
+		if (index_time(buffer, mid) < stamp)
+			left = mid+1;
+		else
+			right = mid;
+	}
+	return left;
+}
+
+static void index_remove_line(TEXT_BUFFER_REC *buffer, LINE_REC *line)
+{
+	TEXT_INDEX_REC *rec;
+	LINE_REC *next_start;
+	int i, last;
+
+	last = buffer->index->len-1;
+	for (i = index_find_time(buffer, line->info.time); i <= last; i++) {
+		if (index_entry(buffer, i)->line == line ||
+		    index_time(buffer, i) != line->info.time)
+			break;
+	}
+
+	if (i > last || index_entry(buffer, i)->line != line) {
+		/* not the first line of a block */
+		if (line == buffer->cur_line)
+			buffer->index_lines--;
+		return;
+	}
+
+	rec = index_entry(buffer, i);
+	next_start = i == last ? NULL : index_entry(buffer, i+1)->line;
+	if (line->next != NULL && line->next != next_start &&
+	    line->next->info.time >= line->info.time &&
+	    (next_start == NULL ||
+	     line->next->info.time <= next_start->info.time)) {
+		/* next line starts the block now */
+		rec->line = line->next;
+		if (i == last)
+			buffer->index_lines--;
+	} else if (i > 0) {
+		/* join with the previous block */
+		index_entry(buffer, i-1)->level |= rec->level;
+		g_array_remove_index(buffer->index, i);
+		if (i == last)
+			buffer->index_lines = TEXT_INDEX_LINES;
+	} else {
+		/* the rest of the block is left unindexed */
+		g_array_remove_index(buffer->index, 0);
+		if (i == last)
+			buffer->index_lines = TEXT_INDEX_LINES;
+	}
+}
+
 static LINE_REC *textbuffer_line_insert(TEXT_BUFFER_REC *buffer,
 					LINE_REC *prev)
 {
@@ -287,6 +451,7 @@ LINE_REC *textbuffer_insert(TEXT_BUFFER_REC *buffer, LINE_REC *insert_after,
 			    LINE_INFO_REC *info)
 {
 	LINE_REC *line;
+	int at_end;
 
 	g_return_val_if_fail(buffer != NULL, NULL);
 	g_return_val_if_fail(data != NULL, NULL);
@@ -294,12 +459,21 @@ LINE_REC *textbuffer_insert(TEXT_BUFFER_REC *buffer, LINE_REC *insert_after,
 	if (len == 0)
                 return insert_after;
 
+	at_end = insert_after == buffer->cur_line;
 	line = !buffer->last_eol ? insert_after :
 		textbuffer_line_insert(buffer, insert_after);
 
 	if (info != NULL)
 		memcpy(&line->info, info, sizeof(line->info));
 
+	if (buffer->last_eol) {
+		/* new line, only appending keeps the index valid */
+		if (!at_end)
+			buffer->index_dirty = TRUE;
+		else if (!buffer->index_dirty)
+			index_append_line(buffer, line);
+	}
+
 	text_chunk_append(buffer, data, len);
 
 	buffer->last_eol = len >= 2 &&
@@ -319,6 +493,9 @@ void textbuffer_remove(TEXT_BUFFER_REC *buffer, LINE_REC *line)
 	g_return_if_fail(buffer != NULL);
 	g_return_if_fail(line != NULL);
 
+	if (!buffer->index_dirty && buffer->index->len > 0)
+		index_remove_line(buffer, line);
+
 	if (buffer->first_line == line)
 		buffer->first_line = line->next;
 	if (line->prev != NULL)
@@ -335,6 +512,7 @@ void textbuffer_remove(TEXT_BUFFER_REC *buffer, LINE_REC *line)
 	buffer->lines_count--;
         text_chunk_line_free(buffer, line);
 	g_slice_free(LINE_REC, line);
+	total_size -= sizeof(LINE_REC);
 }
 
 /* Removes all lines from buffer */
@@ -346,7 +524,7 @@ void textbuffer_remove_all_lines(TEXT_BUFFER_REC *buffer)
 	g_return_if_fail(buffer != NULL);
 
 	for (tmp = buffer->text_chunks; tmp != NULL; tmp = tmp->next)
-                g_slice_free(TEXT_CHUNK_REC, tmp->data);
+                text_chunk_free(buffer, tmp->data);
 	g_slist_free(buffer->text_chunks);
 	buffer->text_chunks = NULL;
 
@@ -355,7 +533,20 @@ void textbuffer_remove_all_lines(TEXT_BUFFER_REC *buffer)
 		g_slice_free(LINE_REC, buffer->first_line);
                 buffer->first_line = line;
 	}
+	total_size -= buffer->lines_count * sizeof(LINE_REC);
 	buffer->lines_count = 0;
+	buffer->text_size = 0;
+
+	if (buffer->disk_handle != -1) {
+		close(buffer->disk_handle);
+		buffer->disk_handle = -1;
+	}
+	buffer->disk_lines = 0;
+	buffer->disk_size = 0;
+
+	g_array_set_size(buffer->index, 0);
+	buffer->index_lines = TEXT_INDEX_LINES;
+	buffer->index_dirty = FALSE;
 
         buffer->cur_line = NULL;
         buffer->cur_text = NULL;
@@ -363,6 +554,326 @@ void textbuffer_remove_all_lines(TEXT_BUFFER_REC *buffer)
 	buffer->last_eol = TRUE;
 }
 
+int textbuffer_compact(TEXT_BUFFER_REC *buffer)
+{
+	GSList *old_chunks, *tmp;
+	GString *data;
+	GArray *offsets;
+	LINE_REC *line;
+	int i, pos, len;
+
+	g_return_val_if_fail(buffer != NULL, FALSE);
+
+	if (!buffer->last_eol || buffer->first_line == NULL)
+		return FALSE; /* line is still being added */
+
+	/* it's worth it only if at least a half chunk gets freed */
+	if (buffer->chunks_size < buffer->text_size +
+	    (buffer->text_size / LINE_TEXT_CHUNK_SIZE + 1) *
+	    text_chunk_alloc_size(TEXT_CHUNK_LINK_SIZE + 1) +
+	    LINE_TEXT_CHUNK_SIZE/2)
+		return FALSE;
+
+	/* get the texts out of the old chunks */
+	data = g_string_sized_new(buffer->text_size);
+	offsets = g_array_sized_new(FALSE, FALSE, sizeof(int),
+				    buffer->lines_count+1);
+	for (line = buffer->first_line; line != NULL; line = line->next) {
+		pos = data->len;
+		g_array_append_val(offsets, pos);
+		textbuffer_line_get_data(line, data);
+	}
+	pos = data->len;
+	g_array_append_val(offsets, pos);
+
+	old_chunks = buffer->text_chunks;
+	buffer->text_chunks = NULL;
+	buffer->cur_text = NULL;
+	buffer->text_size = 0;
+
+	/* and append them to new ones, the last one only as large as
+	   needed */
+	compact_left = data->len;
+	line = buffer->first_line;
+	for (i = 0; line != NULL; i++, line = line->next) {
+		pos = g_array_index(offsets, int, i);
+		len = g_array_index(offsets, int, i+1) - pos;
+		compact_left -= len;
+
+		if (buffer->cur_text == NULL) {
+			text_chunk_create(buffer,
+					  text_chunk_next_size(len));
+		}
+		line->text = buffer->cur_text->buffer + buffer->cur_text->pos;
+		buffer->cur_text->refcount++;
+
+		text_chunk_append(buffer,
+				  (const unsigned char *) data->str + pos, len);
+	}
+	compact_left = -1;
+
+	for (tmp = old_chunks; tmp != NULL; tmp = tmp->next)
+		text_chunk_free(buffer, tmp->data);
+	g_slist_free(old_chunks);
+
+	g_array_free(offsets, TRUE);
+	g_string_free(data, TRUE);
+	return TRUE;
+}
+
+static int disk_open(TEXT_BUFFER_REC *buffer)
+{
+	char *path;
+	mode_t old_umask;
+
+	path = g_strdup_printf("%s/scrollback.XXXXXX", get_irssi_dir());
+	old_umask = umask(0077);
+	buffer->disk_handle = mkstemp(path);
+	umask(old_umask);
+
+	/* nobody else needs to see it, and this way it goes away
+	   by itself when we exit. don't leak it to /EXEC children. */
+	if (buffer->disk_handle != -1) {
+		fcntl(buffer->disk_handle, F_SETFD, FD_CLOEXEC);
+		unlink(path);
+	}
+	g_free(path);
+	return buffer->disk_handle != -1;
+}
+
+/* Cut the file to disk_size. If that fails the file can't be trusted
+   anymore, so forget the lines in it and stop using it for this buffer. */
+static void disk_truncate(TEXT_BUFFER_REC *buffer)
+{
+	if (ftruncate(buffer->disk_handle, buffer->disk_size) == 0)
+		return;
+
+	close(buffer->disk_handle);
+	buffer->disk_handle = -1;
+	buffer->disk_lines = 0;
+	buffer->disk_size = 0;
+	buffer->disk_failed = TRUE;
+}
+
+static int disk_read(int handle, off_t pos, void *data, size_t size)
+{
+	return lseek(handle, pos, SEEK_SET) == pos &&
+		read(handle, data, size) == (ssize_t) size;
+}
+
+int textbuffer_disk_save_first(TEXT_BUFFER_REC *buffer)
+{
+	DISK_LINE_REC rec;
+	LINE_REC *line;
+	GString *data;
+	gint32 len;
+	int ret;
+
+	g_return_val_if_fail(buffer != NULL, FALSE);
+
+	line = buffer->first_line;
+	if (line == NULL || (line == buffer->cur_line && !buffer->last_eol))
+		return FALSE;
+
+	if (buffer->disk_failed ||
+	    (buffer->disk_handle == -1 && !disk_open(buffer)))
+		return FALSE;
+
+	/* write the whole line at once */
+	data = g_string_new(NULL);
+	g_string_set_size(data, sizeof(rec));
+	textbuffer_line_get_data(line, data);
+	len = data->len - sizeof(rec);
+	g_string_append_len(data, (const char *) &len, sizeof(len));
+
+	rec.len = len;
+	rec.level = line->info.level;
+	rec.time = line->info.time;
+	memcpy(data->str, &rec, sizeof(rec));
+
+	ret = lseek(buffer->disk_handle, buffer->disk_size, SEEK_SET) ==
+		buffer->disk_size &&
+		write(buffer->disk_handle, data->str, data->len) ==
+		(ssize_t) data->len;
+	g_string_free(data, TRUE);
+
+	if (!ret) {
+		/* don't leave a partial line behind */
+		disk_truncate(buffer);
+		return FALSE;
+	}
+
+	buffer->disk_size += disk_line_size(len);
+	buffer->disk_lines++;
+	return TRUE;
+}
+
+int textbuffer_disk_load(TEXT_BUFFER_REC *buffer, int count)
+{
+	DISK_LINE_REC rec;
+	LINE_INFO_REC info;
+	unsigned char *data;
+	gint32 len;
+	off_t pos;
+	int loaded;
+
+	g_return_val_if_fail(buffer != NULL, 0);
+
+	if (!buffer->last_eol)
+		return 0; /* line is still being added */
+
+	/* read the newest lines backwards and insert them at the
+	   beginning of the buffer, then cut them out of the file */
+	pos = buffer->disk_size;
+	for (loaded = 0; loaded < count && buffer->disk_lines > 0; loaded++) {
+		if (!disk_read(buffer->disk_handle, pos - sizeof(len),
+			       &len, sizeof(len)))
+			break;
+
+		pos -= disk_line_size(len);
+		if (!disk_read(buffer->disk_handle, pos, &rec, sizeof(rec)))
+			break;
+
+		data = g_malloc(len);
+		if (!disk_read(buffer->disk_handle, pos + sizeof(rec),
+			       data, len)) {
+			g_free(data);
+			break;
+		}
+
+		info.level = rec.level;
+		info.time = (time_t) rec.time;
+		textbuffer_insert(buffer, NULL, data, len, &info);
+		g_free(data);
+
+		buffer->disk_size = pos;
+		buffer->disk_lines--;
+	}
+
+	if (loaded > 0)
+		disk_truncate(buffer);
+	return loaded;
+}
+
+TEXT_BUFFER_REC *textbuffer_disk_read(TEXT_BUFFER_REC *buffer, off_t *pos,
+				      int count)
+{
+	TEXT_BUFFER_REC *dest;
+	DISK_LINE_REC rec;
+	LINE_INFO_REC info;
+	unsigned char *data;
+
+	g_return_val_if_fail(buffer != NULL, NULL);
+	g_return_val_if_fail(pos != NULL, NULL);
+
+	if (*pos >= buffer->disk_size)
+		return NULL;
+
+	dest = textbuffer_create();
+	while (count-- > 0 && *pos < buffer->disk_size) {
+		if (!disk_read(buffer->disk_handle, *pos, &rec, sizeof(rec)))
+			break;
+
+		data = g_malloc(rec.len);
+		if (!disk_read(buffer->disk_handle, *pos + sizeof(rec),
+			       data, rec.len)) {
+			g_free(data);
+			break;
+		}
+
+		info.level = rec.level;
+		info.time = (time_t) rec.time;
+		textbuffer_append(dest, data, rec.len, &info);
+		g_free(data);
+
+		*pos += disk_line_size(rec.len);
+	}
+
+	if (count >= 0) {
+		/* read error, don't try again */
+		*pos = buffer->disk_size;
+	}
+	return dest;
+}
+
+LINE_REC *textbuffer_find_time(TEXT_BUFFER_REC *buffer, time_t stamp)
+{
+	LINE_REC *line;
+	int i;
+
+	g_return_val_if_fail(buffer != NULL, NULL);
+
+	if (buffer->index_dirty)
+		index_rebuild(buffer);
+
+	/* start from the last block that begins before stamp */
+	i = index_find_time(buffer, stamp);
+	line = i == 0 ? buffer->first_line : index_entry(buffer, i-1)->line;
+
+	for (; line != NULL; line = line->next) {
+		if (line->info.time >= stamp)
+			return line;
+	}
+	return NULL;
+}
+
+GSList *textbuffer_find_level(TEXT_BUFFER_REC *buffer, int level)
+{
+	GSList *lines;
+	LINE_REC *line;
+	int i;
+
+	g_return_val_if_fail(buffer != NULL, NULL);
+
+	if (buffer->index_dirty)
+		index_rebuild(buffer);
+
+	lines = NULL; i = 0;
+	line = buffer->first_line;
+	while (line != NULL) {
+		if (i < buffer->index->len &&
+		    line == index_entry(buffer, i)->line) {
+			if ((index_entry(buffer, i)->level & level) == 0) {
+				/* nothing in this block */
+				i++;
+				line = i == buffer->index->len ? NULL :
+					index_entry(buffer, i)->line;
+				continue;
+			}
+			i++;
+		}
+
+		if (line->info.level & level)
+			lines = g_slist_prepend(lines, line);
+		line = line->next;
+	}
+
+	return g_slist_reverse(lines);
+}
+
+void textbuffer_forget_level(TEXT_BUFFER_REC *buffer, int level)
+{
+	int i;
+
+	g_return_if_fail(buffer != NULL);
+
+	for (i = 0; i < buffer->index->len; i++)
+		index_entry(buffer, i)->level &= ~level;
+}
+
+size_t textbuffer_get_size(TEXT_BUFFER_REC *buffer)
+{
+	g_return_val_if_fail(buffer != NULL, 0);
+
+	return sizeof(TEXT_BUFFER_REC) + buffer->chunks_size +
+		buffer->lines_count * sizeof(LINE_REC);
+}
+
+size_t textbuffer_get_total_size(void)
+{
+	return total_size;
+}
+
 static void set_color(GString *str, int cmd)
 {
 	int color = -1;
@@ -448,6 +959,37 @@ void textbuffer_line2text(LINE_REC *line, int coloring, GString *str)
 	}
 }
 
+void textbuffer_line_get_data(LINE_REC *line, GString *str)
+{
+        unsigned char cmd, *ptr, *tmp;
+
+	g_return_if_fail(line != NULL);
+	g_return_if_fail(str != NULL);
+
+	for (ptr = line->text;;) {
+		if (*ptr != 0) {
+			g_string_append_c(str, (char) *ptr);
+                        ptr++;
+			continue;
+		}
+
+		ptr++;
+                cmd = *ptr;
+		ptr++;
+
+		if (cmd == LINE_CMD_CONTINUE) {
+			memcpy(&tmp, ptr, sizeof(unsigned char *));
+			ptr = tmp;
+                        continue;
+		}
+
+		g_string_append_c(str, 0);
+		g_string_append_c(str, (char) cmd);
+		if (cmd == LINE_CMD_EOL)
+			break;
+	}
+}
+
 GList *textbuffer_find_text(TEXT_BUFFER_REC *buffer, LINE_REC *startline,
 			    int level, int nolevel, const char *text,
 			    int before, int after,
@@ -461,6 +1003,7 @@ GList *textbuffer_find_text(TEXT_BUFFER_REC *buffer, LINE_REC *startline,
 	GString *str;
         int i, match_after, line_matched;
 	char * (*match_func)(const char *, const char *);
+	int index_pos, index_len;
 
 	g_return_val_if_fail(buffer != NULL, NULL);
 	g_return_val_if_fail(text != NULL, NULL);
@@ -481,12 +1024,34 @@ GList *textbuffer_find_text(TEXT_BUFFER_REC *buffer, LINE_REC *startline,
 
 	line = startline != NULL ? startline : buffer->first_line;
 
+	/* the index can be used to skip blocks without matching levels
+	   when searching the whole buffer */
+	index_pos = index_len = 0;
+	if (line == buffer->first_line) {
+		if (buffer->index_dirty)
+			index_rebuild(buffer);
+		index_len = buffer->index->len;
+	}
+
 	if (fullword)
 		match_func = case_sensitive ? strstr_full : stristr_full;
 	else
 		match_func = case_sensitive ? strstr : stristr;
 
 	for (; line != NULL; line = line->next) {
+		if (index_pos < index_len &&
+		    line == index_entry(buffer, index_pos)->line) {
+			if (match_after == 0 &&
+			    (index_entry(buffer, index_pos)->level & level) == 0) {
+				/* nothing in this block */
+				if (++index_pos == index_len)
+					break;
+				line = index_entry(buffer, index_pos)->line->prev;
+				continue;
+			}
+			index_pos++;
+		}
+
 		line_matched = (line->info.level & level) != 0 &&
 			(line->info.level & nolevel) == 0;
 
@@ -5,6 +5,9 @@
    wastes a lot of memory. */
 #define LINE_TEXT_CHUNK_SIZE (16384 - 16)
 
+/* how many lines there are between time index entries */
+#define TEXT_INDEX_LINES 256
+
 #define LINE_COLOR_BG		0x20
 #define LINE_COLOR_DEFAULT	0x10
 
@@ -45,16 +48,39 @@ typedef struct _LINE_REC {
 } LINE_REC;
 
 typedef struct {
-	unsigned char buffer[LINE_TEXT_CHUNK_SIZE];
 	int pos;
 	int refcount;
+	int size; /* size of buffer, less than LINE_TEXT_CHUNK_SIZE
+		     only in compacted buffers */
+	unsigned char buffer[LINE_TEXT_CHUNK_SIZE];
 } TEXT_CHUNK_REC;
 
+typedef struct {
+	LINE_REC *line; /* first line of the block */
+	int level; /* levels of all the lines in the block */
+} TEXT_INDEX_REC;
+
 typedef struct {
 	GSList *text_chunks;
         LINE_REC *first_line;
         int lines_count;
 
+	size_t chunks_size; /* memory allocated for text_chunks */
+	size_t text_size; /* how much of it is used by the lines */
+
+	/* lines older than first_line, saved to disk when they were
+	   removed from the buffer */
+	int disk_handle;
+	int disk_lines;
+	off_t disk_size;
+	unsigned int disk_failed:1; /* file broke, don't use it anymore */
+
+	/* index of every TEXT_INDEX_LINES'th line, sorted by time. lines
+	   before the first entry aren't indexed. */
+	GArray *index;
+	int index_lines; /* lines in the last index block */
+	unsigned int index_dirty:1; /* index needs to be rebuilt */
+
 	LINE_REC *cur_line;
 	TEXT_CHUNK_REC *cur_text;
 
@@ -89,7 +115,38 @@ void textbuffer_remove(TEXT_BUFFER_REC *buffer, LINE_REC *line);
 /* Removes all lines from buffer, ignoring reference counters */
 void textbuffer_remove_all_lines(TEXT_BUFFER_REC *buffer);
 
+/* Move the texts of all lines to as few and as small text chunks as
+   possible. This changes the line->text pointers, so any line caches
+   must be reset. Returns FALSE if there was nothing to compact. */
+int textbuffer_compact(TEXT_BUFFER_REC *buffer);
+
+/* Save the first line of the buffer to disk, before removing it.
+   Returns FALSE if it couldn't be saved. */
+int textbuffer_disk_save_first(TEXT_BUFFER_REC *buffer);
+/* Move up to `count' of the newest lines on disk back to the beginning
+   of the buffer. Returns the number of lines loaded. */
+int textbuffer_disk_load(TEXT_BUFFER_REC *buffer, int count);
+/* Read up to `count' lines from disk starting at `*pos' to a new buffer,
+   and advance `*pos'. Returns NULL when there's nothing more to read. */
+TEXT_BUFFER_REC *textbuffer_disk_read(TEXT_BUFFER_REC *buffer, off_t *pos,
+				      int count);
+
+/* Returns the first line with time >= `stamp', or NULL */
+LINE_REC *textbuffer_find_time(TEXT_BUFFER_REC *buffer, time_t stamp);
+/* Returns a list of all the lines with one of the levels in `level' */
+GSList *textbuffer_find_level(TEXT_BUFFER_REC *buffer, int level);
+/* Tell the buffer that the lines with `level' have all been removed */
+void textbuffer_forget_level(TEXT_BUFFER_REC *buffer, int level);
+
+/* Returns the memory used by buffer */
+size_t textbuffer_get_size(TEXT_BUFFER_REC *buffer);
+/* Returns the memory used by all buffers */
+size_t textbuffer_get_total_size(void);
+
 void textbuffer_line2text(LINE_REC *line, int coloring, GString *str);
+/* Append the line's text and commands to `str' in the format taken by
+   textbuffer_append(), including the final EOL */
+void textbuffer_line_get_data(LINE_REC *line, GString *str);
 GList *textbuffer_find_text(TEXT_BUFFER_REC *buffer, LINE_REC *startline,
 			    int level, int nolevel, const char *text,
 			    int before, int after,
@@ -128,7 +128,7 @@ void ban_set(IRC_CHANNEL_REC *channel, const char *bans, int ban_type)
 void ban_remove(IRC_CHANNEL_REC *channel, const char *bans)
 {
 	GString *str;
-	GSList *tmp;
+	GList *tmp;
 	BAN_REC *rec;
 	char **ban, **banlist;
         int found;
@@ -152,13 +152,13 @@ void ban_remove(IRC_CHANNEL_REC *channel, const char *bans)
 			rec = NULL;
 			if (!g_strcasecmp(*ban, BAN_LAST)) {
 				/* unnbanning last set ban */
-				rec = g_slist_nth_data(channel->banlist,
-							g_slist_length(channel->banlist) - 1);
+				rec = channel->banlist_last == NULL ? NULL :
+					channel->banlist_last->data;
 			}
 			else if (is_numeric(*ban, '\0')) {
 				/* unbanning with ban# */
-				rec = g_slist_nth_data(channel->banlist,
-							atoi(*ban)-1);
+				rec = g_list_nth_data(channel->banlist,
+						      atoi(*ban)-1);
 			}
 			if (rec != NULL)
 				g_string_append_printf(str, "%s ", rec->ban);
@@ -28,10 +28,13 @@
 loop:
  - Wait for NAMES list from all channels before doing anything else..
  - After got the last NAMES list, start sending the queries ..
- - find the query to send, check where server->queries list isn't NULL
-   (mode, who, banlist, ban exceptions, invite list)
- - if not found anything -> all channels are synced
- - send "command #chan1,#chan2,#chan3,.." command to server
+ - each query type (mode, who, banlist) is sent independently of the
+   others, so several of them can be waiting for reply at the same time.
+   a query type is sent if it has channels in server->queries list and
+   it isn't already waiting for a reply. other than the first query, the
+   queries are sent only if they wouldn't trigger the flood protection.
+ - send "command #chan1,#chan2,#chan3,.." command to server. WHO uses
+   WHOX to ask only the fields we need if the server supports it.
  - wait for reply from server, then check if it was last query to be sent to
    channel. If it was, send "channel sync" signal
  - check if the reply was for last channel in the command list. If so,
@@ -60,9 +63,13 @@ enum {
 
 #define CHANNEL_IS_MODE_QUERY(a) ((a) != CHANNEL_QUERY_WHO)
 
+/* WHOX query type token, and the fields we want: query type, channel,
+   user, host, nick, flags, hops and realname */
+#define WHOX_QUERY_TOKEN "743"
+#define WHOX_QUERY_FIELDS "%tcuhnfdr," WHOX_QUERY_TOKEN
+
 typedef struct {
-	int current_query_type; /* query type that is currently being asked */
-        GSList *current_queries; /* All channels that are currently being queried */
+        GSList *current_queries[CHANNEL_QUERIES]; /* All channels that are currently being queried */
 
 	GSList *queries[CHANNEL_QUERIES]; /* All queries that need to be asked from server */
 } SERVER_QUERY_REC;
@@ -91,9 +98,10 @@ static void sig_disconnected(IRC_SERVER_REC *server)
 	rec = server->chanqueries;
 	g_return_if_fail(rec != NULL);
 
-	for (n = 0; n < CHANNEL_QUERIES; n++)
+	for (n = 0; n < CHANNEL_QUERIES; n++) {
 		g_slist_free(rec->queries[n]);
-        g_slist_free(rec->current_queries);
+		g_slist_free(rec->current_queries[n]);
+	}
 	g_free(rec);
 
         server->chanqueries = NULL;
@@ -121,9 +129,11 @@ static void query_remove_all(IRC_CHANNEL_REC *channel)
 	rec = channel->server->chanqueries;
 
 	/* remove channel from query lists */
-	for (n = 0; n < CHANNEL_QUERIES; n++)
+	for (n = 0; n < CHANNEL_QUERIES; n++) {
 		rec->queries[n] = g_slist_remove(rec->queries[n], channel);
-	rec->current_queries = g_slist_remove(rec->current_queries, channel);
+		rec->current_queries[n] =
+			g_slist_remove(rec->current_queries[n], channel);
+	}
 
 	query_check(channel->server);
 }
@@ -151,16 +161,16 @@ static int channels_have_all_names(IRC_SERVER_REC *server)
 	return 1;
 }
 
-static int query_find_next(SERVER_QUERY_REC *server)
+static int query_is_pending(SERVER_QUERY_REC *rec)
 {
 	int n;
 
 	for (n = 0; n < CHANNEL_QUERIES; n++) {
-		if (server->queries[n] != NULL)
-			return n;
+		if (rec->current_queries[n] != NULL)
+			return TRUE;
 	}
 
-	return -1;
+	return FALSE;
 }
 
 static void query_send(IRC_SERVER_REC *server, int query)
@@ -211,8 +221,7 @@ static void query_send(IRC_SERVER_REC *server, int query)
 		g_free(chanstr_spaces);
 	}
 
-	rec->current_query_type = query;
-        rec->current_queries = chans;
+        rec->current_queries[query] = chans;
 
 	switch (query) {
 	case CHANNEL_QUERY_MODE:
@@ -221,22 +230,29 @@ static void query_send(IRC_SERVER_REC *server, int query)
 		/* the stop-event is received once for each channel,
 		   and we want to print 329 event (channel created). */
 		server_redirect_event(server, "mode channel", count,
-				      chanstr, -1, "chanquery abort",
+				      chanstr, -1, "chanquery mode abort",
 				      "event 324", "chanquery mode",
                                       "event 329", "event 329",
-				      "", "chanquery abort", NULL);
+				      "", "chanquery mode abort", NULL);
 		break;
 
 	case CHANNEL_QUERY_WHO:
-		cmd = g_strdup_printf("WHO %s", chanstr_commas);
+		if (g_hash_table_lookup(server->isupport, "WHOX") != NULL) {
+			/* ask only for the fields we need */
+			cmd = g_strdup_printf("WHO %s " WHOX_QUERY_FIELDS,
+					      chanstr_commas);
+		} else {
+			cmd = g_strdup_printf("WHO %s", chanstr_commas);
+		}
 
 		server_redirect_event(server, "who",
 				      server->one_endofwho ? 1 : count,
 				      chanstr, -1,
-				      "chanquery abort",
+				      "chanquery who abort",
 				      "event 315", "chanquery who end",
 				      "event 352", "silent event who",
-				      "", "chanquery abort", NULL);
+				      "event 354", "silent event whox",
+				      "", "chanquery who abort", NULL);
 		break;
 
 	case CHANNEL_QUERY_BMODE:
@@ -246,10 +262,10 @@ static void query_send(IRC_SERVER_REC *server, int query)
 		   irssi could ask modes separately but afterwards
 		   join the two b/e/I modes together */
 		server_redirect_event(server, "mode b", count, chanstr, -1,
-				      "chanquery abort",
+				      "chanquery ban abort",
 				      "event 367", "chanquery ban",
 				      "event 368", "chanquery ban end",
-				      "", "chanquery abort", NULL);
+				      "", "chanquery ban abort", NULL);
 		break;
 
 	default:
@@ -271,8 +287,6 @@ static void query_check(IRC_SERVER_REC *server)
 	g_return_if_fail(server != NULL);
 
 	rec = server->chanqueries;
-	if (rec->current_queries != NULL)
-                return; /* old queries haven't been answered yet */
 
 	if (server->max_query_chans > 1 && !server->no_multi_who && !server->no_multi_mode && !channels_have_all_names(server)) {
 		/* all channels haven't sent /NAMES list yet */
@@ -281,19 +295,27 @@ static void query_check(IRC_SERVER_REC *server)
 		return;
 	}
 
-	query = query_find_next(rec);
-	if (query == -1) {
-		/* no queries left */
-		return;
-	}
+	for (query = 0; query < CHANNEL_QUERIES; query++) {
+		if (rec->queries[query] == NULL ||
+		    rec->current_queries[query] != NULL)
+			continue; /* nothing to send or waiting for reply */
 
-        query_send(server, query);
+		/* always keep at least one query going, but don't send
+		   more of them if it would make us hit the flood
+		   protection. */
+		if (query_is_pending(rec) &&
+		    server->cmdcount >= server->max_cmds_at_once)
+			break;
+
+		query_send(server, query);
+	}
 }
 
 /* if there's no more queries in queries in buffer, send the sync signal */
 static void channel_checksync(IRC_CHANNEL_REC *channel)
 {
 	SERVER_QUERY_REC *rec;
+	GTimeVal now;
 	int n;
 
 	g_return_if_fail(channel != NULL);
@@ -303,20 +325,24 @@ static void channel_checksync(IRC_CHANNEL_REC *channel)
 
 	rec = channel->server->chanqueries;
 	for (n = 0; n < CHANNEL_QUERIES; n++) {
-		if (g_slist_find(rec->queries[n], channel))
+		if (g_slist_find(rec->queries[n], channel) ||
+		    g_slist_find(rec->current_queries[n], channel))
 			return;
 	}
 
+	g_get_current_time(&now);
+	channel->sync_msecs = get_timeval_diff(&now, &channel->sync_start);
+
 	channel->synced = TRUE;
 	signal_emit("channel sync", 1, channel);
 }
 
 /* Error occured when trying to execute query - abort and try again. */
-static void query_current_error(IRC_SERVER_REC *server)
+static void query_current_error(IRC_SERVER_REC *server, int query)
 {
 	SERVER_QUERY_REC *rec;
-	GSList *tmp;
-        int query, abort_query;
+	GSList *tmp, *current;
+        int abort_query;
 
 	rec = server->chanqueries;
 
@@ -324,7 +350,6 @@ static void query_current_error(IRC_SERVER_REC *server)
 	   then all we can do is abort. */
         abort_query = FALSE;
 
-	query = rec->current_query_type;
 	if (query == CHANNEL_QUERY_WHO) {
 		if (server->no_multi_who)
 			abort_query = TRUE;
@@ -337,24 +362,39 @@ static void query_current_error(IRC_SERVER_REC *server)
 			server->no_multi_mode = TRUE;
 	}
 
+	current = rec->current_queries[query];
+	rec->current_queries[query] = NULL;
+
 	if (!abort_query) {
 		/* move all currently queried channels to main query lists */
-		for (tmp = rec->current_queries; tmp != NULL; tmp = tmp->next) {
+		for (tmp = current; tmp != NULL; tmp = tmp->next) {
 			rec->queries[query] =
 				g_slist_append(rec->queries[query], tmp->data);
 		}
 	} else {
 		/* check if failed channels are synced after this error */
-		g_slist_foreach(rec->current_queries,
-				(GFunc) channel_checksync, NULL);
+		g_slist_foreach(current, (GFunc) channel_checksync, NULL);
 	}
-
-	g_slist_free(rec->current_queries);
-	rec->current_queries = NULL;
+	g_slist_free(current);
 
         query_check(server);
 }
 
+static void query_mode_error(IRC_SERVER_REC *server)
+{
+	query_current_error(server, CHANNEL_QUERY_MODE);
+}
+
+static void query_who_error(IRC_SERVER_REC *server)
+{
+	query_current_error(server, CHANNEL_QUERY_WHO);
+}
+
+static void query_ban_error(IRC_SERVER_REC *server)
+{
+	query_current_error(server, CHANNEL_QUERY_BMODE);
+}
+
 static void sig_channel_joined(IRC_CHANNEL_REC *channel)
 {
 	if (!IS_IRC_CHANNEL(channel))
@@ -382,12 +422,12 @@ static void channel_got_query(IRC_CHANNEL_REC *chanrec, int query_type)
 	g_return_if_fail(chanrec != NULL);
 
 	rec = chanrec->server->chanqueries;
-	if (query_type != rec->current_query_type)
+	if (g_slist_find(rec->current_queries[query_type], chanrec) == NULL)
                 return; /* shouldn't happen */
 
         /* got the query for channel.. */
-	rec->current_queries =
-		g_slist_remove(rec->current_queries, chanrec);
+	rec->current_queries[query_type] =
+		g_slist_remove(rec->current_queries[query_type], chanrec);
 	channel_checksync(chanrec);
 
 	/* check if we need to send another query.. */
@@ -433,7 +473,7 @@ static void event_end_of_who(IRC_SERVER_REC *server, const char *data)
 
         failed = FALSE;
 	rec = server->chanqueries;
-	for (tmp = rec->current_queries; tmp != NULL; tmp = next) {
+	for (tmp = rec->current_queries[CHANNEL_QUERY_WHO]; tmp != NULL; tmp = next) {
 		IRC_CHANNEL_REC *chanrec = tmp->data;
 
                 next = tmp->next;
@@ -460,7 +500,7 @@ static void event_end_of_who(IRC_SERVER_REC *server, const char *data)
 	if (failed) {
 		/* server didn't understand multiple WHO replies,
 		   send them again separately */
-                query_current_error(server);
+                query_current_error(server, CHANNEL_QUERY_WHO);
 	}
 
         g_free(params);
@@ -496,7 +536,9 @@ void channels_query_init(void)
 	signal_add("chanquery who end", (SIGNAL_FUNC) event_end_of_who);
 
 	signal_add("chanquery ban end", (SIGNAL_FUNC) event_end_of_banlist);
-	signal_add("chanquery abort", (SIGNAL_FUNC) query_current_error);
+	signal_add("chanquery mode abort", (SIGNAL_FUNC) query_mode_error);
+	signal_add("chanquery who abort", (SIGNAL_FUNC) query_who_error);
+	signal_add("chanquery ban abort", (SIGNAL_FUNC) query_ban_error);
 }
 
 void channels_query_deinit(void)
@@ -510,5 +552,7 @@ void channels_query_deinit(void)
 	signal_remove("chanquery who end", (SIGNAL_FUNC) event_end_of_who);
 
 	signal_remove("chanquery ban end", (SIGNAL_FUNC) event_end_of_banlist);
-	signal_remove("chanquery abort", (SIGNAL_FUNC) query_current_error);
+	signal_remove("chanquery mode abort", (SIGNAL_FUNC) query_mode_error);
+	signal_remove("chanquery who abort", (SIGNAL_FUNC) query_who_error);
+	signal_remove("chanquery ban abort", (SIGNAL_FUNC) query_ban_error);
 }
@@ -54,6 +54,7 @@ IRC_CHANNEL_REC *irc_channel_create(IRC_SERVER_REC *server, const char *name,
 
 	rec = g_new0(IRC_CHANNEL_REC, 1);
 	if (*name == '+') rec->no_modes = TRUE;
+	g_get_current_time(&rec->sync_start);
 
 	channel_init((CHANNEL_REC *) rec, (SERVER_REC *) server,
 		     name, visible_name, automatic);
@@ -167,35 +168,13 @@ static void irc_channels_join(IRC_SERVER_REC *server, const char *data,
 	cmd_params_free(free_arg);
 }
 
-/* function for finding IRC channels - adds support for !channels */
-static CHANNEL_REC *irc_channel_find_server(SERVER_REC *server,
-					    const char *channel)
-{
-	GSList *tmp;
-
-	for (tmp = server->channels; tmp != NULL; tmp = tmp->next) {
-		CHANNEL_REC *rec = tmp->data;
-
-		if (rec->chat_type != server->chat_type)
-                        continue;
-
-		/* check both !ABCDEchannel and !channel */
-		if (IRC_SERVER(server)->nick_comp_func(channel, rec->name) == 0)
-			return rec;
-
-		if (IRC_SERVER(server)->nick_comp_func(channel, rec->visible_name) == 0)
-			return rec;
-	}
-
-	return NULL;
-}
-
 static void sig_server_connected(SERVER_REC *server)
 {
 	if (!IS_IRC_SERVER(server))
 		return;
 
-	server->channel_find_func = irc_channel_find_server;
+	/* the default channel_find() finds both !ABCDEchannel and
+	   !channel, since visible names are hashed too */
 	server->channels_join = (void (*) (SERVER_REC *, const char *, int))
 		irc_channels_join;
 }
@@ -210,8 +189,11 @@ static char *irc_get_join_data(CHANNEL_REC *channel)
 
 static void sig_channel_created(IRC_CHANNEL_REC *channel)
 {
-	if (IS_IRC_CHANNEL(channel))
+	if (IS_IRC_CHANNEL(channel)) {
                 channel->get_join_data = irc_get_join_data;
+		channel->get_mode = (char *(*)(CHANNEL_REC *))
+			channel_modes_render;
+	}
 }
 
 static void sig_channel_destroyed(IRC_CHANNEL_REC *channel)
@@ -224,6 +206,9 @@ static void sig_channel_destroyed(IRC_CHANNEL_REC *channel)
 		   having left the channel yet */
 		signal_emit("command part", 3, "", channel->server, channel);
 	}
+
+	g_slist_foreach(channel->modes.args, (GFunc) g_free, NULL);
+	g_slist_free(channel->modes.args);
 }
 
 void irc_channels_init(void)
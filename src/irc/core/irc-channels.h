@@ -11,15 +11,31 @@
 #define IS_IRC_CHANNEL(channel) \
 	(IRC_CHANNEL(channel) ? TRUE : FALSE)
 
+typedef struct {
+	guint32 bits[4]; /* one bit for each set mode character */
+	GSList *args; /* "<mode><argument>" strings of the set modes that
+			 have an argument, sorted by mode */
+	unsigned int args_changed:1;
+} IRC_CHANNEL_MODES_REC;
+
 #define STRUCT_SERVER_REC IRC_SERVER_REC
 struct _IRC_CHANNEL_REC {
 #include "channel-rec.h"
 
-	GSList *banlist; /* list of bans */
+	IRC_CHANNEL_MODES_REC modes; /* rendered to mode lazily */
+	GList *banlist; /* list of bans */
+	GList *ebanlist; /* list of ban exceptions */
+	GList *invitelist; /* list of invite exceptions */
+	GList *banlist_last, *ebanlist_last, *invitelist_last;
+	GHashTable *modelists; /* "<mode><mask>" -> node in one of the
+				  lists above, see mode-lists.c */
 
 	time_t massjoin_start; /* Massjoin start time */
 	int massjoins; /* Number of nicks waiting for massjoin signal.. */
 	int last_massjoins; /* Massjoins when last checked in timeout function */
+
+	GTimeVal sync_start; /* when the channel was created */
+	long sync_msecs; /* how long it took to sync the channel */
 };
 
 void irc_channels_init(void);
@@ -79,24 +79,81 @@ char *irc_nick_strip(const char *nick)
 	return stripped;
 }
 
-int irc_nickcmp_rfc1459(const char *m, const char *n)
+/* lowercase versions of each character with the CASEMAPPINGs */
+static unsigned char casemap_ascii[256];
+static unsigned char casemap_rfc1459[256];
+static unsigned char casemap_strict_rfc1459[256];
+
+static void casemap_init(void)
 {
-	while (*m != '\0' && *n != '\0') {
-		if (to_rfc1459(*m) != to_rfc1459(*n))
-			return -1;
-		m++; n++;
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		casemap_ascii[i] = i;
+		casemap_rfc1459[i] = i;
+		casemap_strict_rfc1459[i] = i;
+	}
+
+	/* A-Z, and [\]^ for rfc1459 or [\] for strict-rfc1459 */
+	for (i = 'A'; i <= '^'; i++) {
+		if (i <= 'Z')
+			casemap_ascii[i] = i + 32;
+		casemap_rfc1459[i] = i + 32;
+		if (i <= ']')
+			casemap_strict_rfc1459[i] = i + 32;
 	}
-	return *m == *n ? 0 : 1;
 }
 
-int irc_nickcmp_ascii(const char *m, const char *n)
+static int nickcmp_casemap(const unsigned char *casemap,
+			   const char *m, const char *n)
 {
-	while (*m != '\0' && *n != '\0') {
-		if (to_ascii(*m) != to_ascii(*n))
+	const unsigned char *um = (const unsigned char *) m;
+	const unsigned char *un = (const unsigned char *) n;
+
+	while (*um != '\0' && *un != '\0') {
+		if (casemap[*um] != casemap[*un])
 			return -1;
-		m++; n++;
+		um++; un++;
 	}
-	return *m == *n ? 0 : 1;
+	return *um == *un ? 0 : 1;
+}
+
+static void casefold_casemap(const unsigned char *casemap, char *str)
+{
+	unsigned char *p;
+
+	for (p = (unsigned char *) str; *p != '\0'; p++)
+		*p = casemap[*p];
+}
+
+int irc_nickcmp_rfc1459(const char *m, const char *n)
+{
+	return nickcmp_casemap(casemap_rfc1459, m, n);
+}
+
+int irc_nickcmp_strict_rfc1459(const char *m, const char *n)
+{
+	return nickcmp_casemap(casemap_strict_rfc1459, m, n);
+}
+
+int irc_nickcmp_ascii(const char *m, const char *n)
+{
+	return nickcmp_casemap(casemap_ascii, m, n);
+}
+
+void irc_casefold_rfc1459(char *str)
+{
+	casefold_casemap(casemap_rfc1459, str);
+}
+
+void irc_casefold_strict_rfc1459(char *str)
+{
+	casefold_casemap(casemap_strict_rfc1459, str);
+}
+
+void irc_casefold_ascii(char *str)
+{
+	casefold_casemap(casemap_ascii, str);
 }
 
 static void event_names_list(IRC_SERVER_REC *server, const char *data)
@@ -208,23 +265,14 @@ static void event_end_of_names(IRC_SERVER_REC *server, const char *data)
 	g_free(params);
 }
 
-static void event_who(SERVER_REC *server, const char *data)
+static void nicklist_update_who(SERVER_REC *server, const char *channel,
+				const char *nick, const char *user,
+				const char *host, const char *stat,
+				const char *hops, const char *realname)
 {
-	char *params, *nick, *channel, *user, *host, *stat, *realname, *hops;
 	CHANNEL_REC *chanrec;
 	NICK_REC *nickrec;
 
-	g_return_if_fail(data != NULL);
-
-	params = event_get_params(data, 8, NULL, &channel, &user, &host,
-				  NULL, &nick, &stat, &realname);
-
-	/* get hop count */
-	hops = realname;
-	while (*realname != '\0' && *realname != ' ') realname++;
-	if (*realname == ' ')
-		*realname++ = '\0';
-
 	/* update host, realname, hopcount */
 	chanrec = channel_find(server, channel);
 	nickrec = chanrec == NULL ? NULL :
@@ -243,7 +291,39 @@ static void event_who(SERVER_REC *server, const char *data)
 	nicklist_update_flags(server, nick,
 			      strchr(stat, 'G') != NULL, /* gone */
 			      strchr(stat, '*') != NULL); /* ircop */
+}
 
+static void event_who(SERVER_REC *server, const char *data)
+{
+	char *params, *nick, *channel, *user, *host, *stat, *realname, *hops;
+
+	g_return_if_fail(data != NULL);
+
+	params = event_get_params(data, 8, NULL, &channel, &user, &host,
+				  NULL, &nick, &stat, &realname);
+
+	/* get hop count */
+	hops = realname;
+	while (*realname != '\0' && *realname != ' ') realname++;
+	if (*realname == ' ')
+		*realname++ = '\0';
+
+	nicklist_update_who(server, channel, nick, user, host, stat,
+			    hops, realname);
+	g_free(params);
+}
+
+/* WHOX reply to the "%tcuhnfdr" query sent when syncing channels */
+static void event_whox(SERVER_REC *server, const char *data)
+{
+	char *params, *nick, *channel, *user, *host, *stat, *realname, *hops;
+
+	g_return_if_fail(data != NULL);
+
+	params = event_get_params(data, 9, NULL, NULL, &channel, &user,
+				  &host, &nick, &stat, &hops, &realname);
+	nicklist_update_who(server, channel, nick, user, host, stat,
+			    hops, realname);
 	g_free(params);
 }
 
@@ -468,9 +548,12 @@ static void sig_connected(IRC_SERVER_REC *server)
 
 void irc_nicklist_init(void)
 {
+	casemap_init();
+
 	signal_add_first("event nick", (SIGNAL_FUNC) event_nick);
 	signal_add_first("event 352", (SIGNAL_FUNC) event_who);
 	signal_add("silent event who", (SIGNAL_FUNC) event_who);
+	signal_add("silent event whox", (SIGNAL_FUNC) event_whox);
 	signal_add("silent event whois", (SIGNAL_FUNC) event_whois);
 	signal_add_first("event 311", (SIGNAL_FUNC) event_whois);
 	signal_add_first("whois away", (SIGNAL_FUNC) event_whois_away);
@@ -493,6 +576,7 @@ void irc_nicklist_deinit(void)
 	signal_remove("event nick", (SIGNAL_FUNC) event_nick);
 	signal_remove("event 352", (SIGNAL_FUNC) event_who);
 	signal_remove("silent event who", (SIGNAL_FUNC) event_who);
+	signal_remove("silent event whox", (SIGNAL_FUNC) event_whox);
 	signal_remove("silent event whois", (SIGNAL_FUNC) event_whois);
 	signal_remove("event 311", (SIGNAL_FUNC) event_whois);
 	signal_remove("whois away", (SIGNAL_FUNC) event_whois_away);
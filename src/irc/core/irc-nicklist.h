@@ -12,7 +12,12 @@ NICK_REC *irc_nicklist_insert(IRC_CHANNEL_REC *channel, const char *nick,
 char *irc_nick_strip(const char *nick);
 
 int irc_nickcmp_rfc1459(const char *, const char *);
+int irc_nickcmp_strict_rfc1459(const char *, const char *);
 int irc_nickcmp_ascii(const char *, const char *);
+/* Casefold `str' in place like the functions above compare */
+void irc_casefold_rfc1459(char *str);
+void irc_casefold_strict_rfc1459(char *str);
+void irc_casefold_ascii(char *str);
 
 void irc_nicklist_init(void);
 void irc_nicklist_deinit(void);
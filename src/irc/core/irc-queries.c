@@ -43,16 +43,9 @@ QUERY_REC *irc_query_create(const char *server_tag,
 
 QUERY_REC *irc_query_find(IRC_SERVER_REC *server, const char *nick)
 {
-	GSList *tmp;
+	g_return_val_if_fail(IS_IRC_SERVER(server), NULL);
 
-	for (tmp = server->queries; tmp != NULL; tmp = tmp->next) {
-		QUERY_REC *rec = tmp->data;
-
-		if (server->nick_comp_func(rec->name, nick) == 0)
-			return rec;
-	}
-
-	return NULL;
+	return query_find(SERVER(server), nick);
 }
 
 static void check_query_changes(IRC_SERVER_REC *server, const char *nick,
@@ -280,6 +280,12 @@ void irc_server_purge_output(IRC_SERVER_REC *server, const char *target)
 	}
 }
 
+static int get_send_queue_length(IRC_SERVER_REC *server)
+{
+	/* cmdqueue has the redirection after each command */
+	return g_slist_length(server->cmdqueue) / 2;
+}
+
 static void sig_connected(IRC_SERVER_REC *server)
 {
 	if (!IS_IRC_SERVER(server))
@@ -288,9 +294,10 @@ static void sig_connected(IRC_SERVER_REC *server)
 	server->isnickflag = isnickflag_func;
 	server->ischannel = ischannel_func;
 	server->send_message = send_message;
-	server->query_find_func =
-		(QUERY_REC *(*)(SERVER_REC *, const char *)) irc_query_find;
+	server->get_send_queue_length =
+		(int (*)(SERVER_REC *)) get_send_queue_length;
 	server->nick_comp_func = irc_nickcmp_rfc1459;
+	server_set_casefold(SERVER(server), irc_casefold_rfc1459);
 
 	server->splits = g_hash_table_new((GHashFunc) g_istr_hash,
 					  (GCompareFunc) g_istr_equal);
@@ -829,10 +836,18 @@ void irc_server_init_isupport(IRC_SERVER_REC *server)
 	}
 
 	if ((sptr = g_hash_table_lookup(server->isupport, "CASEMAPPING"))) {
-		if (strstr(sptr, "rfc1459") != NULL)
+		if (strstr(sptr, "strict-rfc1459") != NULL) {
+			server->nick_comp_func = irc_nickcmp_strict_rfc1459;
+			server_set_casefold(SERVER(server),
+					    irc_casefold_strict_rfc1459);
+		} else if (strstr(sptr, "rfc1459") != NULL) {
 			server->nick_comp_func = irc_nickcmp_rfc1459;
-		else
+			server_set_casefold(SERVER(server),
+					    irc_casefold_rfc1459);
+		} else {
 			server->nick_comp_func = irc_nickcmp_ascii;
+			server_set_casefold(SERVER(server), irc_casefold_ascii);
+		}
 	}
 
 	if ((sptr = g_hash_table_lookup(server->isupport, "TARGMAX"))) {
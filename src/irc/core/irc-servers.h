@@ -43,6 +43,8 @@ struct _IRC_SERVER_REC {
         GSList *redirect_queue; /* should be updated from redirect_next each time cmdqueue is updated */
         REDIRECT_REC *redirect_next;
 	GSList *redirect_active; /* redirects start event has been received for, must have unique prefix */
+	GSList *redirect_destroyed; /* redirects whose stop event has been received */
+	GHashTable *redirect_index; /* event -> GQueue of redirects whose command knows the event */
 
         char *last_nick; /* last /NICK, kept even if it resulted as not valid change */
 
@@ -93,6 +95,7 @@ struct _IRC_SERVER_REC {
 
 	GHashTable *splits; /* For keeping track of netsplits */
 	GSList *split_servers; /* Servers that are currently in split */
+	int split_batch; /* splits received since last "netsplit batch" */
 
 	GSList *rejoin_channels; /* try to join to these channels after a while -
 	                            channels go here if they're "temporarily unavailable"
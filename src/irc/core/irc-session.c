@@ -126,6 +126,11 @@ static void sig_session_restore_nick(IRC_CHANNEL_REC *channel,
 	if (nick == NULL)
                 return;
 
+	/* already restored from the session snapshot, the node only has
+	   data saved by other modules */
+	if (nicklist_find(CHANNEL(channel), nick) != NULL)
+		return;
+
 	op = config_node_get_bool(node, "op", FALSE);
         voice = config_node_get_bool(node, "voice", FALSE);
         halfop = config_node_get_bool(node, "halfop", FALSE);
@@ -21,32 +21,53 @@
 #include "module.h"
 #include "misc.h"
 #include "signals.h"
+#include "masks.h"
+#include "nicklist.h"
 
 #include "irc-servers.h"
 #include "irc-channels.h"
 #include "mode-lists.h"
 
-static void ban_free(GSList **list, BAN_REC *rec)
+static GList **modelist_get(IRC_CHANNEL_REC *channel, char mode,
+			    GList ***last)
 {
-	g_return_if_fail(list != NULL);
-	g_return_if_fail(rec != NULL);
+	switch (mode) {
+	case 'b':
+		*last = &channel->banlist_last;
+		return &channel->banlist;
+	case 'e':
+		*last = &channel->ebanlist_last;
+		return &channel->ebanlist;
+	case 'I':
+		*last = &channel->invitelist_last;
+		return &channel->invitelist;
+	}
+
+	return NULL;
+}
 
-	*list = g_slist_remove(*list, rec);
+static char *modelist_key(char mode, const char *mask)
+{
+	return g_strdup_printf("%c%s", mode, mask);
+}
 
+static void ban_free(BAN_REC *rec)
+{
+	mask_compiled_free(rec->compiled);
 	g_free(rec->ban);
 	g_free_not_null(rec->setby);
 	g_free(rec);
 }
 
-void banlist_free(GSList *banlist)
+void banlist_free(GList *banlist)
 {
-	while (banlist != NULL)
-		ban_free(&banlist, banlist->data);
+	g_list_foreach(banlist, (GFunc) ban_free, NULL);
+	g_list_free(banlist);
 }
 
-BAN_REC *banlist_find(GSList *list, const char *ban)
+BAN_REC *banlist_find(GList *list, const char *ban)
 {
-	GSList *tmp;
+	GList *tmp;
 
 	g_return_val_if_fail(ban != NULL, NULL);
 
@@ -60,16 +81,37 @@ BAN_REC *banlist_find(GSList *list, const char *ban)
 	return NULL;
 }
 
-BAN_REC *banlist_add(IRC_CHANNEL_REC *channel, const char *ban,
-		     const char *nick, time_t time)
+/* Find mask from channel's ban (b), ban exception (e) or
+   invite exception (I) list */
+BAN_REC *modelist_find(IRC_CHANNEL_REC *channel, char mode, const char *mask)
+{
+	GList *node;
+	char *key;
+
+	g_return_val_if_fail(IS_IRC_CHANNEL(channel), NULL);
+	g_return_val_if_fail(mask != NULL, NULL);
+
+	key = modelist_key(mode, mask);
+	node = g_hash_table_lookup(channel->modelists, key);
+	g_free(key);
+
+	return node == NULL ? NULL : node->data;
+}
+
+/* Add mask to channel's mode list, returns NULL if it was there already */
+BAN_REC *modelist_add(IRC_CHANNEL_REC *channel, char mode, const char *mask,
+		      const char *nick, time_t time)
 {
 	BAN_REC *rec;
+	GList **list, **last;
 
-	g_return_val_if_fail(channel != NULL, NULL);
-	g_return_val_if_fail(ban != NULL, NULL);
+	g_return_val_if_fail(IS_IRC_CHANNEL(channel), NULL);
+	g_return_val_if_fail(mask != NULL, NULL);
 
-	rec = banlist_find(channel->banlist, ban);
-	if (rec != NULL) {
+	list = modelist_get(channel, mode, &last);
+	g_return_val_if_fail(list != NULL, NULL);
+
+	if (modelist_find(channel, mode, mask) != NULL) {
 		/* duplicate - ignore. some servers send duplicates
 		   for non-ops because they just replace the hostname with
 		   eg. "localhost"... */
@@ -77,14 +119,65 @@ BAN_REC *banlist_add(IRC_CHANNEL_REC *channel, const char *ban,
 	}
 
 	rec = g_new(BAN_REC, 1);
-	rec->ban = g_strdup(ban);
+	rec->ban = g_strdup(mask);
 	rec->setby = nick == NULL || *nick == '\0' ? NULL :
 		g_strdup(nick);
 	rec->time = time;
+	rec->compiled = mask_compile(mask);
 
-	channel->banlist = g_slist_append(channel->banlist, rec);
+	/* append without walking through the list */
+	if (*list == NULL) {
+		*list = *last = g_list_append(NULL, rec);
+	} else {
+		*last = g_list_append(*last, rec)->next;
+	}
 
-	signal_emit("ban new", 2, channel, rec);
+	g_hash_table_insert(channel->modelists,
+			    modelist_key(mode, mask), *last);
+	return rec;
+}
+
+/* Remove mask from channel's mode list. Returns the removed record which
+   the caller needs to free, or NULL if not found. */
+static BAN_REC *modelist_unlink(IRC_CHANNEL_REC *channel, char mode,
+				const char *mask)
+{
+	GList **list, **last, *node;
+	gpointer key, value;
+	BAN_REC *rec;
+	char *lookup;
+	int found;
+
+	list = modelist_get(channel, mode, &last);
+	g_return_val_if_fail(list != NULL, NULL);
+
+	lookup = modelist_key(mode, mask);
+	found = g_hash_table_lookup_extended(channel->modelists, lookup,
+					     &key, &value);
+	g_free(lookup);
+	if (!found)
+		return NULL;
+
+	node = value;
+	rec = node->data;
+	g_hash_table_remove(channel->modelists, key);
+	g_free(key);
+
+	if (*last == node)
+		*last = node->prev;
+	*list = g_list_delete_link(*list, node);
+
+	return rec;
+}
+
+BAN_REC *banlist_add(IRC_CHANNEL_REC *channel, const char *ban,
+		     const char *nick, time_t time)
+{
+	BAN_REC *rec;
+
+	rec = modelist_add(channel, 'b', ban, nick, time);
+	if (rec != NULL)
+		signal_emit("ban new", 2, channel, rec);
 	return rec;
 }
 
@@ -95,19 +188,150 @@ void banlist_remove(IRC_CHANNEL_REC *channel, const char *ban, const char *nick)
 	g_return_if_fail(channel != NULL);
 	g_return_if_fail(ban != NULL);
 
-	rec = banlist_find(channel->banlist, ban);
+	rec = modelist_unlink(channel, 'b', ban);
 	if (rec != NULL) {
 		signal_emit("ban remove", 3, channel, rec, nick);
-		ban_free(&channel->banlist, rec);
+		ban_free(rec);
+	}
+}
+
+BAN_REC *banlist_exception_add(IRC_CHANNEL_REC *channel, const char *ban,
+			       const char *nick, time_t time)
+{
+	BAN_REC *rec;
+
+	rec = modelist_add(channel, 'e', ban, nick, time);
+	if (rec != NULL)
+		signal_emit("ban exception new", 2, channel, rec);
+	return rec;
+}
+
+void banlist_exception_remove(IRC_CHANNEL_REC *channel, const char *ban,
+			      const char *nick)
+{
+	BAN_REC *rec;
+
+	g_return_if_fail(channel != NULL);
+	g_return_if_fail(ban != NULL);
+
+	rec = modelist_unlink(channel, 'e', ban);
+	if (rec != NULL) {
+		signal_emit("ban exception remove", 3, channel, rec, nick);
+		ban_free(rec);
 	}
 }
 
+BAN_REC *invitelist_add(IRC_CHANNEL_REC *channel, const char *mask,
+			const char *nick, time_t time)
+{
+	BAN_REC *rec;
+
+	rec = modelist_add(channel, 'I', mask, nick, time);
+	if (rec != NULL)
+		signal_emit("invitelist new", 2, channel, rec);
+	return rec;
+}
+
+void invitelist_remove(IRC_CHANNEL_REC *channel, const char *mask,
+		       const char *nick)
+{
+	BAN_REC *rec;
+
+	g_return_if_fail(channel != NULL);
+	g_return_if_fail(mask != NULL);
+
+	rec = modelist_unlink(channel, 'I', mask);
+	if (rec != NULL) {
+		signal_emit("invitelist remove", 3, channel, rec, nick);
+		ban_free(rec);
+	}
+}
+
+static char *nick_get_address(NICK_REC *nick)
+{
+	return g_strconcat(nick->nick, "!",
+			   nick->host == NULL ? "" : nick->host, NULL);
+}
+
+/* Returns the nicks (NICK_REC) in channel that mask matches.
+   The list needs to be freed with g_slist_free(). */
+GSList *modelist_match_nicks(IRC_CHANNEL_REC *channel, const char *mask)
+{
+	GSList *tmp, *nicks, *matches;
+	MASK_REC *compiled;
+	char *address;
+
+	g_return_val_if_fail(IS_IRC_CHANNEL(channel), NULL);
+	g_return_val_if_fail(mask != NULL, NULL);
+
+	compiled = mask_compile(mask);
+	matches = NULL;
+	nicks = nicklist_getnicks(CHANNEL(channel));
+	for (tmp = nicks; tmp != NULL; tmp = tmp->next) {
+		NICK_REC *nick = tmp->data;
+
+		address = !compiled->address ? NULL :
+			nick_get_address(nick);
+		if (mask_match_compiled(SERVER(channel->server), compiled,
+					nick->nick, address))
+			matches = g_slist_prepend(matches, nick);
+		g_free(address);
+	}
+	g_slist_free(nicks);
+	mask_compiled_free(compiled);
+
+	return g_slist_reverse(matches);
+}
+
+/* Returns the masks (BAN_REC) in channel's mode list that match nick.
+   The list needs to be freed with g_slist_free(). */
+GSList *modelist_match_masks(IRC_CHANNEL_REC *channel, char mode,
+			     NICK_REC *nick)
+{
+	GList *tmp, **list, **last;
+	GSList *matches;
+	char *address;
+
+	g_return_val_if_fail(IS_IRC_CHANNEL(channel), NULL);
+	g_return_val_if_fail(nick != NULL, NULL);
+
+	list = modelist_get(channel, mode, &last);
+	g_return_val_if_fail(list != NULL, NULL);
+
+	matches = NULL;
+	address = nick_get_address(nick);
+	for (tmp = *list; tmp != NULL; tmp = tmp->next) {
+		BAN_REC *rec = tmp->data;
+
+		if (mask_match_compiled(SERVER(channel->server),
+					rec->compiled, nick->nick, address))
+			matches = g_slist_prepend(matches, rec);
+	}
+	g_free(address);
+
+	return g_slist_reverse(matches);
+}
+
+static void channel_created(IRC_CHANNEL_REC *channel)
+{
+	if (!IS_IRC_CHANNEL(channel))
+                return;
+
+	channel->modelists = g_hash_table_new((GHashFunc) g_istr_hash,
+					      (GCompareFunc) g_istr_equal);
+}
+
 static void channel_destroyed(IRC_CHANNEL_REC *channel)
 {
 	if (!IS_IRC_CHANNEL(channel))
                 return;
 
 	banlist_free(channel->banlist);
+	banlist_free(channel->ebanlist);
+	banlist_free(channel->invitelist);
+
+	g_hash_table_foreach(channel->modelists, (GHFunc) g_free, NULL);
+	g_hash_table_destroy(channel->modelists);
 }
 
 static void event_banlist(IRC_SERVER_REC *server, const char *data)
@@ -127,16 +351,53 @@ static void event_banlist(IRC_SERVER_REC *server, const char *data)
 	g_free(params);
 }
 
+static void event_modelist(IRC_SERVER_REC *server, const char *data,
+			   char mode)
+{
+	IRC_CHANNEL_REC *chanrec;
+	char *params, *channel, *mask, *setby, *tims;
+	time_t tim;
+
+	g_return_if_fail(data != NULL);
+
+	params = event_get_params(data, 5, NULL, &channel, &mask, &setby, &tims);
+	chanrec = irc_channel_find(server, channel);
+	if (chanrec != NULL) {
+		tim = (time_t) atol(tims);
+		if (mode == 'e')
+			banlist_exception_add(chanrec, mask, setby, tim);
+		else
+			invitelist_add(chanrec, mask, setby, tim);
+	}
+	g_free(params);
+}
+
+static void event_ebanlist(IRC_SERVER_REC *server, const char *data)
+{
+	event_modelist(server, data, 'e');
+}
+
+static void event_invitelist(IRC_SERVER_REC *server, const char *data)
+{
+	event_modelist(server, data, 'I');
+}
+
 void mode_lists_init(void)
 {
+	signal_add_first("channel created", (SIGNAL_FUNC) channel_created);
 	signal_add("channel destroyed", (SIGNAL_FUNC) channel_destroyed);
 
 	signal_add("chanquery ban", (SIGNAL_FUNC) event_banlist);
+	signal_add("event 348", (SIGNAL_FUNC) event_ebanlist);
+	signal_add("event 346", (SIGNAL_FUNC) event_invitelist);
 }
 
 void mode_lists_deinit(void)
 {
+	signal_remove("channel created", (SIGNAL_FUNC) channel_created);
 	signal_remove("channel destroyed", (SIGNAL_FUNC) channel_destroyed);
 
 	signal_remove("chanquery ban", (SIGNAL_FUNC) event_banlist);
+	signal_remove("event 348", (SIGNAL_FUNC) event_ebanlist);
+	signal_remove("event 346", (SIGNAL_FUNC) event_invitelist);
 }
@@ -1,22 +1,41 @@
 #ifndef __MODE_LISTS_H
 #define __MODE_LISTS_H
 
+#include "masks.h"
+
 typedef struct {
 	char *ban;
 	char *setby;
 	time_t time;
+
+	MASK_REC *compiled;
 } BAN_REC;
 
-BAN_REC *banlist_find(GSList *list, const char *ban);
+BAN_REC *banlist_find(GList *list, const char *ban);
+
+/* Find mask from channel's ban (b), ban exception (e) or
+   invite exception (I) list */
+BAN_REC *modelist_find(IRC_CHANNEL_REC *channel, char mode, const char *mask);
+/* Add mask to channel's mode list, returns NULL if it was there already */
+BAN_REC *modelist_add(IRC_CHANNEL_REC *channel, char mode, const char *mask,
+		      const char *nick, time_t time);
+
+/* Returns the nicks (NICK_REC) in channel that mask matches.
+   The list needs to be freed with g_slist_free(). */
+GSList *modelist_match_nicks(IRC_CHANNEL_REC *channel, const char *mask);
+/* Returns the masks (BAN_REC) in channel's mode list that match nick.
+   The list needs to be freed with g_slist_free(). */
+GSList *modelist_match_masks(IRC_CHANNEL_REC *channel, char mode,
+			     NICK_REC *nick);
 
 BAN_REC *banlist_add(IRC_CHANNEL_REC *channel, const char *ban, const char *nick, time_t time);
 void banlist_remove(IRC_CHANNEL_REC *channel, const char *ban, const char *nick);
 
 BAN_REC *banlist_exception_add(IRC_CHANNEL_REC *channel, const char *ban, const char *nick, time_t time);
-void banlist_exception_remove(IRC_CHANNEL_REC *channel, const char *ban);
+void banlist_exception_remove(IRC_CHANNEL_REC *channel, const char *ban, const char *nick);
 
-void invitelist_add(IRC_CHANNEL_REC *channel, const char *mask);
-void invitelist_remove(IRC_CHANNEL_REC *channel, const char *mask);
+BAN_REC *invitelist_add(IRC_CHANNEL_REC *channel, const char *mask, const char *nick, time_t time);
+void invitelist_remove(IRC_CHANNEL_REC *channel, const char *mask, const char *nick);
 
 void mode_lists_init(void);
 void mode_lists_deinit(void);
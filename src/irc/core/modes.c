@@ -247,22 +247,145 @@ static void mode_set_arg(IRC_SERVER_REC *server, GString *str,
 		mode_add_sorted(server, str, mode, arg, user);
 }
 
+#define MODE_VALID(mode) ((unsigned char) (mode) < 128)
+#define MODE_BIT_INDEX(mode) ((unsigned char) (mode) >> 5)
+#define MODE_BIT(mode) (1U << ((unsigned char) (mode) & 31))
+
+static int chanmode_isset(IRC_CHANNEL_MODES_REC *modes, char mode)
+{
+	return MODE_VALID(mode) &&
+		(modes->bits[MODE_BIT_INDEX(mode)] & MODE_BIT(mode)) != 0;
+}
+
+static int chanmode_arg_cmp(const char *arg1, const char *arg2)
+{
+	return (int) (unsigned char) *arg1 - (int) (unsigned char) *arg2;
+}
+
+static GSList *chanmode_find_arg(IRC_CHANNEL_MODES_REC *modes, char mode)
+{
+	GSList *tmp;
+	int cmp;
+
+	for (tmp = modes->args; tmp != NULL; tmp = tmp->next) {
+		cmp = chanmode_arg_cmp(tmp->data, &mode);
+		if (cmp == 0)
+			return tmp;
+		if (cmp > 0)
+			break;
+	}
+
+	return NULL;
+}
+
+static void chanmode_set(IRC_CHANNEL_MODES_REC *modes, char mode,
+			 const char *arg)
+{
+	GSList *tmp;
+
+	if (!MODE_VALID(mode))
+		return;
+
+	modes->bits[MODE_BIT_INDEX(mode)] |= MODE_BIT(mode);
+	if (arg == NULL)
+		return;
+
+	tmp = chanmode_find_arg(modes, mode);
+	if (tmp != NULL) {
+		if (strcmp((char *) tmp->data + 1, arg) == 0)
+			return;
+		g_free(tmp->data);
+		tmp->data = g_strdup_printf("%c%s", mode, arg);
+	} else {
+		modes->args = g_slist_insert_sorted(modes->args,
+						    g_strdup_printf("%c%s", mode, arg),
+						    (GCompareFunc) chanmode_arg_cmp);
+	}
+	modes->args_changed = TRUE;
+}
+
+static void chanmode_unset(IRC_CHANNEL_MODES_REC *modes, char mode)
+{
+	GSList *tmp;
+
+	if (!MODE_VALID(mode))
+		return;
+
+	modes->bits[MODE_BIT_INDEX(mode)] &= ~MODE_BIT(mode);
+
+	tmp = chanmode_find_arg(modes, mode);
+	if (tmp != NULL) {
+		g_free(tmp->data);
+		modes->args = g_slist_delete_link(modes->args, tmp);
+		modes->args_changed = TRUE;
+	}
+}
+
+static void chanmode_change(IRC_CHANNEL_MODES_REC *modes, char type,
+			    char mode, const char *arg)
+{
+	if (type == '-')
+		chanmode_unset(modes, mode);
+	else
+		chanmode_set(modes, mode, arg);
+}
+
+/* Render the mode string, eg. "knt key" */
+char *channel_modes_render(IRC_CHANNEL_REC *channel)
+{
+	GString *str;
+	GSList *tmp;
+	char *ret;
+	int mode;
+
+	g_return_val_if_fail(IS_IRC_CHANNEL(channel), NULL);
+
+	str = g_string_new(NULL);
+	for (mode = 1; mode < 128; mode++) {
+		if (chanmode_isset(&channel->modes, (char) mode))
+			g_string_append_c(str, (char) mode);
+	}
+
+	for (tmp = channel->modes.args; tmp != NULL; tmp = tmp->next) {
+		g_string_append_c(str, ' ');
+		g_string_append(str, (char *) tmp->data + 1);
+	}
+
+	ret = str->str;
+	g_string_free(str, FALSE);
+	return ret;
+}
+
 /* Mode that needs a parameter of a mask for both setting and removing
    (eg: bans) */
 void modes_type_a(IRC_CHANNEL_REC *channel, const char *setby, char type,
-		  char mode, char *arg, GString *newmode)
+		  char mode, char *arg, IRC_CHANNEL_MODES_REC *newmode)
 {
-	if (mode == 'b') {
+	switch (mode) {
+	case 'b':
 		if (type == '+')
 			banlist_add(channel, arg, setby, time(NULL));
 		else
 			banlist_remove(channel, arg, setby);
+		break;
+	case 'e':
+		if (type == '+')
+			banlist_exception_add(channel, arg, setby, time(NULL));
+		else
+			banlist_exception_remove(channel, arg, setby);
+		break;
+	case 'I':
+		if (type == '+')
+			invitelist_add(channel, arg, setby, time(NULL));
+		else
+			invitelist_remove(channel, arg, setby);
+		break;
 	}
 }
 
 /* Mode that needs parameter for both setting and removing (eg: +k) */
 void modes_type_b(IRC_CHANNEL_REC *channel, const char *setby, char type,
-		  char mode, char *arg, GString *newmode)
+		  char mode, char *arg, IRC_CHANNEL_MODES_REC *newmode)
 {
 	if (mode == 'k') {
 		if (*arg == '\0' && type == '+')
@@ -274,30 +397,30 @@ void modes_type_b(IRC_CHANNEL_REC *channel, const char *setby, char type,
 				channel->key = g_strdup(arg);
 		}
 	}
-	
-	mode_set_arg(channel->server, newmode, type, mode, arg, FALSE);
+
+	chanmode_change(newmode, type, mode, arg);
 }
 
 /* Mode that needs parameter only for adding */
 void modes_type_c(IRC_CHANNEL_REC *channel, const char *setby,
-		  char type, char mode, char *arg, GString *newmode)
+		  char type, char mode, char *arg, IRC_CHANNEL_MODES_REC *newmode)
 {
 	if (mode == 'l') {
 		channel->limit = type == '-' ? 0 : atoi(arg);
 	}
-	
-	mode_set_arg(channel->server, newmode, type, mode, arg, FALSE);
+
+	chanmode_change(newmode, type, mode, arg);
 }
 
 /* Mode that takes no parameter */
 void modes_type_d(IRC_CHANNEL_REC *channel, const char *setby,
-		  char type, char mode, char *arg, GString *newmode)
+		  char type, char mode, char *arg, IRC_CHANNEL_MODES_REC *newmode)
 {
-	mode_set(channel->server, newmode, type, mode, FALSE);
+	chanmode_change(newmode, type, mode, NULL);
 }
 
 void modes_type_prefix(IRC_CHANNEL_REC *channel, const char *setby,
-		       char type, char mode, char *arg, GString *newmode)
+		       char type, char mode, char *arg, IRC_CHANNEL_MODES_REC *newmode)
 {
 	int umode = (unsigned char) mode;
 
@@ -330,8 +453,18 @@ int channel_mode_is_set(IRC_CHANNEL_REC *channel, char mode)
 {
 	g_return_val_if_fail(IS_IRC_CHANNEL(channel), FALSE);
 
-	return channel->mode == NULL ? FALSE :
-		mode_is_set(channel->mode, mode);
+	return chanmode_isset(&channel->modes, mode);
+}
+
+/* Returns the argument of a set mode, or NULL */
+const char *channel_mode_get_arg(IRC_CHANNEL_REC *channel, char mode)
+{
+	GSList *tmp;
+
+	g_return_val_if_fail(IS_IRC_CHANNEL(channel), NULL);
+
+	tmp = chanmode_find_arg(&channel->modes, mode);
+	return tmp == NULL ? NULL : (char *) tmp->data + 1;
 }
 
 /* Parse channel mode string */
@@ -339,15 +472,19 @@ void parse_channel_modes(IRC_CHANNEL_REC *channel, const char *setby,
 			 const char *mode, int update_key)
 {
 	IRC_SERVER_REC *server = channel->server;
-        GString *newmode;
+	IRC_CHANNEL_MODES_REC *newmode;
+	guint32 old_bits[4];
 	char *dup, *modestr, *arg, *curmode, type, *old_key;
-	int umode;
+	int umode, had_key;
 
 	g_return_if_fail(IS_IRC_CHANNEL(channel));
 	g_return_if_fail(mode != NULL);
 
 	type = '+';
-	newmode = g_string_new(channel->mode);
+	newmode = &channel->modes;
+	memcpy(old_bits, newmode->bits, sizeof(old_bits));
+	newmode->args_changed = FALSE;
+	had_key = chanmode_isset(newmode, 'k');
 	old_key = update_key ? NULL : g_strdup(channel->key);
 
 	dup = modestr = g_strdup(mode);
@@ -383,9 +520,8 @@ void parse_channel_modes(IRC_CHANNEL_REC *channel, const char *setby,
 	}
 	g_free(dup);
 
-	if (channel->key != NULL &&
-	    strchr(channel->mode, 'k') == NULL &&
-	    strchr(newmode->str, 'k') == NULL) {
+	if (channel->key != NULL && !had_key &&
+	    !chanmode_isset(newmode, 'k')) {
 		/* join was used with key but there's no key set
 		   in channel modes.. */
 		g_free(channel->key);
@@ -394,18 +530,18 @@ void parse_channel_modes(IRC_CHANNEL_REC *channel, const char *setby,
 		/* get the old one back, just in case it was replaced */
 		g_free(channel->key);
 		channel->key = old_key;
-		mode_set_arg(channel->server, newmode, '+', 'k', old_key, FALSE);
+		chanmode_set(newmode, 'k', old_key);
 		old_key = NULL;
 	}
 
-	if (strcmp(newmode->str, channel->mode) != 0) {
-		g_free(channel->mode);
-		channel->mode = g_strdup(newmode->str);
+	if (newmode->args_changed ||
+	    memcmp(old_bits, newmode->bits, sizeof(old_bits)) != 0) {
+		/* the string is rendered again only when it's needed */
+		g_free_and_null(channel->mode);
 
 		signal_emit("channel mode changed", 2, channel, setby);
 	}
 
-	g_string_free(newmode, TRUE);
 	g_free(old_key);
 }
 
@@ -5,7 +5,7 @@
 #include "nicklist.h" /* MAX_USER_PREFIXES */
 
 typedef void mode_func_t(IRC_CHANNEL_REC *, const char *, char, char,
-			 char *, GString *);
+			 char *, IRC_CHANNEL_MODES_REC *);
 
 struct modes_type {
 	mode_func_t *func;
@@ -46,6 +46,10 @@ void modes_server_init(IRC_SERVER_REC *);
 char *modes_join(IRC_SERVER_REC *server, const char *old, const char *mode, int channel);
 
 int channel_mode_is_set(IRC_CHANNEL_REC *channel, char mode);
+/* Returns the argument of a set mode, or NULL */
+const char *channel_mode_get_arg(IRC_CHANNEL_REC *channel, char mode);
+/* Render the mode string, eg. "knt key" */
+char *channel_modes_render(IRC_CHANNEL_REC *channel);
 
 void parse_channel_modes(IRC_CHANNEL_REC *channel, const char *setby,
 			 const char *modestr, int update_key);
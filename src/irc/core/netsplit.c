@@ -31,6 +31,8 @@
 #define NETSPLIT_MAX_REMEMBER (60*60)
 
 static int split_tag;
+static int batch_tag;
+static GSList *batch_servers; /* servers with splits not yet in a batch */
 
 static NETSPLIT_SERVER_REC *netsplit_server_find(IRC_SERVER_REC *server,
 						 const char *servername,
@@ -90,14 +92,49 @@ static void netsplit_server_destroy(IRC_SERVER_REC *server,
 	g_free(rec);
 }
 
+/* the QUIT flood of one split arrives in a burst, so report all the
+   splits received in it with a single "netsplit batch" signal once
+   there's nothing more to read. */
+static int netsplit_batch_flush(void)
+{
+	IRC_SERVER_REC *server;
+	int count;
+
+	batch_tag = -1;
+	while (batch_servers != NULL) {
+		server = batch_servers->data;
+		batch_servers = g_slist_remove(batch_servers, server);
+
+		count = server->split_batch;
+		server->split_batch = 0;
+		signal_emit("netsplit batch", 2, server,
+			    GINT_TO_POINTER(count));
+	}
+
+	return FALSE;
+}
+
+static void netsplit_batch_add(IRC_SERVER_REC *server)
+{
+	if (server->split_batch++ == 0)
+		batch_servers = g_slist_prepend(batch_servers, server);
+
+	if (batch_tag == -1) {
+		batch_tag = g_idle_add((GSourceFunc) netsplit_batch_flush,
+				       NULL);
+	}
+}
+
 static NETSPLIT_REC *netsplit_add(IRC_SERVER_REC *server, const char *nick,
 				  const char *address, const char *servers)
 {
 	NETSPLIT_REC *rec;
 	NETSPLIT_CHAN_REC *splitchan;
+	CHANNEL_REC *channel;
 	NICK_REC *nickrec;
-	GSList *tmp;
-	char *p, *dupservers;
+	GSList *nicks, *tmp;
+	char *p, *dupservers, *name;
+	int count, namelen;
 
 	g_return_val_if_fail(IS_IRC_SERVER(server), NULL);
 	g_return_val_if_fail(nick != NULL, NULL);
@@ -122,48 +159,59 @@ static NETSPLIT_REC *netsplit_add(IRC_SERVER_REC *server, const char *nick,
 	rec->server->count++;
 	g_free(dupservers);
 
-	/* copy the channel nick records.. */
-	for (tmp = server->channels; tmp != NULL; tmp = tmp->next) {
-		CHANNEL_REC *channel = tmp->data;
-
-		nickrec = nicklist_find(channel, nick);
-		if (nickrec == NULL)
-			continue;
-
-		splitchan = g_new0(NETSPLIT_CHAN_REC, 1);
-		splitchan->name = g_strdup(channel->visible_name);
-		splitchan->op = nickrec->op;
-		splitchan->halfop = nickrec->halfop;
-		splitchan->voice = nickrec->voice;
-		memcpy(splitchan->prefixes, nickrec->prefixes, sizeof(splitchan->prefixes));
+	/* copy the channel nick records.. only the channels the nick
+	   is actually in are looked at, the records and channel names
+	   are stored in one memory block. */
+	nicks = nicklist_get_same(SERVER(server), nick);
+	count = namelen = 0;
+	for (tmp = nicks; tmp != NULL; tmp = tmp->next->next) {
+		channel = tmp->data;
 
-		rec->channels = g_slist_append(rec->channels, splitchan);
+		count++;
+		namelen += strlen(channel->visible_name)+1;
 	}
 
-	if (rec->channels == NULL)
+	if (count == 0)
 		g_warning("netsplit_add(): nick '%s' not in any channels", nick);
+	else {
+		rec->channels = g_malloc0(sizeof(NETSPLIT_CHAN_REC) * count +
+					  namelen);
+		rec->channels_count = count;
+
+		splitchan = rec->channels;
+		name = (char *) (rec->channels + count);
+		for (tmp = nicks; tmp != NULL; tmp = tmp->next->next) {
+			channel = tmp->data;
+			nickrec = tmp->next->data;
+
+			strcpy(name, channel->visible_name);
+			splitchan->name = name;
+			name += strlen(name)+1;
+
+			splitchan->op = nickrec->op;
+			splitchan->halfop = nickrec->halfop;
+			splitchan->voice = nickrec->voice;
+			memcpy(splitchan->prefixes, nickrec->prefixes,
+			       sizeof(splitchan->prefixes));
+			splitchan++;
+		}
+	}
+	g_slist_free(nicks);
 
 	g_hash_table_insert(server->splits, rec->nick, rec);
 
-	signal_emit("netsplit new", 1, rec);
+	signal_emit("netsplit new", 2, rec, server);
+	netsplit_batch_add(server);
 	return rec;
 }
 
 static void netsplit_destroy(IRC_SERVER_REC *server, NETSPLIT_REC *rec)
 {
-	GSList *tmp;
-
 	g_return_if_fail(IS_IRC_SERVER(server));
 	g_return_if_fail(rec != NULL);
 
 	signal_emit("netsplit remove", 1, rec);
-	for (tmp = rec->channels; tmp != NULL; tmp = tmp->next) {
-		NETSPLIT_CHAN_REC *rec = tmp->data;
-
-		g_free(rec->name);
-		g_free(rec);
-	}
-	g_slist_free(rec->channels);
+	g_free(rec->channels);
 
 	if (--rec->server->count == 0)
 		netsplit_server_destroy(server, rec->server);
@@ -199,7 +247,7 @@ NETSPLIT_CHAN_REC *netsplit_find_channel(IRC_SERVER_REC *server,
 					 const char *channel)
 {
 	NETSPLIT_REC *rec;
-	GSList *tmp;
+	int i;
 
 	g_return_val_if_fail(IS_IRC_SERVER(server), NULL);
 	g_return_val_if_fail(nick != NULL, NULL);
@@ -208,11 +256,9 @@ NETSPLIT_CHAN_REC *netsplit_find_channel(IRC_SERVER_REC *server,
 	rec = netsplit_find(server, nick, address);
 	if (rec == NULL) return NULL;
 
-	for (tmp = rec->channels; tmp != NULL; tmp = tmp->next) {
-		NETSPLIT_CHAN_REC *rec = tmp->data;
-
-		if (g_strcasecmp(rec->name, channel) == 0)
-			return rec;
+	for (i = 0; i < rec->channels_count; i++) {
+		if (g_strcasecmp(rec->channels[i].name, channel) == 0)
+			return &rec->channels[i];
 	}
 
 	return NULL;
@@ -381,6 +427,11 @@ static void sig_disconnected(IRC_SERVER_REC *server)
 	if (!IS_IRC_SERVER(server))
 		return;
 
+	if (server->split_batch > 0) {
+		batch_servers = g_slist_remove(batch_servers, server);
+		server->split_batch = 0;
+	}
+
 	g_hash_table_foreach(server->splits,
 			     (GHFunc) netsplit_destroy_hash, server);
 	g_hash_table_destroy(server->splits);
@@ -419,6 +470,8 @@ static int split_check_old(void)
 void netsplit_init(void)
 {
 	split_tag = g_timeout_add(1000, (GSourceFunc) split_check_old, NULL);
+	batch_tag = -1;
+	batch_servers = NULL;
 	signal_add_first("event join", (SIGNAL_FUNC) event_join);
 	signal_add_last("event join", (SIGNAL_FUNC) event_join_last);
 	signal_add_first("event quit", (SIGNAL_FUNC) event_quit);
@@ -429,6 +482,9 @@ void netsplit_init(void)
 void netsplit_deinit(void)
 {
 	g_source_remove(split_tag);
+	if (batch_tag != -1)
+		g_source_remove(batch_tag);
+	g_slist_free(batch_servers);
 	signal_remove("event join", (SIGNAL_FUNC) event_join);
 	signal_remove("event join", (SIGNAL_FUNC) event_join_last);
 	signal_remove("event quit", (SIGNAL_FUNC) event_quit);
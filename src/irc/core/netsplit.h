@@ -7,30 +7,31 @@ typedef struct {
 	char *server;
 	char *destserver;
 	int count;
-        int prints; /* temp variable */
 
 	time_t last; /* last time we received a QUIT msg here */
 } NETSPLIT_SERVER_REC;
 
+typedef struct {
+	char *name;
+	unsigned int op:1;
+	unsigned int halfop:1;
+	unsigned int voice:1;
+	char prefixes[MAX_USER_PREFIXES+1];
+} NETSPLIT_CHAN_REC;
+
 typedef struct {
 	NETSPLIT_SERVER_REC *server;
 
 	char *nick;
 	char *address;
-	GSList *channels;
+	/* channels and their names are allocated in one block */
+	NETSPLIT_CHAN_REC *channels;
+	int channels_count;
 
 	unsigned int printed:1;
 	time_t destroy;
 } NETSPLIT_REC;
 
-typedef struct {
-	char *name;
-	unsigned int op:1;
-	unsigned int halfop:1;
-	unsigned int voice:1;
-	char prefixes[MAX_USER_PREFIXES+1];
-} NETSPLIT_CHAN_REC;
-
 void netsplit_init(void);
 void netsplit_deinit(void);
 
@@ -28,11 +28,23 @@
 
 #define DEFAULT_REDIRECT_TIMEOUT 60
 
+/* How often to check for timeouted remote redirections, in msecs */
+#define REDIRECT_TIMEOUT_CHECK 10000
+
 /* Allow one non-expected redirections to come before the expected one
    before aborting it. Some IRC bouncers/proxies reply to eg. PINGs
    immediately. */
 #define MAX_FAILURE_COUNT 1
 
+#define REDIRECT_LIST_START	0
+#define REDIRECT_LIST_STOP	1
+#define REDIRECT_LIST_OPT	2
+
+typedef struct {
+	unsigned int lists; /* (1 << REDIRECT_LIST_xxx) bits */
+	int argpos[3]; /* argpos for each list the event is in */
+} REDIRECT_CMD_EVENT_REC;
+
 typedef struct {
         char *name;
 	int refcount;
@@ -40,6 +52,8 @@ typedef struct {
 	int remote;
 	int timeout;
 	GSList *start, *stop, *opt; /* char *event, int argpos, ... */
+	GHashTable *events; /* event -> REDIRECT_CMD_EVENT_REC */
+	GSList *event_list; /* each event in the lists once */
 } REDIRECT_CMD_REC;
 
 struct _REDIRECT_REC {
@@ -52,6 +66,7 @@ struct _REDIRECT_REC {
 	unsigned int aborted:1;
 	unsigned int remote:1;
 	unsigned int first_signal_sent:1;
+	unsigned int active:1; /* in server->redirect_active */
 
 	char *arg;
         int count;
@@ -60,6 +75,7 @@ struct _REDIRECT_REC {
 };
 
 static GHashTable *command_redirects; /* "command xxx" : REDIRECT_CMD_REC* */
+static int redirect_timeout_tag;
 
 /* Find redirection command record for specified command line. */
 static REDIRECT_CMD_REC *redirect_cmd_find(const char *command)
@@ -79,10 +95,46 @@ static REDIRECT_CMD_REC *redirect_cmd_find(const char *command)
         return rec;
 }
 
+/* Index the command's events so that they can be found without going
+   through the start/stop/opt lists */
+static void redirect_cmd_add_events(REDIRECT_CMD_REC *rec, GSList *list,
+				    int list_type)
+{
+	REDIRECT_CMD_EVENT_REC *event;
+
+	for (; list != NULL; list = list->next->next) {
+		event = g_hash_table_lookup(rec->events, list->data);
+		if (event == NULL) {
+			event = g_new0(REDIRECT_CMD_EVENT_REC, 1);
+			g_hash_table_insert(rec->events, list->data, event);
+			rec->event_list = g_slist_prepend(rec->event_list,
+							  list->data);
+		}
+
+		/* first one in the list wins */
+		if ((event->lists & (1 << list_type)) == 0) {
+			event->lists |= 1 << list_type;
+			event->argpos[list_type] =
+				GPOINTER_TO_INT(list->next->data);
+		}
+	}
+}
+
+static void redirect_cmd_event_destroy(const char *key,
+				       REDIRECT_CMD_EVENT_REC *event)
+{
+	g_free(event);
+}
+
 static void redirect_cmd_destroy(REDIRECT_CMD_REC *rec)
 {
 	GSList *tmp;
 
+	g_hash_table_foreach(rec->events,
+			     (GHFunc) redirect_cmd_event_destroy, NULL);
+	g_hash_table_destroy(rec->events);
+	g_slist_free(rec->event_list);
+
 	for (tmp = rec->start; tmp != NULL; tmp = tmp->next->next)
                 g_free(tmp->data);
 	for (tmp = rec->stop; tmp != NULL; tmp = tmp->next->next)
@@ -181,6 +233,12 @@ void server_redirect_register_list(const char *command,
 	rec->start = start;
         rec->stop = stop;
         rec->opt = opt;
+
+	rec->events = g_hash_table_new((GHashFunc) g_str_hash,
+				       (GCompareFunc) g_str_equal);
+	redirect_cmd_add_events(rec, start, REDIRECT_LIST_START);
+	redirect_cmd_add_events(rec, stop, REDIRECT_LIST_STOP);
+	redirect_cmd_add_events(rec, opt, REDIRECT_LIST_OPT);
         g_hash_table_insert(command_redirects, rec->name, rec);
 }
 
@@ -270,6 +328,58 @@ void server_redirect_event_list(IRC_SERVER_REC *server, const char *command,
         server->redirect_next = rec;
 }
 
+/* Add the redirection to the queues of all the events its command knows */
+static void redirect_index_add(IRC_SERVER_REC *server, REDIRECT_REC *rec)
+{
+	GSList *tmp;
+	GQueue *queue;
+
+	if (server->redirect_index == NULL) {
+		server->redirect_index =
+			g_hash_table_new((GHashFunc) g_str_hash,
+					 (GCompareFunc) g_str_equal);
+	}
+
+	for (tmp = rec->cmd->event_list; tmp != NULL; tmp = tmp->next) {
+		queue = g_hash_table_lookup(server->redirect_index, tmp->data);
+		if (queue == NULL) {
+			queue = g_queue_new();
+			g_hash_table_insert(server->redirect_index,
+					    g_strdup(tmp->data), queue);
+		}
+		g_queue_push_tail(queue, rec);
+	}
+}
+
+static void redirect_index_remove(IRC_SERVER_REC *server, REDIRECT_REC *rec)
+{
+	GSList *tmp;
+	gpointer key, value;
+
+	if (server->redirect_index == NULL)
+		return;
+
+	for (tmp = rec->cmd->event_list; tmp != NULL; tmp = tmp->next) {
+		if (!g_hash_table_lookup_extended(server->redirect_index,
+						  tmp->data, &key, &value))
+			continue;
+
+		/* it's usually the first one in the queue */
+		g_queue_remove(value, rec);
+		if (g_queue_is_empty(value)) {
+			g_hash_table_remove(server->redirect_index, key);
+			g_queue_free(value);
+			g_free(key);
+		}
+	}
+}
+
+static void redirect_index_destroy_queue(char *key, GQueue *queue)
+{
+	g_queue_free(queue);
+	g_free(key);
+}
+
 void server_redirect_command(IRC_SERVER_REC *server, const char *command,
 			     REDIRECT_REC *redirect)
 {
@@ -294,6 +404,7 @@ void server_redirect_command(IRC_SERVER_REC *server, const char *command,
 	}
 
 	server->redirects = g_slist_append(server->redirects, redirect);
+	redirect_index_add(server, redirect);
 }
 
 static int redirect_args_match(const char *event_args,
@@ -334,17 +445,19 @@ static int redirect_args_match(const char *event_args,
         return FALSE;
 }
 
-static GSList *redirect_cmd_list_find(GSList *list, const char *event)
+/* Returns TRUE if event is in the command's `list_type' list,
+   and sets the argument position */
+static int redirect_cmd_list_find(REDIRECT_CMD_REC *cmd, int list_type,
+				  const char *event, int *argpos)
 {
-	while (list != NULL) {
-		const char *str = list->data;
+	REDIRECT_CMD_EVENT_REC *rec;
 
-		if (strcmp(str, event) == 0)
-                        break;
-                list = list->next->next;
-	}
+	rec = g_hash_table_lookup(cmd->events, event);
+	if (rec == NULL || (rec->lists & (1 << list_type)) == 0)
+		return FALSE;
 
-        return list;
+	*argpos = rec->argpos[list_type];
+	return TRUE;
 }
 
 #define MATCH_NONE      0
@@ -354,9 +467,9 @@ static GSList *redirect_cmd_list_find(GSList *list, const char *event)
 static const char *redirect_match(REDIRECT_REC *redirect, const char *event,
 				  const char *args, int *match)
 {
-	GSList *tmp, *cmdpos;
+	GSList *tmp;
 	const char *signal;
-        int match_list;
+        int match_list, found, argpos;
 
 	if (redirect->aborted)
                 return NULL;
@@ -372,23 +485,29 @@ static const char *redirect_match(REDIRECT_REC *redirect, const char *event,
 	}
 
 	/* find the argument position */
+	argpos = -1;
 	if (redirect->destroyed) {
 		/* stop event is already found for this redirection, but
 		   we'll still want to look for optional events */
-		cmdpos = redirect_cmd_list_find(redirect->cmd->opt, event);
-		if (cmdpos == NULL)
+		found = redirect_cmd_list_find(redirect->cmd,
+					       REDIRECT_LIST_OPT,
+					       event, &argpos);
+		if (!found)
 			return NULL;
 
                 match_list = MATCH_STOP;
 	} else {
                 /* look from start/stop lists */
-		cmdpos = redirect_cmd_list_find(redirect->cmd->start, event);
-		if (cmdpos != NULL)
+		found = redirect_cmd_list_find(redirect->cmd,
+					       REDIRECT_LIST_START,
+					       event, &argpos);
+		if (found)
 			match_list = MATCH_START;
 		else {
-			cmdpos = redirect_cmd_list_find(redirect->cmd->stop,
-							event);
-			if (cmdpos != NULL)
+			found = redirect_cmd_list_find(redirect->cmd,
+						       REDIRECT_LIST_STOP,
+						       event, &argpos);
+			if (found)
 				match_list = MATCH_STOP;
 			else if (redirect->default_signal != NULL &&
 					args == NULL &&
@@ -408,16 +527,15 @@ static const char *redirect_match(REDIRECT_REC *redirect, const char *event,
 		}
 	}
 
-	if (signal == NULL && cmdpos == NULL) {
+	if (signal == NULL && !found) {
 		/* event not found from specified redirection events nor
 		   registered command events, and no default signal */
 		return NULL;
 	}
 
 	/* check that arguments match */
-	if (args != NULL && redirect->arg != NULL && cmdpos != NULL &&
-	    !redirect_args_match(args, redirect->arg,
-				 GPOINTER_TO_INT(cmdpos->next->data)))
+	if (args != NULL && redirect->arg != NULL && found &&
+	    !redirect_args_match(args, redirect->arg, argpos))
 		return NULL;
 
         *match = match_list;
@@ -446,7 +564,15 @@ static void redirect_abort(IRC_SERVER_REC *server, REDIRECT_REC *rec)
 		signal_emit(rec->last_signal, 1, server);
 	}
 
-	server->redirect_active = g_slist_remove(server->redirect_active, rec);
+	if (rec->active) {
+		server->redirect_active =
+			g_slist_remove(server->redirect_active, rec);
+	}
+	if (rec->destroyed) {
+		server->redirect_destroyed =
+			g_slist_remove(server->redirect_destroyed, rec);
+	}
+	redirect_index_remove(server, rec);
 
 	server_redirect_destroy(rec);
 }
@@ -455,34 +581,67 @@ static void redirect_abort(IRC_SERVER_REC *server, REDIRECT_REC *rec)
 	((now-(rec)->created) > (rec)->cmd->timeout)
 
 
+/* Returns `rec' if the event starts or stops it */
+static REDIRECT_REC *redirect_try(REDIRECT_REC *rec, const char *event,
+				  const char *args, const char **signal,
+				  int *match)
+{
+        const char *match_signal;
+
+	/* already active, don't try to start it again */
+	if (rec->active)
+		return NULL;
+
+	match_signal = redirect_match(rec, event, args, match);
+	if (match_signal == NULL || *match == MATCH_NONE)
+		return NULL;
+
+	*signal = match_signal;
+	return rec;
+}
+
 static REDIRECT_REC *redirect_find(IRC_SERVER_REC *server, const char *event,
 				   const char *args, const char **signal,
 				   int *match)
 {
         REDIRECT_REC *redirect;
 	GSList *tmp, *next;
+	GList *link;
+	GQueue *queue;
 	time_t now;
-        const char *match_signal;
 
-	/* find the redirection */
 	*signal = NULL; redirect = NULL;
-	for (tmp = server->redirects; tmp != NULL; tmp = tmp->next) {
-		REDIRECT_REC *rec = tmp->data;
-
-		/* already active, don't try to start it again */
-		if (g_slist_find(server->redirect_active, rec) != NULL)
-			continue;
+	if (args == NULL) {
+		/* default signal can match any numeric */
+		for (tmp = server->redirects; tmp != NULL && redirect == NULL;
+		     tmp = tmp->next)
+			redirect = redirect_try(tmp->data, event, args,
+						signal, match);
+	} else {
+		/* only the redirections whose command knows about the
+		   event can be started or stopped by it */
+		queue = server->redirect_index == NULL ? NULL :
+			g_hash_table_lookup(server->redirect_index, event);
+		link = queue == NULL ? NULL : queue->head;
+		for (; link != NULL && redirect == NULL; link = link->next)
+			redirect = redirect_try(link->data, event, args,
+						signal, match);
+	}
 
-		match_signal = redirect_match(rec, event, args, match);
-		if (match_signal != NULL && *match != MATCH_NONE) {
-			redirect = rec;
-                        *signal = match_signal;
-			break;
-		}
+	/* remove the finished redirections, unless this was an optional
+	   event for it */
+	for (tmp = server->redirect_destroyed; tmp != NULL; tmp = next) {
+		next = tmp->next;
+		if (tmp->data != redirect)
+			redirect_abort(server, tmp->data);
 	}
 
-	/* remove the destroyed, non-remote and timeouted remote
-	   redirections that should have happened before this redirection */
+	if (redirect == NULL)
+		return NULL;
+
+	/* the redirections that should have happened before this one
+	   failed. remote ones that don't get aborted here are expired
+	   later by sig_redirect_timeout(). */
 	now = time(NULL);
 	for (tmp = server->redirects; tmp != NULL; tmp = next) {
 		REDIRECT_REC *rec = tmp->data;
@@ -491,23 +650,42 @@ static REDIRECT_REC *redirect_find(IRC_SERVER_REC *server, const char *event,
 			break;
 
 		next = tmp->next;
-		if (rec->destroyed) {
-                        /* redirection is finished, destroy it */
-			redirect_abort(server, rec);
-		} else if (redirect != NULL) {
-                        /* check if redirection failed */
-			if (rec->aborted ||
-			    rec->failures++ >= MAX_FAILURE_COUNT) {
-                                /* enough failures, abort it now */
-				if (!rec->remote || REDIRECT_IS_TIMEOUTED(rec))
-					redirect_abort(server, rec);
-			}
+		if (rec->aborted || rec->failures++ >= MAX_FAILURE_COUNT) {
+			/* enough failures, abort it now */
+			if (!rec->remote || REDIRECT_IS_TIMEOUTED(rec))
+				redirect_abort(server, rec);
 		}
 	}
 
         return redirect;
 }
 
+/* Abort the failed remote redirections whose time is up */
+static int sig_redirect_timeout(void)
+{
+	GSList *stmp, *tmp, *next;
+	time_t now;
+
+	now = time(NULL);
+	for (stmp = servers; stmp != NULL; stmp = stmp->next) {
+		IRC_SERVER_REC *server = IRC_SERVER(stmp->data);
+
+		if (server == NULL)
+			continue;
+
+		for (tmp = server->redirects; tmp != NULL; tmp = next) {
+			REDIRECT_REC *rec = tmp->data;
+
+			next = tmp->next;
+			if ((rec->aborted ||
+			     rec->failures > MAX_FAILURE_COUNT) &&
+			    REDIRECT_IS_TIMEOUTED(rec))
+				redirect_abort(server, rec);
+		}
+	}
+	return 1;
+}
+
 static const char *
 server_redirect_get(IRC_SERVER_REC *server, const char *prefix,
 		    const char *event, const char *args,
@@ -579,15 +757,24 @@ const char *server_redirect_get_signal(IRC_SERVER_REC *server,
 	if (redirect == NULL)
 		;
 	else if (match != MATCH_STOP) {
-		if (g_slist_find(server->redirect_active, redirect) == NULL)
+		if (!redirect->active) {
+			redirect->active = TRUE;
 			server->redirect_active = g_slist_prepend(server->redirect_active, redirect);
+		}
 	} else {
 		/* stop event - remove this redirection next time this
 		   function is called (can't destroy now or our return
 		   value would be corrupted) */
-                if (--redirect->count <= 0)
+		if (--redirect->count <= 0 && !redirect->destroyed) {
 			redirect->destroyed = TRUE;
-		server->redirect_active = g_slist_remove(server->redirect_active, redirect);
+			server->redirect_destroyed =
+				g_slist_prepend(server->redirect_destroyed,
+						redirect);
+		}
+		if (redirect->active) {
+			redirect->active = FALSE;
+			server->redirect_active = g_slist_remove(server->redirect_active, redirect);
+		}
 	}
 
         return signal;
@@ -615,6 +802,15 @@ static void sig_disconnected(IRC_SERVER_REC *server)
 
 	g_slist_free(server->redirect_active);
         server->redirect_active = NULL;
+	g_slist_free(server->redirect_destroyed);
+	server->redirect_destroyed = NULL;
+	if (server->redirect_index != NULL) {
+		g_hash_table_foreach(server->redirect_index,
+				     (GHFunc) redirect_index_destroy_queue,
+				     NULL);
+		g_hash_table_destroy(server->redirect_index);
+		server->redirect_index = NULL;
+	}
 	g_slist_foreach(server->redirects,
 			(GFunc) server_redirect_destroy, NULL);
 	g_slist_free(server->redirects);
@@ -634,6 +830,9 @@ static void cmd_redirect_destroy(char *key, REDIRECT_CMD_REC *cmd)
 void servers_redirect_init(void)
 {
 	command_redirects = g_hash_table_new((GHashFunc) g_str_hash, (GCompareFunc) g_str_equal);
+	redirect_timeout_tag = g_timeout_add(REDIRECT_TIMEOUT_CHECK,
+					     (GSourceFunc) sig_redirect_timeout,
+					     NULL);
 
 	/* WHOIS - register as remote command by default
 	   with a default timeout */
@@ -767,6 +966,7 @@ void servers_redirect_deinit(void)
 	g_hash_table_foreach(command_redirects,
 			     (GHFunc) cmd_redirect_destroy, NULL);
         g_hash_table_destroy(command_redirects);
+	g_source_remove(redirect_timeout_tag);
 
 	signal_remove("server disconnected", (SIGNAL_FUNC) sig_disconnected);
 }
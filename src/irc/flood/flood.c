@@ -32,79 +32,105 @@
 void autoignore_init(void);
 void autoignore_deinit(void);
 
+/* Max. number of nicks to keep track of per server, the least recently
+   active ones are forgotten first */
+#define FLOOD_MAX_NICKS 1000
+
 typedef struct {
 	char *target;
 	int level;
 
-	GSList *msgtimes;
+	/* ring buffer of the last `size' message times, `size' is
+	   flood_max_msgs+1 when the item was created */
+	int size, pos, count;
+	time_t msgtimes[1];
 } FLOOD_ITEM_REC;
 
 typedef struct {
 	char *nick;
         GSList *items;
+
+	GList *link; /* position in floodlru */
+	time_t last; /* last message received */
 } FLOOD_REC;
 
-static int flood_tag;
+static int flood_active;
 static int flood_max_msgs, flood_timecheck;
 
-static int flood_hash_check_remove(const char *key, FLOOD_REC *flood,
-				   time_t *now)
+static FLOOD_ITEM_REC *flood_item_create(int level, const char *target)
 {
-	GSList *tmp, *next, *times, *tnext;
+	FLOOD_ITEM_REC *rec;
+	int size;
 
-	g_return_val_if_fail(key != NULL, FALSE);
-	g_return_val_if_fail(flood != NULL, FALSE);
+	size = flood_max_msgs+1;
+	rec = g_malloc0(sizeof(FLOOD_ITEM_REC) + sizeof(time_t) * (size-1));
+	rec->level = level;
+	rec->target = g_strdup(target);
+	rec->size = size;
+	return rec;
+}
 
-	for (tmp = flood->items; tmp != NULL; tmp = next) {
-		FLOOD_ITEM_REC *rec = tmp->data;
+static void flood_item_destroy(FLOOD_ITEM_REC *rec)
+{
+	g_free(rec->target);
+	g_free(rec);
+}
 
-		next = tmp->next;
-		/* remove old time entries for current rec item */
-		for (times = rec->msgtimes; times != NULL; times = tnext) {
-                        time_t *data = times->data;
-			tnext = times->next;
-
-			if (*now-*((time_t *) times->data) >= flood_timecheck) {
-				rec->msgtimes = g_slist_remove(rec->msgtimes, data);
-				g_free(data);
-			}
-		}
-		/* if no more time entries remove rec item */
-		if (rec->msgtimes == NULL) {
-			flood->items = g_slist_remove(flood->items, rec);
-			g_free(rec->target);
-			g_free(rec);
-		}
-	}
+/* Returns TRUE if there hasn't been any messages for the item within
+   flood_timecheck seconds, or flood settings have changed since the
+   item was created */
+static int flood_item_expired(FLOOD_ITEM_REC *rec, time_t now)
+{
+	int last;
+
+	if (rec->count == 0 || rec->size != flood_max_msgs+1)
+		return TRUE;
 
-	if (flood->items != NULL)
-		return FALSE;
+	last = (rec->pos + rec->size - 1) % rec->size;
+	return now - rec->msgtimes[last] >= flood_timecheck;
+}
 
+/* Remember the message time. Returns TRUE if more than flood_max_msgs
+   messages have been received within flood_timecheck seconds */
+static int flood_item_add(FLOOD_ITEM_REC *rec, time_t now)
+{
+	rec->msgtimes[rec->pos] = now;
+	rec->pos = (rec->pos+1) % rec->size;
+	if (rec->count < rec->size)
+		rec->count++;
+
+	/* when the buffer is full, the oldest time is at `pos' */
+	return rec->count == rec->size &&
+		now - rec->msgtimes[rec->pos] < flood_timecheck;
+}
+
+static void flood_destroy(MODULE_SERVER_REC *mserver, FLOOD_REC *flood)
+{
+	g_hash_table_remove(mserver->floodlist, flood->nick);
+	g_queue_delete_link(&mserver->floodlru, flood->link);
+
+	g_slist_foreach(flood->items, (GFunc) flood_item_destroy, NULL);
+	g_slist_free(flood->items);
 	g_free(flood->nick);
 	g_free(flood);
-	return TRUE;
 }
 
-static int flood_timeout(void)
+/* Forget the nicks that haven't sent anything within flood_timecheck
+   seconds. The least recently active nicks are at the start of the
+   queue, so we can stop at the first one that's still active. */
+static void flood_expire(MODULE_SERVER_REC *mserver, time_t now)
 {
-	MODULE_SERVER_REC *mserver;
-	GSList *tmp;
-	time_t now;
+	FLOOD_REC *flood;
 
-	/* remove the old people from flood lists */
-	now = time(NULL);
-	for (tmp = servers; tmp != NULL; tmp = tmp->next) {
-		IRC_SERVER_REC *rec = tmp->data;
+	while (mserver->floodlru.head != NULL) {
+		flood = mserver->floodlru.head->data;
 
-		if (!IS_IRC_SERVER(rec))
-                        continue;
+		if (now - flood->last < flood_timecheck &&
+		    mserver->floodlru.length <= FLOOD_MAX_NICKS)
+			break;
 
-		mserver = MODULE_DATA(rec);
-		g_hash_table_foreach_remove(mserver->floodlist,
-					    (GHRFunc) flood_hash_check_remove,
-					    &now);
+		flood_destroy(mserver, flood);
 	}
-	return 1;
 }
 
 /* Initialize flood protection */
@@ -124,23 +150,6 @@ static void flood_init_server(IRC_SERVER_REC *server)
 					  (GCompareFunc) g_istr_equal);
 }
 
-static void flood_hash_destroy(const char *key, FLOOD_REC *flood)
-{
-	while (flood->items != NULL) {
-		FLOOD_ITEM_REC *rec = flood->items->data;
-
-		flood->items = g_slist_remove(flood->items, rec);
-
-		g_slist_foreach(rec->msgtimes, (GFunc) g_free, NULL);
-		g_slist_free(rec->msgtimes);
-		g_free(rec->target);
-		g_free(rec);
-	}
-
-	g_free(flood->nick);
-	g_free(flood);
-}
-
 /* Deinitialize flood protection */
 static void flood_deinit_server(IRC_SERVER_REC *server)
 {
@@ -153,10 +162,8 @@ static void flood_deinit_server(IRC_SERVER_REC *server)
 
 	mserver = MODULE_DATA(server);
 	if (mserver != NULL && mserver->floodlist != NULL) {
-		flood_timecheck = 0;
-
-		g_hash_table_foreach(mserver->floodlist,
-				     (GHFunc) flood_hash_destroy, NULL);
+		while (mserver->floodlru.head != NULL)
+			flood_destroy(mserver, mserver->floodlru.head->data);
 		g_hash_table_destroy(mserver->floodlist);
 	}
 	g_free(mserver);
@@ -164,16 +171,24 @@ static void flood_deinit_server(IRC_SERVER_REC *server)
 }
 
 static FLOOD_ITEM_REC *flood_find(FLOOD_REC *flood, int level,
-				  const char *target)
+				  const char *target, time_t now)
 {
-	GSList *tmp;
+	GSList *tmp, *next;
 
-	for (tmp = flood->items; tmp != NULL; tmp = tmp->next) {
+	for (tmp = flood->items; tmp != NULL; tmp = next) {
 		FLOOD_ITEM_REC *rec = tmp->data;
 
+		next = tmp->next;
 		if (rec->level == level &&
-		    g_strcasecmp(rec->target, target) == 0)
-			return rec;
+		    g_strcasecmp(rec->target, target) == 0) {
+			if (!flood_item_expired(rec, now))
+				return rec;
+		} else if (!flood_item_expired(rec, now))
+			continue;
+
+		/* drop the old items while we're at it */
+		flood->items = g_slist_remove(flood->items, rec);
+		flood_item_destroy(rec);
 	}
 
 	return NULL;
@@ -186,54 +201,43 @@ static void flood_newmsg(IRC_SERVER_REC *server, int level, const char *nick,
 	MODULE_SERVER_REC *mserver;
 	FLOOD_REC *flood;
 	FLOOD_ITEM_REC *rec;
-	time_t now, *ttime;
-	GSList *times, *tnext;
+	time_t now;
+	int flooding;
 
 	g_return_if_fail(server != NULL);
 	g_return_if_fail(nick != NULL);
 
+	now = time(NULL);
 	mserver = MODULE_DATA(server);
 	flood = g_hash_table_lookup(mserver->floodlist, nick);
 
-	rec = flood == NULL ? NULL : flood_find(flood, level, target);
-	if (rec != NULL) {
-		now = time(NULL);
-		for (times = rec->msgtimes; times != NULL; times = tnext) {
-			time_t *data = times->data;
-			tnext = times->next;
-
-			if (now - *data >= flood_timecheck) {
-				rec->msgtimes = g_slist_remove(rec->msgtimes, data);
-				g_free(data);
-			} else
-				break;
-		}
-		ttime = g_new(time_t, 1);
-		*ttime = now;
-		rec->msgtimes = g_slist_append(rec->msgtimes, ttime);
-		if (g_slist_length(rec->msgtimes) > flood_max_msgs) {
-			/* flooding! */
-			signal_emit("flood", 5, server, nick, host,
-				    GINT_TO_POINTER(rec->level), target);
-		}
-		return;
-	}
-
 	if (flood == NULL) {
 		flood = g_new0(FLOOD_REC, 1);
 		flood->nick = g_strdup(nick);
 		g_hash_table_insert(mserver->floodlist, flood->nick, flood);
+
+		g_queue_push_tail(&mserver->floodlru, flood);
+		flood->link = mserver->floodlru.tail;
+	} else {
+		/* move to the end of the queue as most recently active */
+		g_queue_unlink(&mserver->floodlru, flood->link);
+		g_queue_push_tail_link(&mserver->floodlru, flood->link);
 	}
+	flood->last = now;
 
-	rec = g_new0(FLOOD_ITEM_REC, 1);
-	rec->level = level;
-	rec->msgtimes = NULL;
-	ttime = g_new(time_t, 1);
-	*ttime = time(NULL);
-	rec->msgtimes = g_slist_append(rec->msgtimes, ttime);
-	rec->target = g_strdup(target);
+	rec = flood_find(flood, level, target, now);
+	if (rec == NULL) {
+		rec = flood_item_create(level, target);
+		flood->items = g_slist_prepend(flood->items, rec);
+	}
+	flooding = flood_item_add(rec, now);
+
+	flood_expire(mserver, now);
 
-	flood->items = g_slist_append(flood->items, rec);
+	if (flooding) {
+		signal_emit("flood", 5, server, nick, host,
+			    GINT_TO_POINTER(level), target);
+	}
 }
 
 static void flood_privmsg(IRC_SERVER_REC *server, const char *data,
@@ -298,16 +302,15 @@ static void read_settings(void)
 	flood_max_msgs = settings_get_int("flood_max_msgs");
 
 	if (flood_timecheck > 0 && flood_max_msgs > 0) {
-		if (flood_tag == -1) {
-			flood_tag = g_timeout_add(5000, (GSourceFunc) flood_timeout, NULL);
+		if (!flood_active) {
+			flood_active = TRUE;
 
 			signal_add("event privmsg", (SIGNAL_FUNC) flood_privmsg);
 			signal_add("event notice", (SIGNAL_FUNC) flood_notice);
 			signal_add("ctcp msg", (SIGNAL_FUNC) flood_ctcp);
 		}
-	} else if (flood_tag != -1) {
-		g_source_remove(flood_tag);
-		flood_tag = -1;
+	} else if (flood_active) {
+		flood_active = FALSE;
 
 		signal_remove("event privmsg", (SIGNAL_FUNC) flood_privmsg);
 		signal_remove("event notice", (SIGNAL_FUNC) flood_notice);
@@ -320,7 +323,7 @@ void irc_flood_init(void)
 	settings_add_int("flood", "flood_timecheck", 8);
 	settings_add_int("flood", "flood_max_msgs", 4);
 
-	flood_tag = -1;
+	flood_active = FALSE;
 	read_settings();
 	signal_add("setup changed", (SIGNAL_FUNC) read_settings);
 	signal_add_first("server connected", (SIGNAL_FUNC) flood_init_server);
@@ -335,8 +338,7 @@ void irc_flood_deinit(void)
 {
 	autoignore_deinit();
 
-	if (flood_tag != -1) {
-		g_source_remove(flood_tag);
+	if (flood_active) {
 		signal_remove("event privmsg", (SIGNAL_FUNC) flood_privmsg);
 		signal_remove("event notice", (SIGNAL_FUNC) flood_notice);
 		signal_remove("ctcp msg", (SIGNAL_FUNC) flood_ctcp);
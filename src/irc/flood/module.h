@@ -4,6 +4,7 @@
 typedef struct {
 	/* Flood protection */
 	GHashTable *floodlist;
+	GQueue floodlru; /* FLOOD_RECs, least recently active first */
 
 	/* Auto ignore list */
 	GSList *ignorelist;
@@ -16,11 +16,25 @@ typedef struct {
 	time_t last_whois;
 } NOTIFY_NICK_REC;
 
+enum {
+	NOTIFY_METHOD_UNKNOWN, /* ISUPPORT not checked yet */
+	NOTIFY_METHOD_ISON, /* poll with /ISON */
+	NOTIFY_METHOD_MONITOR, /* server pushes 730/731 */
+	NOTIFY_METHOD_WATCH /* server pushes 600/601 */
+};
+
 typedef struct {
 	int ison_count; /* number of ISON requests sent */
+	int method; /* NOTIFY_METHOD_xxx */
 
 	GSList *notify_users; /* NOTIFY_NICK_REC's of notifylist people who are in IRC */
+	GHashTable *notify_users_hash; /* nick -> NOTIFY_NICK_REC */
 	GSList *ison_tempusers; /* Temporary list for saving /ISON events.. */
+
+	GHashTable *nicks; /* nicks in notifylist for this server's chatnet */
+	GHashTable *visible; /* nicks in our channels -> number of them */
+	GSList *ison_cmds; /* "ISON :nick1 nick2 .." lines for the rest */
+	unsigned int ison_cmds_dirty:1; /* ison_cmds needs to be rebuilt */
 } MODULE_SERVER_REC;
 
 #include "irc-servers.h"
@@ -30,6 +44,8 @@ void notify_nick_destroy(NOTIFY_NICK_REC *rec);
 NOTIFY_NICK_REC *notify_nick_find(IRC_SERVER_REC *server, const char *nick);
 
 void notifylist_left(IRC_SERVER_REC *server, NOTIFY_NICK_REC *rec);
+void notifylist_server_sync(IRC_SERVER_REC *server);
+void notifylist_server_deinit(IRC_SERVER_REC *server);
 void notifylist_destroy_all(void);
 
 void notifylist_commands_init(void);
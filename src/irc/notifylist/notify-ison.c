@@ -26,6 +26,7 @@
 #include "irc.h"
 #include "irc-servers.h"
 #include "servers-redirect.h"
+#include "nicklist.h"
 
 #include "notifylist.h"
 
@@ -46,6 +47,7 @@ NOTIFY_NICK_REC *notify_nick_create(IRC_SERVER_REC *server, const char *nick)
 	rec->nick = g_strdup(nick);
 
 	mserver->notify_users = g_slist_append(mserver->notify_users, rec);
+	g_hash_table_insert(mserver->notify_users_hash, rec->nick, rec);
 	return rec;
 }
 
@@ -62,59 +64,188 @@ void notify_nick_destroy(NOTIFY_NICK_REC *rec)
 NOTIFY_NICK_REC *notify_nick_find(IRC_SERVER_REC *server, const char *nick)
 {
 	MODULE_SERVER_REC *mserver;
-	NOTIFY_NICK_REC *rec;
-	GSList *tmp;
 
 	mserver = MODULE_DATA(server);
-	for (tmp = mserver->notify_users; tmp != NULL; tmp = tmp->next) {
-		rec = tmp->data;
+	return g_hash_table_lookup(mserver->notify_users_hash, nick);
+}
+
+/* Build "<cmd><prefix>nick1<sep><prefix>nick2.." lines that fit in
+   one IRC command */
+static GSList *nick_cmds_build(const char *cmd, const char *prefix,
+			       char sep, GSList *nicks)
+{
+	GSList *tmp, *cmds;
+	GString *str;
+	int cmdlen, len;
+
+	cmds = NULL;
+	cmdlen = strlen(cmd);
+	str = g_string_new(NULL);
+	for (tmp = nicks; tmp != NULL; tmp = tmp->next) {
+		const char *nick = tmp->data;
 
-		if (g_strcasecmp(rec->nick, nick) == 0)
-			return rec;
+		len = strlen(prefix) + strlen(nick) + 1;
+		if (str->len > 0 && cmdlen+str->len+len > 510) {
+			cmds = g_slist_prepend(cmds, g_strconcat(cmd, str->str, NULL));
+			g_string_truncate(str, 0);
+		}
+
+		if (str->len > 0) g_string_append_c(str, sep);
+		g_string_append(str, prefix);
+		g_string_append(str, nick);
 	}
 
-	return NULL;
+	if (str->len > 0)
+		cmds = g_slist_prepend(cmds, g_strconcat(cmd, str->str, NULL));
+	g_string_free(str, TRUE);
+	return g_slist_reverse(cmds);
 }
 
-static void ison_send(IRC_SERVER_REC *server, GString *cmd)
+static void nick_cmds_send(IRC_SERVER_REC *server, GSList *cmds)
+{
+	GSList *tmp;
+
+	for (tmp = cmds; tmp != NULL; tmp = tmp->next)
+		irc_send_cmd(server, tmp->data);
+
+	g_slist_foreach(cmds, (GFunc) g_free, NULL);
+	g_slist_free(cmds);
+}
+
+/* add or remove nicks from the server side MONITOR or WATCH list */
+static void notify_list_send(IRC_SERVER_REC *server, GSList *nicks, int add)
 {
 	MODULE_SERVER_REC *mserver;
+	GSList *cmds;
+
+	if (nicks == NULL)
+		return;
 
 	mserver = MODULE_DATA(server);
-	mserver->ison_count++;
+	switch (mserver->method) {
+	case NOTIFY_METHOD_MONITOR:
+		cmds = nick_cmds_build(add ? "MONITOR + " : "MONITOR - ",
+				       "", ',', nicks);
+		break;
+	case NOTIFY_METHOD_WATCH:
+		cmds = nick_cmds_build("WATCH ", add ? "+" : "-", ' ', nicks);
+		break;
+	default:
+		return;
+	}
 
-	g_string_truncate(cmd, cmd->len-1);
-	g_string_prepend(cmd, "ISON :");
+	nick_cmds_send(server, cmds);
+}
 
-	server_redirect_event(server, "ison", 1, NULL, -1, NULL,
-			      "event 303", "notifylist event", NULL);
-	irc_send_cmd(server, cmd->str);
+static void ison_cmds_free(MODULE_SERVER_REC *mserver)
+{
+	g_slist_foreach(mserver->ison_cmds, (GFunc) g_free, NULL);
+	g_slist_free(mserver->ison_cmds);
+	mserver->ison_cmds = NULL;
+}
 
-	g_string_truncate(cmd, 0);
+static void nick_get(char *nick, void *value, GSList **list)
+{
+	*list = g_slist_prepend(*list, nick);
 }
 
-/* timeout function: send /ISON commands to server to check if someone in
-   notify list is in IRC */
-static void notifylist_timeout_server(IRC_SERVER_REC *server)
+static void ison_nick_get(char *nick, void *value, void **data)
 {
-	MODULE_SERVER_REC *mserver;
-	GSList *tmp;
-	GString *cmd;
-	char *nick, *ptr;
-	int len;
+	MODULE_SERVER_REC *mserver = data[0];
+	GSList **list = data[1];
 
-	g_return_if_fail(server != NULL);
+	if (g_hash_table_lookup(mserver->visible, nick) == NULL)
+		*list = g_slist_prepend(*list, nick);
+}
 
-	if (!IS_IRC_SERVER(server))
+/* ISON only the nicks that aren't in any of our channels */
+static void ison_cmds_update(MODULE_SERVER_REC *mserver)
+{
+	GSList *nicks;
+	void *data[2];
+
+	ison_cmds_free(mserver);
+	mserver->ison_cmds_dirty = FALSE;
+	if (mserver->nicks == NULL)
 		return;
 
+	nicks = NULL;
+	data[0] = mserver;
+	data[1] = &nicks;
+	g_hash_table_foreach(mserver->nicks, (GHFunc) ison_nick_get, data);
+	mserver->ison_cmds = nick_cmds_build("ISON :", "", ' ', nicks);
+	g_slist_free(nicks);
+}
+
+/* `diff' more (or less) nicks named `nick' are now in our channels */
+static void visible_nick_update(IRC_SERVER_REC *server, const char *nick,
+				int diff)
+{
+	MODULE_SERVER_REC *mserver;
+	void *key, *value;
+	int count;
+
 	mserver = MODULE_DATA(server);
-	if (mserver->ison_count > 0) {
-		/* still not received all replies to previous /ISON commands.. */
+	if (mserver == NULL || mserver->visible == NULL ||
+	    !g_hash_table_lookup_extended(mserver->nicks, nick, &key, &value))
 		return;
+
+	count = GPOINTER_TO_INT(g_hash_table_lookup(mserver->visible, key));
+	if (count + diff > 0) {
+		g_hash_table_insert(mserver->visible, key,
+				    GINT_TO_POINTER(count + diff));
+	} else {
+		g_hash_table_remove(mserver->visible, key);
+	}
+
+	if ((count > 0) != (count + diff > 0))
+		mserver->ison_cmds_dirty = TRUE;
+}
+
+/* count the notify nicks in our channels from scratch, only needed
+   when the notify nicks have changed */
+static void visible_nicks_rebuild(IRC_SERVER_REC *server)
+{
+	MODULE_SERVER_REC *mserver;
+	GSList *tmp, *nicks;
+	NICK_REC *nickrec;
+
+	mserver = MODULE_DATA(server);
+	if (mserver->visible != NULL)
+		g_hash_table_destroy(mserver->visible);
+	mserver->visible = g_hash_table_new((GHashFunc) g_istr_hash,
+					    (GCompareFunc) g_istr_equal);
+
+	nicks = NULL;
+	g_hash_table_foreach(mserver->nicks, (GHFunc) nick_get, &nicks);
+	for (; nicks != NULL; nicks = g_slist_delete_link(nicks, nicks)) {
+		for (tmp = server->channels; tmp != NULL; tmp = tmp->next) {
+			nickrec = nicklist_find(tmp->data, nicks->data);
+			for (; nickrec != NULL; nickrec = nickrec->next)
+				visible_nick_update(server, nicks->data, 1);
+		}
 	}
+	mserver->ison_cmds_dirty = TRUE;
+}
 
-	cmd = g_string_new(NULL);
+static void nicks_hash_destroy(GHashTable *nicks)
+{
+	if (nicks == NULL)
+		return;
+
+	g_hash_table_foreach(nicks, (GHFunc) g_free, NULL);
+	g_hash_table_destroy(nicks);
+}
+
+/* nick parts of the notifylist masks that apply to this server */
+static GHashTable *notify_server_nicks(IRC_SERVER_REC *server)
+{
+	GHashTable *nicks;
+	GSList *tmp;
+	char *nick, *ptr;
+
+	nicks = g_hash_table_new((GHashFunc) g_istr_hash,
+				 (GCompareFunc) g_istr_equal);
 	for (tmp = notifies; tmp != NULL; tmp = tmp->next) {
 		NOTIFYLIST_REC *rec = tmp->data;
 
@@ -125,24 +256,95 @@ static void notifylist_timeout_server(IRC_SERVER_REC *server)
 		ptr = strchr(nick, '!');
 		if (ptr != NULL) *ptr = '\0';
 
-		len = strlen(nick);
+		if (*nick == '\0' || g_hash_table_lookup(nicks, nick) != NULL)
+			g_free(nick);
+		else
+			g_hash_table_insert(nicks, nick, nick);
+	}
+
+	return nicks;
+}
+
+static GSList *nicks_hash_diff(GHashTable *nicks, GHashTable *other)
+{
+	GSList *tmp, *keys, *diff;
+
+	diff = NULL;
+	keys = NULL;
+	g_hash_table_foreach(nicks, (GHFunc) nick_get, &keys);
+	for (tmp = keys; tmp != NULL; tmp = tmp->next) {
+		if (other == NULL || g_hash_table_lookup(other, tmp->data) == NULL)
+			diff = g_slist_prepend(diff, tmp->data);
+	}
+	g_slist_free(keys);
+	return diff;
+}
+
+/* Update the server's notify nicks after notifylist has changed. Only
+   the changed nicks are sent to MONITOR/WATCH lists. */
+void notifylist_server_sync(IRC_SERVER_REC *server)
+{
+	MODULE_SERVER_REC *mserver;
+	NOTIFY_NICK_REC *rec;
+	GHashTable *nicks;
+	GSList *tmp, *added, *removed;
+
+	mserver = MODULE_DATA(server);
+	if (mserver == NULL || mserver->method == NOTIFY_METHOD_UNKNOWN)
+		return;
+
+	nicks = notify_server_nicks(server);
+	added = nicks_hash_diff(nicks, mserver->nicks);
+	removed = mserver->nicks == NULL ? NULL :
+		nicks_hash_diff(mserver->nicks, nicks);
 
-		if (cmd->len+len+1 > 510)
-                        ison_send(server, cmd);
+	notify_list_send(server, removed, FALSE);
+	notify_list_send(server, added, TRUE);
 
-		g_string_append_printf(cmd, "%s ", nick);
-		g_free(nick);
+	for (tmp = removed; tmp != NULL; tmp = tmp->next) {
+		rec = notify_nick_find(server, tmp->data);
+		if (rec != NULL) notifylist_left(server, rec);
 	}
+	g_slist_free(added);
+	g_slist_free(removed);
 
-	if (cmd->len > 0)
-		ison_send(server, cmd);
-	g_string_free(cmd, TRUE);
+	if (mserver->visible != NULL) {
+		g_hash_table_destroy(mserver->visible);
+		mserver->visible = NULL;
+	}
+	nicks_hash_destroy(mserver->nicks);
+	mserver->nicks = nicks;
+	visible_nicks_rebuild(server);
 }
 
-static int notifylist_timeout_func(void)
+static int isupport_limit(IRC_SERVER_REC *server, const char *key)
 {
-	g_slist_foreach(servers, (GFunc) notifylist_timeout_server, NULL);
-	return 1;
+	const char *value;
+
+	value = g_hash_table_lookup(server->isupport, key);
+	if (value == NULL)
+		return -1;
+
+	return *value == '\0' ? 0 : atoi(value);
+}
+
+void notifylist_server_deinit(IRC_SERVER_REC *server)
+{
+	MODULE_SERVER_REC *mserver;
+
+	mserver = MODULE_DATA(server);
+
+	g_slist_foreach(mserver->ison_tempusers, (GFunc) g_free, NULL);
+	g_slist_free(mserver->ison_tempusers);
+	mserver->ison_tempusers = NULL;
+
+	ison_cmds_free(mserver);
+	if (mserver->visible != NULL) {
+		g_hash_table_destroy(mserver->visible);
+		mserver->visible = NULL;
+	}
+	nicks_hash_destroy(mserver->nicks);
+	mserver->nicks = NULL;
 }
 
 static void ison_save_users(MODULE_SERVER_REC *mserver, char *online)
@@ -154,7 +356,7 @@ static void ison_save_users(MODULE_SERVER_REC *mserver, char *online)
 		if (ptr != NULL) *ptr++ = '\0';
 
 		mserver->ison_tempusers =
-			g_slist_append(mserver->ison_tempusers, g_strdup(online));
+			g_slist_prepend(mserver->ison_tempusers, g_strdup(online));
 		online = ptr;
 	}
 }
@@ -224,24 +426,23 @@ static void whois_list_send(IRC_SERVER_REC *server, GSList *nicks)
 	g_string_free(str, TRUE);
 }
 
-static void ison_check_joins(IRC_SERVER_REC *server)
+/* `nicks' are online, WHOIS the ones we don't know about yet */
+static void notify_check_joins(IRC_SERVER_REC *server, GSList *nicks)
 {
-	MODULE_SERVER_REC *mserver;
 	NOTIFYLIST_REC *notify;
 	NOTIFY_NICK_REC *rec;
 	GSList *tmp, *newnicks;
 	int send_whois;
 	time_t now;
 
-	mserver = MODULE_DATA(server);
-
 	now = time(NULL);
 	newnicks = NULL;
-	for (tmp = mserver->ison_tempusers; tmp != NULL; tmp = tmp->next) {
+	for (tmp = nicks; tmp != NULL; tmp = tmp->next) {
 		char *nick = tmp->data;
 
 		notify = notifylist_find(nick, server->connrec->chatnet);
-		send_whois = notify != NULL && notify->away_check;
+		if (notify == NULL) continue;
+		send_whois = notify->away_check;
 
 		rec = notify_nick_find(server, nick);
 		if (rec != NULL) {
@@ -250,7 +451,7 @@ static void ison_check_joins(IRC_SERVER_REC *server)
 				continue;
 		} else {
 			rec = notify_nick_create(server, nick);
-			if (!send_whois) newnicks = g_slist_append(newnicks, nick);
+			if (!send_whois) newnicks = g_slist_prepend(newnicks, nick);
 		}
 
 		if (send_whois) {
@@ -265,7 +466,8 @@ static void ison_check_joins(IRC_SERVER_REC *server)
 	g_slist_free(newnicks);
 }
 
-static void ison_check_parts(IRC_SERVER_REC *server)
+/* notify users that are neither in `online' nor in our channels left */
+static void ison_check_parts(IRC_SERVER_REC *server, GHashTable *online)
 {
 	MODULE_SERVER_REC *mserver;
 	GSList *tmp, *next;
@@ -275,13 +477,43 @@ static void ison_check_parts(IRC_SERVER_REC *server)
 		NOTIFY_NICK_REC *rec = tmp->data;
 		next = tmp->next;
 
-		if (gslist_find_icase_string(mserver->ison_tempusers, rec->nick) != NULL)
+		if (g_hash_table_lookup(online, rec->nick) != NULL ||
+		    g_hash_table_lookup(mserver->visible, rec->nick) != NULL)
 			continue;
 
                 notifylist_left(server, rec);
 	}
 }
 
+/* all the /ISON replies received, ison_tempusers has the online nicks
+   that weren't in our channels */
+static void ison_check_done(IRC_SERVER_REC *server)
+{
+	MODULE_SERVER_REC *mserver;
+	GHashTable *online;
+	GSList *tmp, *visible;
+
+	mserver = MODULE_DATA(server);
+	notify_check_joins(server, mserver->ison_tempusers);
+
+	visible = NULL;
+	g_hash_table_foreach(mserver->visible, (GHFunc) nick_get, &visible);
+	notify_check_joins(server, visible);
+	g_slist_free(visible);
+
+	online = g_hash_table_new((GHashFunc) g_istr_hash,
+				  (GCompareFunc) g_istr_equal);
+	for (tmp = mserver->ison_tempusers; tmp != NULL; tmp = tmp->next)
+		g_hash_table_insert(online, tmp->data, tmp->data);
+	ison_check_parts(server, online);
+	g_hash_table_destroy(online);
+
+	/* free memory used by temp list */
+	g_slist_foreach(mserver->ison_tempusers, (GFunc) g_free, NULL);
+	g_slist_free(mserver->ison_tempusers);
+	mserver->ison_tempusers = NULL;
+}
+
 static void event_ison(IRC_SERVER_REC *server, const char *data)
 {
 	MODULE_SERVER_REC *mserver;
@@ -295,23 +527,268 @@ static void event_ison(IRC_SERVER_REC *server, const char *data)
 	mserver = MODULE_DATA(server);
 	ison_save_users(mserver, online);
 
-	if (--mserver->ison_count > 0) {
-		/* wait for the rest of the /ISON replies */
-		g_free(params);
-                return;
+	if (--mserver->ison_count == 0)
+		ison_check_done(server);
+	/* else wait for the rest of the /ISON replies */
+
+	g_free(params);
+}
+
+static void ison_send(IRC_SERVER_REC *server, const char *cmd)
+{
+	MODULE_SERVER_REC *mserver;
+
+	mserver = MODULE_DATA(server);
+	mserver->ison_count++;
+
+	server_redirect_event(server, "ison", 1, NULL, -1, NULL,
+			      "event 303", "notifylist event", NULL);
+	irc_send_cmd(server, cmd);
+}
+
+static void ison_send_all(IRC_SERVER_REC *server)
+{
+	MODULE_SERVER_REC *mserver;
+	GSList *tmp;
+
+	mserver = MODULE_DATA(server);
+	if (mserver->ison_count > 0 || mserver->visible == NULL) {
+		/* still not received all replies to previous /ISON commands.. */
+		return;
 	}
 
-        ison_check_joins(server);
-        ison_check_parts(server);
+	if (mserver->ison_cmds_dirty)
+		ison_cmds_update(mserver);
 
-	/* free memory used by temp list */
-	g_slist_foreach(mserver->ison_tempusers, (GFunc) g_free, NULL);
-	g_slist_free(mserver->ison_tempusers);
-	mserver->ison_tempusers = NULL;
+	for (tmp = mserver->ison_cmds; tmp != NULL; tmp = tmp->next)
+		ison_send(server, tmp->data);
+
+	if (mserver->ison_count == 0) {
+		/* all the nicks are in our channels */
+		ison_check_done(server);
+	}
+}
+
+/* ISUPPORT is known now, choose how to track the notifylist nicks */
+static void notifylist_server_init(IRC_SERVER_REC *server)
+{
+	MODULE_SERVER_REC *mserver;
+	GHashTable *nicks;
+	int count, limit;
+
+	mserver = MODULE_DATA(server);
+	if (mserver == NULL || mserver->method != NOTIFY_METHOD_UNKNOWN)
+		return;
+
+	nicks = notify_server_nicks(server);
+	count = g_hash_table_size(nicks);
+	nicks_hash_destroy(nicks);
+
+	/* limit 0 = no limit */
+	mserver->method = NOTIFY_METHOD_ISON;
+	if ((limit = isupport_limit(server, "MONITOR")) >= 0) {
+		if (limit == 0 || count <= limit)
+			mserver->method = NOTIFY_METHOD_MONITOR;
+	} else if ((limit = isupport_limit(server, "WATCH")) >= 0) {
+		if (limit == 0 || count <= limit)
+			mserver->method = NOTIFY_METHOD_WATCH;
+	}
+
+	notifylist_server_sync(server);
+	if (mserver->method == NOTIFY_METHOD_ISON)
+		ison_send_all(server);
+}
+
+/* timeout function: send /ISON commands to server to check if someone in
+   notify list is in IRC. With MONITOR and WATCH the server tells us
+   about the changes, only the away status needs to be polled. */
+static void notifylist_timeout_server(IRC_SERVER_REC *server)
+{
+	MODULE_SERVER_REC *mserver;
+	GSList *tmp, *nicks;
+
+	g_return_if_fail(server != NULL);
+
+	if (!IS_IRC_SERVER(server))
+		return;
+
+	mserver = MODULE_DATA(server);
+	if (mserver == NULL)
+		return;
+
+	if (mserver->method == NOTIFY_METHOD_UNKNOWN) {
+		notifylist_server_init(server);
+		return;
+	}
+
+	if (mserver->method != NOTIFY_METHOD_ISON) {
+		nicks = NULL;
+		for (tmp = mserver->notify_users; tmp != NULL; tmp = tmp->next) {
+			NOTIFY_NICK_REC *rec = tmp->data;
+
+			nicks = g_slist_prepend(nicks, rec->nick);
+		}
+		notify_check_joins(server, nicks);
+		g_slist_free(nicks);
+		return;
+	}
+
+	ison_send_all(server);
+}
+
+static int notifylist_timeout_func(void)
+{
+	g_slist_foreach(servers, (GFunc) notifylist_timeout_server, NULL);
+	return 1;
+}
+
+/* "nick!user@host,nick2!user@host" -> list of nicks, modifies `list' */
+static GSList *monitor_get_nicks(char *list)
+{
+	GSList *nicks;
+	char *ptr;
+
+	nicks = NULL;
+	while (list != NULL && *list != '\0') {
+		ptr = strchr(list, ',');
+		if (ptr != NULL) *ptr++ = '\0';
+
+		nicks = g_slist_prepend(nicks, list);
+		list = strchr(list, '!');
+		if (list != NULL) *list = '\0';
+		list = ptr;
+	}
+
+	return nicks;
+}
+
+static void notify_nick_offline(IRC_SERVER_REC *server, const char *nick)
+{
+	NOTIFY_NICK_REC *rec;
+
+	rec = notify_nick_find(server, nick);
+	if (rec != NULL) notifylist_left(server, rec);
+}
+
+static void event_mononline(IRC_SERVER_REC *server, const char *data)
+{
+	GSList *nicks;
+	char *params, *list;
+
+	g_return_if_fail(data != NULL);
+
+	if (MODULE_DATA(server) == NULL)
+		return;
+
+	params = event_get_params(data, 2, NULL, &list);
+	nicks = monitor_get_nicks(list);
+	notify_check_joins(server, nicks);
+	g_slist_free(nicks);
+	g_free(params);
+}
+
+static void event_monoffline(IRC_SERVER_REC *server, const char *data)
+{
+	GSList *nicks, *tmp;
+	char *params, *list;
+
+	g_return_if_fail(data != NULL);
+
+	if (MODULE_DATA(server) == NULL)
+		return;
+
+	params = event_get_params(data, 2, NULL, &list);
+	nicks = monitor_get_nicks(list);
+	for (tmp = nicks; tmp != NULL; tmp = tmp->next)
+		notify_nick_offline(server, tmp->data);
+	g_slist_free(nicks);
+	g_free(params);
+}
+
+/* MONITOR list is full - fall back to ISON */
+static void event_monlistfull(IRC_SERVER_REC *server, const char *data)
+{
+	MODULE_SERVER_REC *mserver;
+
+	mserver = MODULE_DATA(server);
+	if (mserver == NULL || mserver->method != NOTIFY_METHOD_MONITOR)
+		return;
+
+	irc_send_cmd(server, "MONITOR C");
+	mserver->method = NOTIFY_METHOD_ISON;
+	mserver->ison_cmds_dirty = TRUE;
+	ison_send_all(server);
+}
+
+static void event_watch_online(IRC_SERVER_REC *server, const char *data)
+{
+	GSList *nicks;
+	char *params, *nick;
 
+	g_return_if_fail(data != NULL);
+
+	if (MODULE_DATA(server) == NULL)
+		return;
+
+	params = event_get_params(data, 2, NULL, &nick);
+	nicks = g_slist_append(NULL, nick);
+	notify_check_joins(server, nicks);
+	g_slist_free(nicks);
+	g_free(params);
+}
+
+static void event_watch_offline(IRC_SERVER_REC *server, const char *data)
+{
+	char *params, *nick;
+
+	g_return_if_fail(data != NULL);
+
+	if (MODULE_DATA(server) == NULL)
+		return;
+
+	params = event_get_params(data, 2, NULL, &nick);
+	notify_nick_offline(server, nick);
 	g_free(params);
 }
 
+static void sig_end_of_motd(IRC_SERVER_REC *server)
+{
+	if (IS_IRC_SERVER(server))
+		notifylist_server_init(server);
+}
+
+static void sig_notifylist_changed(void)
+{
+	GSList *tmp;
+
+	for (tmp = servers; tmp != NULL; tmp = tmp->next) {
+		if (IS_IRC_SERVER(tmp->data))
+			notifylist_server_sync(tmp->data);
+	}
+}
+
+static void sig_nicklist_new(CHANNEL_REC *channel, NICK_REC *nick)
+{
+	if (IS_IRC_SERVER(channel->server))
+		visible_nick_update(IRC_SERVER(channel->server), nick->nick, 1);
+}
+
+/* also called for all the nicks when we leave the channel */
+static void sig_nicklist_remove(CHANNEL_REC *channel, NICK_REC *nick)
+{
+	if (IS_IRC_SERVER(channel->server))
+		visible_nick_update(IRC_SERVER(channel->server), nick->nick, -1);
+}
+
+static void sig_nicklist_changed(CHANNEL_REC *channel, NICK_REC *nick,
+				 const char *oldnick)
+{
+	if (IS_IRC_SERVER(channel->server)) {
+		visible_nick_update(IRC_SERVER(channel->server), oldnick, -1);
+		visible_nick_update(IRC_SERVER(channel->server), nick->nick, 1);
+	}
+}
+
 static void read_settings(void)
 {
 	if (notify_tag != -1) g_source_remove(notify_tag);
@@ -330,6 +807,21 @@ void notifylist_ison_init(void)
 	read_settings();
 
 	signal_add("notifylist event", (SIGNAL_FUNC) event_ison);
+	signal_add("event 730", (SIGNAL_FUNC) event_mononline);
+	signal_add("event 731", (SIGNAL_FUNC) event_monoffline);
+	signal_add("event 734", (SIGNAL_FUNC) event_monlistfull);
+	signal_add("event 600", (SIGNAL_FUNC) event_watch_online);
+	signal_add("event 604", (SIGNAL_FUNC) event_watch_online);
+	signal_add("event 601", (SIGNAL_FUNC) event_watch_offline);
+	signal_add("event 605", (SIGNAL_FUNC) event_watch_offline);
+	signal_add("event 376", (SIGNAL_FUNC) sig_end_of_motd);
+	signal_add("event 422", (SIGNAL_FUNC) sig_end_of_motd);
+	signal_add("nicklist new", (SIGNAL_FUNC) sig_nicklist_new);
+	signal_add("nicklist remove", (SIGNAL_FUNC) sig_nicklist_remove);
+	signal_add("nicklist changed", (SIGNAL_FUNC) sig_nicklist_changed);
+	signal_add("notifylist new", (SIGNAL_FUNC) sig_notifylist_changed);
+	signal_add("notifylist remove", (SIGNAL_FUNC) sig_notifylist_changed);
+	signal_add_last("setup reread", (SIGNAL_FUNC) sig_notifylist_changed);
 	signal_add("setup changed", (SIGNAL_FUNC) read_settings);
 }
 
@@ -338,5 +830,20 @@ void notifylist_ison_deinit(void)
 	g_source_remove(notify_tag);
 
 	signal_remove("notifylist event", (SIGNAL_FUNC) event_ison);
+	signal_remove("event 730", (SIGNAL_FUNC) event_mononline);
+	signal_remove("event 731", (SIGNAL_FUNC) event_monoffline);
+	signal_remove("event 734", (SIGNAL_FUNC) event_monlistfull);
+	signal_remove("event 600", (SIGNAL_FUNC) event_watch_online);
+	signal_remove("event 604", (SIGNAL_FUNC) event_watch_online);
+	signal_remove("event 601", (SIGNAL_FUNC) event_watch_offline);
+	signal_remove("event 605", (SIGNAL_FUNC) event_watch_offline);
+	signal_remove("event 376", (SIGNAL_FUNC) sig_end_of_motd);
+	signal_remove("event 422", (SIGNAL_FUNC) sig_end_of_motd);
+	signal_remove("nicklist new", (SIGNAL_FUNC) sig_nicklist_new);
+	signal_remove("nicklist remove", (SIGNAL_FUNC) sig_nicklist_remove);
+	signal_remove("nicklist changed", (SIGNAL_FUNC) sig_nicklist_changed);
+	signal_remove("notifylist new", (SIGNAL_FUNC) sig_notifylist_changed);
+	signal_remove("notifylist remove", (SIGNAL_FUNC) sig_notifylist_changed);
+	signal_remove("setup reread", (SIGNAL_FUNC) sig_notifylist_changed);
 	signal_remove("setup changed", (SIGNAL_FUNC) read_settings);
 }
@@ -21,6 +21,7 @@
 #include "module.h"
 #include "modules.h"
 #include "signals.h"
+#include "misc.h"
 #include "settings.h"
 
 #include "irc.h"
@@ -195,6 +196,9 @@ static void notifylist_init_server(IRC_SERVER_REC *server)
 		return;
 
 	rec = g_new0(MODULE_SERVER_REC,1 );
+	rec->notify_users_hash =
+		g_hash_table_new((GHashFunc) g_istr_hash,
+				 (GCompareFunc) g_istr_equal);
 	MODULE_DATA_SET(server, rec);
 }
 
@@ -215,6 +219,9 @@ static void notifylist_deinit_server(IRC_SERVER_REC *server)
 		mserver->notify_users = g_slist_remove(mserver->notify_users, rec);
 		notify_nick_destroy(rec);
 	}
+	g_hash_table_destroy(mserver->notify_users_hash);
+	notifylist_server_deinit(server);
+
 	g_free(mserver);
 	MODULE_DATA_UNSET(server);
 }
@@ -225,6 +232,7 @@ void notifylist_left(IRC_SERVER_REC *server, NOTIFY_NICK_REC *rec)
 
 	mserver = MODULE_DATA(server);
 	mserver->notify_users = g_slist_remove(mserver->notify_users, rec);
+	g_hash_table_remove(mserver->notify_users_hash, rec->nick);
 
 	if (rec->host_ok && rec->away_ok) {
 		signal_emit("notifylist left", 6,
@@ -43,12 +43,59 @@ void
 bans(channel)
 	Irssi::Irc::Channel channel
 PREINIT:
-	GSList *tmp;
+	GList *tmp;
 PPCODE:
 	for (tmp = channel->banlist; tmp != NULL; tmp = tmp->next) {
 		XPUSHs(sv_2mortal(plain_bless(tmp->data, "Irssi::Irc::Ban")));
 	}
 
+void
+ebans(channel)
+	Irssi::Irc::Channel channel
+PREINIT:
+	GList *tmp;
+PPCODE:
+	for (tmp = channel->ebanlist; tmp != NULL; tmp = tmp->next) {
+		XPUSHs(sv_2mortal(plain_bless(tmp->data, "Irssi::Irc::Ban")));
+	}
+
+void
+invites(channel)
+	Irssi::Irc::Channel channel
+PREINIT:
+	GList *tmp;
+PPCODE:
+	for (tmp = channel->invitelist; tmp != NULL; tmp = tmp->next) {
+		XPUSHs(sv_2mortal(plain_bless(tmp->data, "Irssi::Irc::Ban")));
+	}
+
+void
+mask_nicks(channel, mask)
+	Irssi::Irc::Channel channel
+	char *mask
+PREINIT:
+	GSList *list, *tmp;
+PPCODE:
+	list = modelist_match_nicks(channel, mask);
+	for (tmp = list; tmp != NULL; tmp = tmp->next) {
+		XPUSHs(sv_2mortal(iobject_bless((NICK_REC *) tmp->data)));
+	}
+	g_slist_free(list);
+
+void
+nick_masks(channel, nick, mode="b")
+	Irssi::Irc::Channel channel
+	Irssi::Irc::Nick nick
+	char *mode
+PREINIT:
+	GSList *list, *tmp;
+PPCODE:
+	list = modelist_match_masks(channel, *mode, nick);
+	for (tmp = list; tmp != NULL; tmp = tmp->next) {
+		XPUSHs(sv_2mortal(plain_bless(tmp->data, "Irssi::Irc::Ban")));
+	}
+	g_slist_free(list);
+
 Irssi::Irc::Nick
 irc_nick_insert(channel, nick, op, halfop, voice, send_massjoin)
 	Irssi::Irc::Channel channel
@@ -94,7 +94,7 @@ static void perl_dcc_send_fill_hash(HV *hv, SEND_DCC_REC *dcc)
 static void perl_netsplit_fill_hash(HV *hv, NETSPLIT_REC *netsplit)
 {
         AV *av;
-        GSList *tmp;
+        int i;
 
 	hv_store(hv, "nick", 4, new_pv(netsplit->nick), 0);
 	hv_store(hv, "address", 7, new_pv(netsplit->address), 0);
@@ -105,8 +105,8 @@ static void perl_netsplit_fill_hash(HV *hv, NETSPLIT_REC *netsplit)
 			     "Irssi::Irc::Netsplitserver"), 0);
 
 	av = newAV();
-	for (tmp = netsplit->channels; tmp != NULL; tmp = tmp->next) {
-		av_push(av, plain_bless(tmp->data,
+	for (i = 0; i < netsplit->channels_count; i++) {
+		av_push(av, plain_bless(&netsplit->channels[i],
 					"Irssi::Irc::Netsplitchannel"));
 	}
 	hv_store(hv, "channels", 8, newRV_noinc((SV*)av), 0);
@@ -274,6 +274,7 @@ void perl_chatnet_fill_hash(HV *hv, CHATNET_REC *chatnet)
 
 	hv_store(hv, "own_host", 8, new_pv(chatnet->own_host), 0);
 	hv_store(hv, "autosendcmd", 11, new_pv(chatnet->autosendcmd), 0);
+	hv_store(hv, "reconnect_priority", 18, newSViv(chatnet->reconnect_priority), 0);
 }
 
 void perl_connect_fill_hash(HV *hv, SERVER_CONNECT_REC *conn)
@@ -302,6 +303,7 @@ void perl_connect_fill_hash(HV *hv, SERVER_CONNECT_REC *conn)
 	hv_store(hv, "reconnection", 12, newSViv(conn->reconnection), 0);
 	hv_store(hv, "no_autojoin_channels", 20, newSViv(conn->no_autojoin_channels), 0);
 	hv_store(hv, "no_autosendcmd", 14, newSViv(conn->no_autosendcmd), 0);
+	hv_store(hv, "reconnect_attempts", 18, newSViv(conn->reconnect_attempts), 0);
 	hv_store(hv, "unix_socket", 11, newSViv(conn->unix_socket), 0);
 	hv_store(hv, "use_ssl", 7, newSViv(conn->use_ssl), 0);
 	hv_store(hv, "no_connect", 10, newSViv(conn->no_connect), 0);
@@ -381,7 +383,7 @@ void perl_channel_fill_hash(HV *hv, CHANNEL_REC *channel)
 	hv_store(hv, "topic_time", 10, newSViv(channel->topic_time), 0);
 
 	hv_store(hv, "no_modes", 8, newSViv(channel->no_modes), 0);
-	hv_store(hv, "mode", 4, new_pv(channel->mode), 0);
+	hv_store(hv, "mode", 4, new_pv(channel_get_mode(channel)), 0);
 	hv_store(hv, "limit", 5, newSViv(channel->limit), 0);
 	hv_store(hv, "key", 3, new_pv(channel->key), 0);
 
@@ -514,6 +516,7 @@ static void perl_reconnect_fill_hash(HV *hv, RECONNECT_REC *reconnect)
 
 	hv_store(hv, "tag", 3, newSViv(reconnect->tag), 0);
 	hv_store(hv, "next_connect", 12, newSViv(reconnect->next_connect), 0);
+	hv_store(hv, "priority", 8, newSViv(reconnect->priority), 0);
 }
 
 static void perl_script_fill_hash(HV *hv, PERL_SCRIPT_REC *script)
@@ -53,6 +53,7 @@ static PERL_SIGNAL_ARGS_REC perl_signal_args[] =
     { "server looking", { "iobject", NULL } },
     { "server connected", { "iobject", NULL } },
     { "server connecting", { "iobject", "ulongptr", NULL } },
+    { "server connect attempt", { "iobject", "ulongptr", "int", "string", NULL } },
     { "server connect failed", { "iobject", NULL } },
     { "server disconnected", { "iobject", NULL } },
     { "server quit", { "iobject", "string", NULL } },
@@ -86,14 +87,19 @@ static PERL_SIGNAL_ARGS_REC perl_signal_args[] =
     { "massjoin", { "iobject", "gslist_iobject", NULL } },
     { "ban new", { "iobject", "Irssi::Irc::Ban", NULL } },
     { "ban remove", { "iobject", "Irssi::Irc::Ban", "string", NULL } },
+    { "ban exception new", { "iobject", "Irssi::Irc::Ban", NULL } },
+    { "ban exception remove", { "iobject", "Irssi::Irc::Ban", "string", NULL } },
+    { "invitelist new", { "iobject", "Irssi::Irc::Ban", NULL } },
+    { "invitelist remove", { "iobject", "Irssi::Irc::Ban", "string", NULL } },
     { "channel mode changed", { "iobject", "string", NULL } },
     { "nick mode changed", { "iobject", "iobject", "string", "string", "string", NULL } },
     { "user mode changed", { "iobject", "string", NULL } },
     { "away mode changed", { "iobject", NULL } },
     { "netsplit server new", { "iobject", "Irssi::Irc::Netsplitserver", NULL } },
     { "netsplit server remove", { "iobject", "Irssi::Irc::Netsplitserver", NULL } },
-    { "netsplit new", { "Irssi::Irc::Netsplit", NULL } },
+    { "netsplit new", { "Irssi::Irc::Netsplit", "iobject", NULL } },
     { "netsplit remove", { "Irssi::Irc::Netsplit", NULL } },
+    { "netsplit batch", { "iobject", "int", NULL } },
     { "dcc ctcp ", { "string", "siobject", NULL } },
     { "default dcc ctcp", { "string", "siobject", NULL } },
     { "dcc unknown ctcp", { "string", "string", "string", NULL } },
@@ -152,6 +158,7 @@ static PERL_SIGNAL_ARGS_REC perl_signal_args[] =
     { "keyinfo created", { "Irssi::UI::Keyinfo", NULL } },
     { "keyinfo destroyed", { "Irssi::UI::Keyinfo", NULL } },
     { "print text", { "Irssi::UI::TextDest", "string", "string", NULL } },
+    { "gui print line", { "Irssi::UI::TextDest", "string", NULL } },
     { "theme created", { "Irssi::UI::Theme", NULL } },
     { "theme destroyed", { "Irssi::UI::Theme", NULL } },
     { "window hilight", { "Irssi::UI::Window", NULL } },
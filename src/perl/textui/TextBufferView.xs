@@ -80,6 +80,9 @@ Irssi::TextUI::TextBufferView
 view(window)
 	Irssi::UI::Window window
 CODE:
+	/* scripts read the buffer through the view, so it needs the
+	   lines that are still waiting for the window to be shown */
+	gui_printtext_flush_deferred(window);
 	RETVAL = WINDOW_GUI(window)->view;
 OUTPUT:
 	RETVAL
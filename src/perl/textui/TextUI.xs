@@ -171,6 +171,7 @@ Irssi::TextUI::Line
 last_line_insert(window)
 	Irssi::UI::Window window
 CODE:
+	gui_printtext_flush_deferred(window);
 	RETVAL = WINDOW_GUI(window)->insert_after;
 OUTPUT:
 	RETVAL